@@ -0,0 +1,159 @@
+/**
+    @file bench_format.c
+    This program measures how fast rows are formatted by the buffered writer in flare_format.c,
+    compared with the printf-based formatting it replaced. Rows are tokenized once up front, and
+    each pass formats all of them into a memory buffer, so only formatting and fraction work is timed.
+    Both paths must produce the same bytes; the program fails if they do not.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "flare_format.h"
+#include "flare_parse.h"
+#include "mapped_file.h"
+#include "out_buffer.h"
+
+#define DEFAULT_INPUT "fermi_gbm_flare_list_10.txt" // Flare list used when none is given
+#define DEFAULT_PASSES 200 // Times each path formats every row
+
+/**
+    Formats a fraction centered on its slash with sprintf, as the original program did.
+    @param f the fraction array
+    @param buf buffer to hold the formatted output
+ */
+static void center_format_fraction_printf(const Fraction f, char *buf) {
+    char str_f0[21], str_f1[21];
+    sprintf(str_f0, "%lld", f[0]);
+    sprintf(str_f1, "%lld", f[1]);
+    int len_f0 = strlen(str_f0);
+    int len_f1 = strlen(str_f1);
+    int slash_pos = WIDTH / 2;
+    int left_spaces = slash_pos - len_f0;
+    int right_spaces = WIDTH - slash_pos - 1 - len_f1;
+    sprintf(buf, "%*s%s/%s%*s", left_spaces, "", str_f0, str_f1, right_spaces, "");
+}
+
+/**
+    Formats a row with printf-style calls, as the original program did.
+    @param row the tokenized row
+    @param out the buffer to append the row to
+ */
+static void emit_row_printf(const FlareRow *row, OutBuffer *out) {
+    Fraction peak_frac, avg_count_rate_frac, duration_frac, total_count_frac;
+    from_decimal_parts(row->peak, peak_frac);
+    from_decimal_parts(row->avg, avg_count_rate_frac);
+    int duration = row->end_sec - row->start_sec;
+    if (duration < 0) {
+        duration += SECOND_PER_DAY;
+    }
+    duration_frac[0] = duration;
+    duration_frac[1] = 1;
+    multiply_fraction(avg_count_rate_frac, duration_frac, total_count_frac);
+
+    char peak_fmt[CENTERED_MAX], avg_count_rate_fmt[CENTERED_MAX], total_count_fmt[CENTERED_MAX];
+    center_format_fraction_printf(peak_frac, peak_fmt);
+    center_format_fraction_printf(avg_count_rate_frac, avg_count_rate_fmt);
+    center_format_fraction_printf(total_count_frac, total_count_fmt);
+    out_printf(out, "%12.*s%12.*s%9.*s%9.*s%9.*s%6d %4lld.%03lld (%39s) %7lld.%010lld (%39s) (%39s) %12.*s\n",
+        row->flare_id.len, row->flare_id.ptr, row->start_date.len, row->start_date.ptr,
+        row->start_time.len, row->start_time.ptr, row->peak_time.len, row->peak_time.ptr,
+        row->end_time.len, row->end_time.ptr, duration,
+        row->peak[0], row->peak[1], peak_fmt, row->avg[0], row->avg[1], avg_count_rate_fmt, total_count_fmt,
+        row->detectors.len, row->detectors.ptr);
+}
+
+/**
+    Returns a monotonic timestamp.
+    @return current time in seconds
+ */
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+    Program starting point. Tokenizes a flare list, then times both formatting paths over its rows.
+    @param argc number of command-line arguments
+    @param argv optional flare list and number of passes
+    @return program exit status
+ */
+int main(int argc, char *argv[]) {
+    const char *filename = argc > 1 ? argv[1] : DEFAULT_INPUT;
+    int passes = argc > 2 ? atoi(argv[2]) : DEFAULT_PASSES;
+    MappedFile mf;
+    if (passes < 1 || !map_file(filename, &mf)) {
+        fprintf(stderr, "Usage: %s [flare_list] [passes]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Tokenize every row once
+    const char *end = mf.data + mf.size;
+    const char *p = flare_skip_lines(mf.data, end, MAX_HEADER_LINES);
+    size_t count = 0, cap = 1024;
+    FlareRow *rows = malloc(cap * sizeof(FlareRow));
+    while (rows != NULL && p < end) {
+        const char *next = flare_next_line(p, end);
+        const char *line_end = (next > p && next[-1] == '\n') ? next - 1 : next;
+        if (count == cap) {
+            cap *= 2;
+            rows = realloc(rows, cap * sizeof(FlareRow));
+        }
+        if (rows != NULL && flare_parse_row(p, line_end, &rows[count])) {
+            count++;
+        }
+        p = next;
+    }
+    if (rows == NULL || count == 0) {
+        fprintf(stderr, "Error: no rows in %s\n", filename);
+        return EXIT_FAILURE;
+    }
+
+    // Both paths must agree byte for byte before their speed means anything
+    OutBuffer printf_out, buffered_out;
+    RowFormat as_is;
+    date_format_compile("", &as_is.date);
+    as_is.decimal = false;
+    out_init(&printf_out, NULL);
+    out_init(&buffered_out, NULL);
+    for (size_t i = 0; i < count; i++) {
+        emit_row_printf(&rows[i], &printf_out);
+        emit_row(&rows[i], &as_is, &buffered_out);
+    }
+    if (printf_out.len != buffered_out.len || memcmp(printf_out.data, buffered_out.data, printf_out.len) != 0) {
+        fprintf(stderr, "Error: buffered output differs from printf output\n");
+        return EXIT_FAILURE;
+    }
+
+    double start = now_sec();
+    for (int pass = 0; pass < passes; pass++) {
+        printf_out.len = 0;
+        for (size_t i = 0; i < count; i++) {
+            emit_row_printf(&rows[i], &printf_out);
+        }
+    }
+    double printf_sec = now_sec() - start;
+
+    start = now_sec();
+    for (int pass = 0; pass < passes; pass++) {
+        buffered_out.len = 0;
+        for (size_t i = 0; i < count; i++) {
+            emit_row(&rows[i], &as_is, &buffered_out);
+        }
+    }
+    double buffered_sec = now_sec() - start;
+
+    double total = (double)count * passes;
+    printf("%zu rows x %d passes from %s\n", count, passes, filename);
+    printf("%-10s %14.0f rows/s\n", "printf", total / printf_sec);
+    printf("%-10s %14.0f rows/s\n", "buffered", total / buffered_sec);
+    printf("%-10s %14.2fx\n", "speedup", printf_sec / buffered_sec);
+
+    out_free(&printf_out);
+    out_free(&buffered_out);
+    free(rows);
+    unmap_file(&mf);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,267 @@
+/**
+    @file bench_fraction.c
+    This program measures the fraction arithmetic in fraction.c against the recursive Euclid GCD
+    and unchecked products it replaced. Both versions run the same list of random operations on
+    values small enough that the old one cannot overflow, and must give the same results. A second
+    list of products and quotients with large operands counts how often the unchecked version wraps
+    around, and checks that the new one gives the exact value every time.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fraction.h"
+
+#define DEFAULT_OPS 4000000 // Random operations timed for each version
+#define SMALL_RANGE 1000000 // Operands of the timed operations are below this in magnitude
+#define WIDE_OPS 100000     // Operations on large operands used for the overflow check
+
+typedef void (*FractionOp)(const Fraction a, const Fraction b, Fraction result);
+
+/**
+    Calculates a GCD with recursive Euclid, as fraction.c did before.
+    @param a First integer
+    @param b Second integer
+    @return The GCD of a and b
+ */
+static int64 legacy_gcd(int64 a, int64 b) {
+    if (a < 0) a = -a;
+    if (b < 0) b = -b;
+    if (b == 0) {
+        return a;
+    }
+    return legacy_gcd(b, a % b);
+}
+
+/**
+    Simplifies a fraction with legacy_gcd.
+    @param f Fraction to simplify
+ */
+static void legacy_simplify(Fraction f) {
+    if (f[1] < 0) {
+        f[0] = -f[0];
+        f[1] = -f[1];
+    }
+    int64 g = legacy_gcd(f[0], f[1]);
+    if (g > 1) {
+        f[0] /= g;
+        f[1] /= g;
+    }
+}
+
+/**
+    Adds two fractions over the lcm of their denominators without overflow checks.
+    @param a First fraction
+    @param b Second fraction
+    @param result Fraction to store the result
+ */
+static void legacy_add(const Fraction a, const Fraction b, Fraction result) {
+    int64 g = legacy_gcd(a[1], b[1]);
+    int64 lcm_den = (a[1] / g) * b[1];
+    result[0] = a[0] * (lcm_den / a[1]) + b[0] * (lcm_den / b[1]);
+    result[1] = lcm_den;
+    legacy_simplify(result);
+}
+
+/**
+    Subtracts two fractions over the lcm of their denominators without overflow checks.
+    @param a First fraction
+    @param b Second fraction
+    @param result Fraction to store the result
+ */
+static void legacy_subtract(const Fraction a, const Fraction b, Fraction result) {
+    int64 g = legacy_gcd(a[1], b[1]);
+    int64 lcm_den = (a[1] / g) * b[1];
+    result[0] = a[0] * (lcm_den / a[1]) - b[0] * (lcm_den / b[1]);
+    result[1] = lcm_den;
+    legacy_simplify(result);
+}
+
+/**
+    Multiplies two fractions without overflow checks.
+    @param a First fraction
+    @param b Second fraction
+    @param result Fraction to store the result
+ */
+static void legacy_multiply(const Fraction a, const Fraction b, Fraction result) {
+    result[0] = a[0] * b[0];
+    result[1] = a[1] * b[1];
+    legacy_simplify(result);
+}
+
+/**
+    Divides two fractions without overflow checks.
+    @param a First fraction
+    @param b Second fraction (nonzero)
+    @param result Fraction to store the result
+ */
+static void legacy_divide(const Fraction a, const Fraction b, Fraction result) {
+    result[0] = a[0] * b[1];
+    result[1] = a[1] * b[0];
+    legacy_simplify(result);
+}
+
+/**
+    Returns the next value of a xorshift64 generator, so every run uses the same operands.
+    @param state generator state
+    @return the next pseudo-random value
+ */
+static unsigned long long next_random(unsigned long long *state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/**
+    Fills a fraction with a random nonzero numerator in [-range, range] and a random denominator
+    in [1, range].
+    @param state generator state
+    @param range bound on the magnitude of both parts
+    @param f Fraction to fill in
+ */
+static void random_fraction(unsigned long long *state, unsigned long long range, Fraction f) {
+    f[0] = (int64)(next_random(state) % range) + 1;
+    if (next_random(state) & 1) {
+        f[0] = -f[0];
+    }
+    f[1] = (int64)(next_random(state) % range) + 1;
+}
+
+/**
+    Returns a monotonic timestamp.
+    @return current time in seconds
+ */
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+    Runs every operation in the list with one version of the arithmetic.
+    @param ops operations to apply, indexed by kind
+    @param kinds operation to apply to each pair: add, subtract, multiply or divide
+    @param a first operands
+    @param b second operands
+    @param results fractions to store the results in
+    @param count number of operations
+    @return elapsed seconds
+ */
+static double run_ops(const FractionOp ops[4], const unsigned char *kinds, Fraction *a, Fraction *b,
+                      Fraction *results, size_t count) {
+    double start = now_sec();
+    for (size_t i = 0; i < count; i++) {
+        ops[kinds[i]](a[i], b[i], results[i]);
+    }
+    return now_sec() - start;
+}
+
+/**
+    Checks whether a fraction is the exact product or quotient of two fractions, reducing the
+    exact value in 128 bits with Euclid's algorithm.
+    @param divide true to check a / b, false to check a * b
+    @param a First operand
+    @param b Second operand
+    @param r Result to check
+    @return true if r is the exact result in lowest terms
+ */
+static bool exact_result(bool divide, const Fraction a, const Fraction b, const Fraction r) {
+    __int128 num = (__int128)a[0] * (divide ? b[1] : b[0]);
+    __int128 den = (__int128)a[1] * (divide ? b[0] : b[1]);
+    if (den < 0) {
+        num = -num;
+        den = -den;
+    }
+    __int128 x = num < 0 ? -num : num, y = den;
+    while (y != 0) {
+        __int128 t = x % y;
+        x = y;
+        y = t;
+    }
+    return num / x == r[0] && den / x == r[1];
+}
+
+/**
+    Program starting point. Builds a random list of operations and times both versions over it.
+    @param argc number of command-line arguments
+    @param argv optional number of operations
+    @return program exit status
+ */
+int main(int argc, char *argv[]) {
+    long requested = argc > 1 ? atol(argv[1]) : DEFAULT_OPS;
+    if (requested < 1) {
+        fprintf(stderr, "Usage: %s [operations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    size_t count = (size_t)requested;
+    static const FractionOp checked[4] = {add_fraction, subtract_fraction, multiply_fraction, divide_fraction};
+    static const FractionOp legacy[4] = {legacy_add, legacy_subtract, legacy_multiply, legacy_divide};
+
+    Fraction *a = malloc(count * sizeof(Fraction));
+    Fraction *b = malloc(count * sizeof(Fraction));
+    Fraction *checked_results = malloc(count * sizeof(Fraction));
+    Fraction *legacy_results = malloc(count * sizeof(Fraction));
+    unsigned char *kinds = malloc(count);
+    if (a == NULL || b == NULL || checked_results == NULL || legacy_results == NULL || kinds == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    // Operands below SMALL_RANGE keep every intermediate of the legacy version within 64 bits
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < count; i++) {
+        random_fraction(&state, SMALL_RANGE, a[i]);
+        random_fraction(&state, SMALL_RANGE, b[i]);
+        kinds[i] = (unsigned char)(next_random(&state) & 3);
+    }
+    double legacy_sec = run_ops(legacy, kinds, a, b, legacy_results, count);
+    double checked_sec = run_ops(checked, kinds, a, b, checked_results, count);
+    for (size_t i = 0; i < count; i++) {
+        if (legacy_results[i][0] != checked_results[i][0] || legacy_results[i][1] != checked_results[i][1]) {
+            fprintf(stderr, "Error: results differ at operation %zu\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Operands sharing a factor near 2^31 make the unchecked products wrap, while their reduced
+    // results fit easily in 64 bits
+    size_t legacy_wrong = 0;
+    for (size_t i = 0; i < WIDE_OPS; i++) {
+        int64 g = (int64)(next_random(&state) % (1ULL << 30)) + (1LL << 30);
+        Fraction x, y, r;
+        random_fraction(&state, 1ULL << 20, x);
+        random_fraction(&state, 1ULL << 20, y);
+        bool divide = next_random(&state) & 1;
+        x[0] *= g;
+        if (divide) {
+            y[0] *= g;
+            legacy_divide(x, y, r);
+        } else {
+            y[1] *= g;
+            legacy_multiply(x, y, r);
+        }
+        legacy_wrong += !exact_result(divide, x, y, r);
+        (divide ? divide_fraction : multiply_fraction)(x, y, r);
+        if (!exact_result(divide, x, y, r)) {
+            fprintf(stderr, "Error: inexact result on large operands at operation %zu\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("%zu random operations (add, subtract, multiply, divide)\n", count);
+    printf("%-10s %14.0f ops/s\n", "euclid", count / legacy_sec);
+    printf("%-10s %14.0f ops/s\n", "binary", count / checked_sec);
+    printf("%-10s %14.2fx\n", "speedup", legacy_sec / checked_sec);
+    printf("large operands: %zu of %d unchecked products wrapped, all checked products exact\n",
+           legacy_wrong, WIDE_OPS);
+
+    free(a);
+    free(b);
+    free(checked_results);
+    free(legacy_results);
+    free(kinds);
+    return EXIT_SUCCESS;
+}
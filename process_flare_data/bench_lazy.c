@@ -0,0 +1,174 @@
+/**
+    @file bench_lazy.c
+    This program measures what reducing fractions only at output time saves on real flare lists.
+    For every row it computes the peak, the average count rate and the total count, and it keeps
+    running sums of the peak and the rate over the file. The eager chain reduces after every
+    operation, as the original fraction functions do. The lazy chain uses the _unreduced functions
+    and reduces each printed value once, and each sum once at the end. Both chains must give the
+    same fractions. The program reports gcd() calls per row and rows per second for each.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "flare_format.h"
+#include "flare_parse.h"
+#include "fraction.h"
+#include "mapped_file.h"
+
+#define DEFAULT_PASSES 100 // Times each chain processes every row of a file
+
+typedef struct {
+    Fraction peak, avg, total; // Values of the last row, as they would be printed
+    Fraction peak_sum, avg_sum; // Sums over the file
+} ChainResult;
+
+/**
+    Runs the eager chain, reducing after every operation.
+    @param rows tokenized rows
+    @param count number of rows
+    @param r results of the chain
+ */
+static void eager_chain(const FlareRow *rows, size_t count, ChainResult *r) {
+    Fraction duration_frac;
+    r->peak_sum[0] = r->avg_sum[0] = 0;
+    r->peak_sum[1] = r->avg_sum[1] = 1;
+    for (size_t i = 0; i < count; i++) {
+        from_decimal_parts(rows[i].peak, r->peak);
+        from_decimal_parts(rows[i].avg, r->avg);
+        duration_frac[0] = row_duration(&rows[i]);
+        duration_frac[1] = 1;
+        multiply_fraction(r->avg, duration_frac, r->total);
+        add_fraction(r->peak_sum, r->peak, r->peak_sum);
+        add_fraction(r->avg_sum, r->avg, r->avg_sum);
+    }
+}
+
+/**
+    Runs the lazy chain, reducing each printed value once and the sums at the end.
+    @param rows tokenized rows
+    @param count number of rows
+    @param r results of the chain
+ */
+static void lazy_chain(const FlareRow *rows, size_t count, ChainResult *r) {
+    Fraction duration_frac;
+    r->peak_sum[0] = r->avg_sum[0] = 0;
+    r->peak_sum[1] = r->avg_sum[1] = 1;
+    for (size_t i = 0; i < count; i++) {
+        from_decimal_parts_unreduced(rows[i].peak, r->peak);
+        from_decimal_parts_unreduced(rows[i].avg, r->avg);
+        duration_frac[0] = row_duration(&rows[i]);
+        duration_frac[1] = 1;
+        multiply_fraction_unreduced(r->avg, duration_frac, r->total);
+        add_fraction_unreduced(r->peak_sum, r->peak, r->peak_sum);
+        add_fraction_unreduced(r->avg_sum, r->avg, r->avg_sum);
+
+        // The row's values are printed here, so they are reduced here
+        simplify(r->peak);
+        simplify(r->avg);
+        simplify(r->total);
+    }
+    simplify(r->peak_sum);
+    simplify(r->avg_sum);
+}
+
+/**
+    Returns a monotonic timestamp.
+    @return current time in seconds
+ */
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+    Tokenizes the rows of a flare list.
+    @param mf the mapped flare list
+    @param count set to the number of rows
+    @return the rows, or NULL if there are none
+ */
+static FlareRow *load_rows(const MappedFile *mf, size_t *count) {
+    const char *end = mf->data + mf->size;
+    const char *p = flare_skip_lines(mf->data, end, MAX_HEADER_LINES);
+    size_t cap = 1024;
+    FlareRow *rows = malloc(cap * sizeof(FlareRow));
+    *count = 0;
+    while (rows != NULL && p < end) {
+        const char *next = flare_next_line(p, end);
+        const char *line_end = (next > p && next[-1] == '\n') ? next - 1 : next;
+        if (*count == cap) {
+            cap *= 2;
+            rows = realloc(rows, cap * sizeof(FlareRow));
+        }
+        if (rows != NULL && flare_parse_row(p, line_end, &rows[*count])) {
+            (*count)++;
+        }
+        p = next;
+    }
+    if (rows != NULL && *count == 0) {
+        free(rows);
+        rows = NULL;
+    }
+    return rows;
+}
+
+/**
+    Program starting point. Runs both chains over each flare list and prints a line per file.
+    @param argc number of command-line arguments
+    @param argv flare lists to use, defaulting to the bundled ones
+    @return program exit status
+ */
+int main(int argc, char *argv[]) {
+    static const char *bundled[] = {
+        "fermi_gbm_flare_list_2.txt", "fermi_gbm_flare_list_4.txt", "fermi_gbm_flare_list_6.txt",
+        "fermi_gbm_flare_list_8.txt", "fermi_gbm_flare_list_10.txt"
+    };
+    const char **files = argc > 1 ? (const char **)argv + 1 : bundled;
+    int file_count = argc > 1 ? argc - 1 : (int)(sizeof(bundled) / sizeof(bundled[0]));
+
+    printf("%-30s %8s %10s %10s %8s %14s %14s %8s\n", "file", "rows", "eager_gcd", "lazy_gcd", "saved",
+           "eager_rows/s", "lazy_rows/s", "speedup");
+    for (int f = 0; f < file_count; f++) {
+        MappedFile mf;
+        size_t count;
+        FlareRow *rows = NULL;
+        if (!map_file(files[f], &mf) || (rows = load_rows(&mf, &count)) == NULL) {
+            fprintf(stderr, "Error: no rows in %s\n", files[f]);
+            return EXIT_FAILURE;
+        }
+
+        // Count the gcd() calls of one run of each chain, and check that they agree
+        ChainResult eager, lazy;
+        long long before = fraction_gcd_calls();
+        eager_chain(rows, count, &eager);
+        long long eager_gcd = fraction_gcd_calls() - before;
+        before = fraction_gcd_calls();
+        lazy_chain(rows, count, &lazy);
+        long long lazy_gcd = fraction_gcd_calls() - before;
+        if (memcmp(&eager, &lazy, sizeof(ChainResult)) != 0) {
+            fprintf(stderr, "Error: lazy chain differs from eager chain on %s\n", files[f]);
+            return EXIT_FAILURE;
+        }
+
+        double start = now_sec();
+        for (int pass = 0; pass < DEFAULT_PASSES; pass++) {
+            eager_chain(rows, count, &eager);
+        }
+        double eager_sec = now_sec() - start;
+        start = now_sec();
+        for (int pass = 0; pass < DEFAULT_PASSES; pass++) {
+            lazy_chain(rows, count, &lazy);
+        }
+        double lazy_sec = now_sec() - start;
+
+        double total = (double)count * DEFAULT_PASSES;
+        printf("%-30s %8zu %10.2f %10.2f %7.1f%% %14.0f %14.0f %7.2fx\n", files[f], count,
+               (double)eager_gcd / count, (double)lazy_gcd / count, 100.0 * (eager_gcd - lazy_gcd) / eager_gcd,
+               total / eager_sec, total / lazy_sec, eager_sec / lazy_sec);
+        free(rows);
+        unmap_file(&mf);
+    }
+    return EXIT_SUCCESS;
+}
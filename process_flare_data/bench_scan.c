@@ -0,0 +1,171 @@
+/**
+    @file bench_scan.c
+    This program measures the flare list tokenizer with each block classifier the CPU can run. It
+    tokenizes every row of a file repeatedly with a FlareScanner, which classifies a window of input
+    at a time and finds lines and fields from the masks, and once more line by line, which finds
+    each line with memchr and classifies just that line. Every way must produce the same rows. The
+    program reports input megabytes per second and rows per second for each.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "flare_parse.h"
+#include "flare_scan.h"
+#include "mapped_file.h"
+
+#define DEFAULT_PASSES 20 // Times each way tokenizes every row of a file
+
+/**
+    Returns a monotonic timestamp.
+    @return current time in seconds
+ */
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+    Folds the fields of a row into a checksum, so that every way of tokenizing can be compared.
+    @param sum running checksum
+    @param row the tokenized row
+    @return the new checksum
+ */
+static uint64_t mix_row(uint64_t sum, const FlareRow *row) {
+    const Field *fields[] = {&row->flare_id, &row->start_date, &row->start_time, &row->peak_time,
+                             &row->end_time, &row->detectors};
+    for (int i = 0; i < 6; i++) {
+        sum = sum * 31 + (uint64_t)(uintptr_t)fields[i]->ptr + (uint64_t)fields[i]->len;
+    }
+    sum = sum * 31 + (uint64_t)(row->start_sec ^ row->peak_sec << 8 ^ row->end_sec << 16);
+    return sum * 31 + (uint64_t)(row->peak[0] ^ row->peak[1] ^ row->avg[0] ^ row->avg[1]);
+}
+
+/**
+    Tokenizes the data lines of a file with a FlareScanner.
+    @param p start of the first data line
+    @param end end of the file
+    @param rows set to the number of rows
+    @return checksum of the rows and the lines skipped
+ */
+static uint64_t scan_rows(const char *p, const char *end, long long *rows) {
+    FlareScanner sc;
+    FlareRow row;
+    const char *line, *line_end;
+    uint64_t sum = 0;
+    *rows = 0;
+    flare_scanner_init(&sc, p, end);
+    while (flare_scanner_next(&sc, &line, &line_end)) {
+        if (flare_scanner_row(&sc, line, line_end, &row)) {
+            sum = mix_row(sum, &row);
+            (*rows)++;
+        } else {
+            sum = sum * 31 + flare_scanner_blank(&sc, line, line_end);
+        }
+    }
+    return sum;
+}
+
+/**
+    Tokenizes the data lines of a file one line at a time.
+    @param p start of the first data line
+    @param end end of the file
+    @param rows set to the number of rows
+    @return checksum of the rows and the lines skipped
+ */
+static uint64_t line_rows(const char *p, const char *end, long long *rows) {
+    FlareRow row;
+    uint64_t sum = 0;
+    *rows = 0;
+    while (p < end) {
+        const char *next = flare_next_line(p, end);
+        const char *line_end = (next > p && next[-1] == '\n') ? next - 1 : next;
+        if (flare_parse_row(p, line_end, &row)) {
+            sum = mix_row(sum, &row);
+            (*rows)++;
+        } else {
+            sum = sum * 31 + flare_blank_line(p, line_end);
+        }
+        p = next;
+    }
+    return sum;
+}
+
+/**
+    Program starting point. Tokenizes each flare list every way and prints a line for each.
+    @param argc number of command-line arguments
+    @param argv --passes=N, then the flare lists to use, defaulting to the bundled ones
+    @return program exit status
+ */
+int main(int argc, char *argv[]) {
+    static const char *bundled[] = {
+        "fermi_gbm_flare_list_2.txt", "fermi_gbm_flare_list_4.txt", "fermi_gbm_flare_list_6.txt",
+        "fermi_gbm_flare_list_8.txt", "fermi_gbm_flare_list_10.txt"
+    };
+    static const char *kernels[] = {"scalar", "sse2", "avx2"};
+    int passes = DEFAULT_PASSES;
+    int first = 1;
+    if (argc > 1 && strncmp(argv[1], "--passes=", 9) == 0) {
+        passes = atoi(argv[1] + 9);
+        first = 2;
+    }
+    const char **files = argc > first ? (const char **)argv + first : bundled;
+    int file_count = argc > first ? argc - first : (int)(sizeof(bundled) / sizeof(bundled[0]));
+    if (passes < 1) {
+        fprintf(stderr, "Usage: %s [--passes=N] [flare_list...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%-30s %-12s %10s %10s %14s\n", "file", "way", "rows", "MB/s", "rows/s");
+    for (int f = 0; f < file_count; f++) {
+        MappedFile mf;
+        if (!map_file(files[f], &mf)) {
+            fprintf(stderr, "Error: cannot read %s\n", files[f]);
+            return EXIT_FAILURE;
+        }
+        const char *end = mf.data + mf.size;
+        const char *p = flare_skip_lines(mf.data, end, MAX_HEADER_LINES);
+        uint64_t expected = 0;
+        bool have_expected = false;
+
+        for (int k = 0; k <= 3; k++) {
+            const char *way = k < 3 ? kernels[k] : "line";
+            ScanKernel kernel = scan_kernel_named(k < 3 ? kernels[k] : "scalar");
+            if (kernel == NULL) {
+                printf("%-30s %-12s %10s\n", files[f], way, "absent");
+                continue;
+            }
+            if (k == 3) {
+                // Line by line with the best kernel the CPU has
+                for (int j = 2; j >= 0; j--) {
+                    if (scan_kernel_named(kernels[j]) != NULL) {
+                        kernel = scan_kernel_named(kernels[j]);
+                        break;
+                    }
+                }
+            }
+            scan_use_kernel(kernel);
+
+            long long rows = 0;
+            uint64_t sum = 0;
+            double start = now_sec();
+            for (int pass = 0; pass < passes; pass++) {
+                sum = k < 3 ? scan_rows(p, end, &rows) : line_rows(p, end, &rows);
+            }
+            double sec = now_sec() - start;
+            if (have_expected && sum != expected) {
+                fprintf(stderr, "Error: %s tokenizes %s differently\n", way, files[f]);
+                return EXIT_FAILURE;
+            }
+            expected = sum;
+            have_expected = true;
+            printf("%-30s %-12s %10lld %10.1f %14.0f\n", files[f], way, rows,
+                   (double)(end - p) * passes / 1e6 / sec, (double)rows * passes / sec);
+        }
+        unmap_file(&mf);
+    }
+    return EXIT_SUCCESS;
+}
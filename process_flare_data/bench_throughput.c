@@ -0,0 +1,258 @@
+/**
+    @file bench_throughput.c
+    This program measures the whole process_flare_data program on large flare lists, such as those
+    written by gen_flare_list. Each configuration of options is run as a child process with its
+    output sent to /dev/null, and the fastest of several runs is reported as rows per second and
+    input megabytes per second, with the peak resident set size of the child. The snapshot
+    configurations write a snapshot next to the input, read it back, and remove it. The compressed
+    configurations compress the input next to it with gzip or zstd, read the compressed copy, and
+    remove it; a configuration whose tool is missing, or that the program was built without, is
+    reported as skipped.
+ */
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_PROGRAM "./process_flare_data" // Program measured when none is given
+#define DEFAULT_RUNS 3 // Runs of each configuration; the fastest is reported
+#define MAX_ARGS 8 // Most arguments passed to one run
+#define MAX_PATH 4096 // Maximum length of a snapshot or compressed copy path
+
+typedef struct {
+    const char *name;       // Name printed in the report
+    const char *option;     // Option passed to the program, or NULL
+    int snapshot;           // 0 to read the list, 1 to write its snapshot, 2 to read the snapshot
+    const char *compressor; // Tool whose compressed copy of the list is read ("gzip", "zstd"), or NULL
+    const char *suffix;     // Suffix of the compressed copy
+} BenchConfig;
+
+typedef struct {
+    double best_sec;   // Fastest wall time of the runs
+    long peak_rss_kb;  // Largest peak resident set size of the runs
+} BenchResult;
+
+/**
+    Returns a monotonic timestamp.
+    @return current time in seconds
+ */
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+    Reads the number of flares from the "Total # flares:" line of a flare list header.
+    @param path the flare list
+    @return the number of flares, or -1 if the header does not give it
+ */
+static long long header_rows(const char *path) {
+    FILE *fp = fopen(path, "r");
+    char line[512];
+    long long rows = -1;
+    for (int i = 0; fp != NULL && i < 7 && fgets(line, sizeof(line), fp) != NULL; i++) {
+        if (sscanf(line, "Total # flares: %lld", &rows) == 1) {
+            break;
+        }
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    return rows;
+}
+
+/**
+    Runs the program once with its output discarded.
+    @param args the argument list, starting with the program, ending with NULL
+    @param sec set to the wall time of the run
+    @param rss_kb set to the peak resident set size of the child in kilobytes
+    @return 1 if the program exited successfully, 0 otherwise
+ */
+static int run_once(char *const args[], double *sec, long *rss_kb) {
+    double start = now_sec();
+    pid_t pid = fork();
+    if (pid < 0) {
+        return 0;
+    }
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        execv(args[0], args);
+        _exit(127);
+    }
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid) {
+        return 0;
+    }
+    *sec = now_sec() - start;
+    *rss_kb = usage.ru_maxrss;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+    Compresses a flare list into a copy with a command-line tool.
+    @param tool the compressor, found on the PATH
+    @param src the flare list
+    @param dst the compressed copy to write
+    @return 1 on success, 0 if the tool is missing or fails
+ */
+static int compress_copy(const char *tool, const char *src, const char *dst) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        return 0;
+    }
+    if (pid == 0) {
+        int out_fd = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out_fd < 0) {
+            _exit(127);
+        }
+        dup2(out_fd, STDOUT_FILENO);
+        execlp(tool, tool, "-c", "-q", src, (char *)NULL);
+        _exit(127);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        unlink(dst);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+    Runs one configuration several times.
+    @param args the argument list, starting with the program, ending with NULL
+    @param runs number of runs
+    @param result fastest time and largest peak RSS of the runs
+    @return 1 if every run succeeded, 0 otherwise
+ */
+static int run_config(char *const args[], int runs, BenchResult *result) {
+    result->best_sec = 0;
+    result->peak_rss_kb = 0;
+    for (int r = 0; r < runs; r++) {
+        double sec;
+        long rss_kb;
+        if (!run_once(args, &sec, &rss_kb)) {
+            return 0;
+        }
+        if (r == 0 || sec < result->best_sec) {
+            result->best_sec = sec;
+        }
+        if (rss_kb > result->peak_rss_kb) {
+            result->peak_rss_kb = rss_kb;
+        }
+    }
+    return 1;
+}
+
+/**
+    Program starting point. Runs every configuration on each flare list and prints a line for each.
+    @param argc number of command-line arguments
+    @param argv --program=PATH, --runs=N, --threads=N, and the flare lists to use
+    @return program exit status
+ */
+int main(int argc, char *argv[]) {
+    const char *program = DEFAULT_PROGRAM;
+    int runs = DEFAULT_RUNS;
+    char threads_option[32] = "--threads=4";
+    char **files = argv + 1;
+    int file_count = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--program=", 10) == 0) {
+            program = argv[i] + 10;
+        } else if (strncmp(argv[i], "--runs=", 7) == 0) {
+            runs = atoi(argv[i] + 7);
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            snprintf(threads_option, sizeof(threads_option), "%s", argv[i]);
+        } else {
+            files[file_count++] = argv[i];
+        }
+    }
+    if (file_count == 0 || runs < 1) {
+        fprintf(stderr, "Usage: %s [--program=PATH] [--runs=N] [--threads=N] <flare_list>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const BenchConfig configs[] = {
+        {"mmap", NULL, 0, NULL, NULL},
+        {"stdio", "--stdio", 0, NULL, NULL},
+        {threads_option + 2, threads_option, 0, NULL, NULL},
+        {"pipeline", "--pipeline", 0, NULL, NULL},
+        {"decimal", "--decimal", 0, NULL, NULL},
+        {"date-format", "--date-format=YYYY-MM-DD", 0, NULL, NULL},
+        {"write-snapshot", NULL, 1, NULL, NULL},
+        {"snapshot", NULL, 2, NULL, NULL},
+        {"gzip", NULL, 0, "gzip", ".gz"},
+        {"zstd", NULL, 0, "zstd", ".zst"},
+    };
+
+    // MB/s counts the bytes of the file the program read; list_MB/s counts the bytes of the text
+    // list, so snapshot and compressed runs compare directly with the plain ones
+    printf("%-32s %-16s %8s %12s %9s %10s %9s\n", "file", "config", "sec", "rows/s", "MB/s", "list_MB/s",
+           "rss_MB");
+    for (int f = 0; f < file_count; f++) {
+        long long rows = header_rows(files[f]);
+        struct stat st;
+        if (rows < 0 || stat(files[f], &st) != 0) {
+            fprintf(stderr, "Error: %s is not a flare list\n", files[f]);
+            return EXIT_FAILURE;
+        }
+        char snapshot_path[MAX_PATH], write_option[MAX_PATH + 32];
+        snprintf(snapshot_path, sizeof(snapshot_path), "%s.snap", files[f]);
+        snprintf(write_option, sizeof(write_option), "--write-snapshot=%s", snapshot_path);
+
+        for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+            const BenchConfig *config = &configs[c];
+            char compressed_path[MAX_PATH];
+            if (config->compressor != NULL) {
+                snprintf(compressed_path, sizeof(compressed_path), "%s%s", files[f], config->suffix);
+                if (!compress_copy(config->compressor, files[f], compressed_path)) {
+                    printf("%-32s %-16s %8s\n", files[f], config->name, "skipped");
+                    continue;
+                }
+            }
+            char *args[MAX_ARGS];
+            int n = 0;
+            args[n++] = (char *)program;
+            args[n++] = config->snapshot == 2 ? snapshot_path : config->compressor != NULL ? compressed_path : files[f];
+            if (config->snapshot == 1) {
+                args[n++] = write_option;
+            } else if (config->option != NULL) {
+                args[n++] = (char *)config->option;
+            }
+            args[n] = NULL;
+
+            // MB/s is per byte of the input actually read: the snapshot or the compressed copy
+            struct stat input;
+            BenchResult result;
+            int ok = run_config(args, runs, &result) && stat(args[1], &input) == 0;
+            if (config->compressor != NULL) {
+                unlink(compressed_path);
+                if (!ok) {
+                    printf("%-32s %-16s %8s\n", files[f], config->name, "skipped");
+                    continue;
+                }
+            }
+            if (!ok) {
+                fprintf(stderr, "Error: %s %s failed\n", files[f], config->name);
+                unlink(snapshot_path);
+                return EXIT_FAILURE;
+            }
+            printf("%-32s %-16s %8.3f %12.0f %9.1f %10.1f %9.1f\n", files[f], config->name, result.best_sec,
+                   rows / result.best_sec, input.st_size / 1e6 / result.best_sec, st.st_size / 1e6 / result.best_sec,
+                   result.peak_rss_kb / 1024.0);
+            fflush(stdout);
+        }
+        unlink(snapshot_path);
+    }
+    return EXIT_SUCCESS;
+}
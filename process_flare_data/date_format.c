@@ -0,0 +1,271 @@
+/**
+    @file date_format.c
+    This program compiles and renders date formats. A format is either one of the three fixed layouts
+    the program has always accepted (YYYY-MM-DD, MM-DD-YYYY and MM/DD/YYYY) or a strftime-like string
+    using these conversions:
+
+        %Y year    %y 2-digit year    %C century        %m month       %b %h month abbreviation
+        %B month   %d day             %e space-padded   %j day of year %F %Y-%m-%d    %D %m/%d/%y
+        %G ISO year    %V ISO week    %u ISO weekday 1-7    %w weekday 0-6    %a %A weekday name
+        %H %M %S start time of day    %T %H:%M:%S    %s seconds since 1970-01-01    %% a percent sign
+
+    Compiling turns the format into steps once, so rendering a row is a loop over the steps that
+    writes digits directly, without parsing the format or calling sprintf.
+ */
+#include <string.h>
+#include "date_format.h"
+#include "flare_date.h"
+#include "flare_format.h"
+
+typedef enum {
+    OP_LITERAL, OP_YEAR, OP_YEAR2, OP_CENTURY, OP_MONTH, OP_MONTH_ABBR, OP_MONTH_NAME, OP_DAY, OP_DAY_SPACE,
+    OP_DAY_OF_YEAR, OP_ISO_YEAR, OP_ISO_WEEK, OP_ISO_WEEKDAY, OP_WEEKDAY, OP_WEEKDAY_ABBR, OP_WEEKDAY_NAME,
+    OP_HOUR, OP_MINUTE, OP_SECOND, OP_EPOCH
+} DateOp;
+
+/**
+    This function appends a step to a compiled format.
+    @param fmt Format being compiled
+    @param op Step to append
+    @param literal Text of a literal step, or NULL
+    @param len Length of the literal text
+    @return false if the format has no room left
+ */
+static bool add_step(DateFormat *fmt, DateOp op, const char *literal, int len)
+{
+    if (fmt->step_count == DATE_FORMAT_MAX_STEPS) {
+        return false;
+    }
+    DateStep *step = &fmt->steps[fmt->step_count];
+    step->op = (unsigned char)op;
+    step->len = 0;
+    step->start = 0;
+    if (op == OP_LITERAL) {
+        // Literals are stored in step order, so the last literal step ends the space in use
+        int used = 0;
+        for (int i = fmt->step_count - 1; i >= 0; i--) {
+            if (fmt->steps[i].op == OP_LITERAL) {
+                used = fmt->steps[i].start + fmt->steps[i].len;
+                break;
+            }
+        }
+        if (used + len > DATE_FORMAT_MAX_LITERAL) {
+            return false;
+        }
+        memcpy(fmt->literals + used, literal, len);
+
+        // Extend a literal step right before this one instead of adding another copy
+        if (fmt->step_count > 0 && step[-1].op == OP_LITERAL) {
+            step[-1].len += len;
+            return true;
+        }
+        step->start = (unsigned short)used;
+        step->len = (unsigned char)len;
+    }
+    if (op == OP_DAY_OF_YEAR || op == OP_ISO_YEAR || op == OP_ISO_WEEK || op == OP_ISO_WEEKDAY ||
+        op == OP_WEEKDAY || op == OP_WEEKDAY_ABBR || op == OP_WEEKDAY_NAME || op == OP_EPOCH) {
+        fmt->needs_days = true;
+    }
+    if (op == OP_HOUR || op == OP_MINUTE || op == OP_SECOND || op == OP_EPOCH) {
+        fmt->needs_time = true;
+    }
+    fmt->step_count++;
+    return true;
+}
+
+/**
+    This function compiles a strftime-like format.
+    @param spec Format to compile
+    @param fmt Compiled format
+    @return false if the format uses an unknown conversion or does not fit
+ */
+static bool compile_strftime(const char *spec, DateFormat *fmt)
+{
+    for (const char *p = spec; *p != '\0'; p++) {
+        if (*p != '%') {
+            if (!add_step(fmt, OP_LITERAL, p, 1)) {
+                return false;
+            }
+            continue;
+        }
+        bool ok;
+        switch (*++p) {
+        case 'Y': ok = add_step(fmt, OP_YEAR, NULL, 0); break;
+        case 'y': ok = add_step(fmt, OP_YEAR2, NULL, 0); break;
+        case 'C': ok = add_step(fmt, OP_CENTURY, NULL, 0); break;
+        case 'm': ok = add_step(fmt, OP_MONTH, NULL, 0); break;
+        case 'b': case 'h': ok = add_step(fmt, OP_MONTH_ABBR, NULL, 0); break;
+        case 'B': ok = add_step(fmt, OP_MONTH_NAME, NULL, 0); break;
+        case 'd': ok = add_step(fmt, OP_DAY, NULL, 0); break;
+        case 'e': ok = add_step(fmt, OP_DAY_SPACE, NULL, 0); break;
+        case 'j': ok = add_step(fmt, OP_DAY_OF_YEAR, NULL, 0); break;
+        case 'G': ok = add_step(fmt, OP_ISO_YEAR, NULL, 0); break;
+        case 'V': ok = add_step(fmt, OP_ISO_WEEK, NULL, 0); break;
+        case 'u': ok = add_step(fmt, OP_ISO_WEEKDAY, NULL, 0); break;
+        case 'w': ok = add_step(fmt, OP_WEEKDAY, NULL, 0); break;
+        case 'a': ok = add_step(fmt, OP_WEEKDAY_ABBR, NULL, 0); break;
+        case 'A': ok = add_step(fmt, OP_WEEKDAY_NAME, NULL, 0); break;
+        case 'H': ok = add_step(fmt, OP_HOUR, NULL, 0); break;
+        case 'M': ok = add_step(fmt, OP_MINUTE, NULL, 0); break;
+        case 'S': ok = add_step(fmt, OP_SECOND, NULL, 0); break;
+        case 's': ok = add_step(fmt, OP_EPOCH, NULL, 0); break;
+        case '%': ok = add_step(fmt, OP_LITERAL, "%", 1); break;
+        case 'F': ok = compile_strftime("%Y-%m-%d", fmt); break;
+        case 'D': ok = compile_strftime("%m/%d/%y", fmt); break;
+        case 'T': ok = compile_strftime("%H:%M:%S", fmt); break;
+        default: ok = false; break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+    This function compiles a --date-format argument. An empty argument prints dates as they appear.
+    The three fixed layouts and any format containing '%' are compiled into steps. Any other
+    10-character argument keeps the original behavior of printing the date unchanged.
+    @param spec Format to compile
+    @param fmt Compiled format
+    @return false if the format is invalid
+ */
+bool date_format_compile(const char *spec, DateFormat *fmt)
+{
+    static unsigned serial;
+    memset(fmt, 0, sizeof(*fmt));
+    fmt->serial = __atomic_add_fetch(&serial, 1, __ATOMIC_RELAXED);
+    if (spec[0] == '\0') {
+        fmt->mode = DATE_AS_IS;
+        return true;
+    }
+    fmt->mode = DATE_COMPILED;
+    if (strcmp(spec, "YYYY-MM-DD") == 0) {
+        return compile_strftime("%Y-%m-%d", fmt);
+    } else if (strcmp(spec, "MM-DD-YYYY") == 0) {
+        return compile_strftime("%m-%d-%Y", fmt);
+    } else if (strcmp(spec, "MM/DD/YYYY") == 0) {
+        return compile_strftime("%m/%d/%Y", fmt);
+    } else if (strchr(spec, '%') != NULL) {
+        return compile_strftime(spec, fmt);
+    }
+    fmt->mode = DATE_COPY;
+    return strlen(spec) == 10;
+}
+
+/**
+    This function writes a number padded with zeros after its sign, like the "%0*d" conversion.
+    @param p Output position
+    @param v Value to write
+    @param width Minimum number of characters
+    @return Position after the number
+ */
+static char *put_zero_padded(char *p, long long v, int width)
+{
+    char tmp[24];
+    char *s = tmp + sizeof(tmp);
+    unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    do {
+        *--s = (char)('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    int len = (int)(tmp + sizeof(tmp) - s);
+    if (v < 0) {
+        *p++ = '-';
+        width--;
+    }
+    for (; len < width; width--) {
+        *p++ = '0';
+    }
+    memcpy(p, s, len);
+    return p + len;
+}
+
+/**
+    This function copies a NUL-terminated name.
+    @param p Output position
+    @param s Name to copy
+    @return Position after the name
+ */
+static char *put_name(char *p, const char *s)
+{
+    size_t len = strlen(s);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+/**
+    This function renders a date with a compiled format. Fields that only need the calendar date
+    are written from year, month and day as given, so a date with an unknown month shows month 00
+    as before; day-number based fields are computed only if the format uses them and the date exists.
+    @param fmt Compiled format (mode DATE_COMPILED)
+    @param year Year
+    @param month Month (1 - 12)
+    @param day Day of the month
+    @param seconds Start time of day in seconds, for %H, %M, %S and %s
+    @param out Buffer of DATE_TEXT_MAX bytes for the text, NUL-terminated
+    @return Length of the text
+ */
+int date_format_render(const DateFormat *fmt, int year, int month, int day, int seconds, char *out)
+{
+    static const char *month_names[] = {
+        "January", "February", "March", "April", "May", "June",
+        "July", "August", "September", "October", "November", "December"
+    };
+    static const char *weekday_names[] = {
+        "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"
+    };
+
+    // Day number, weekday and ISO week, only when a step needs them and the date exists; for a date
+    // that does not, these fields print zeros and the weekday names print "???", as %B does
+    int days = 0, weekday = 0, iso_year = 0, iso_week = 0, day_of_year = 0;
+    bool real = !fmt->needs_days || valid_civil(year, month, day);
+    if (fmt->needs_days && real) {
+        days = days_from_civil(year, month, day);
+        weekday = ((days + 4) % 7 + 7) % 7; // 1970-01-01 was a Thursday
+        day_of_year = days - days_from_civil(year, 1, 1) + 1;
+
+        // The ISO week belongs to the year holding its Thursday
+        int thursday = days - (weekday == 0 ? 6 : weekday - 1) + 3;
+        int th_month, th_day;
+        civil_from_days(thursday, &iso_year, &th_month, &th_day);
+        iso_week = (thursday - days_from_civil(iso_year, 1, 1)) / 7 + 1;
+    }
+
+    char *p = out;
+    for (int i = 0; i < fmt->step_count; i++) {
+        const DateStep *step = &fmt->steps[i];
+        switch ((DateOp)step->op) {
+        case OP_LITERAL: memcpy(p, fmt->literals + step->start, step->len); p += step->len; break;
+        case OP_YEAR: p = put_zero_padded(p, year, 4); break;
+        case OP_YEAR2: p = put_zero_padded(p, ((year % 100) + 100) % 100, 2); break;
+        case OP_CENTURY: p = put_zero_padded(p, year / 100, 2); break;
+        case OP_MONTH: p = put_zero_padded(p, month, 2); break;
+        case OP_MONTH_ABBR: p = put_name(p, month_abbreviation(month)); break;
+        case OP_MONTH_NAME: p = put_name(p, month >= 1 && month <= 12 ? month_names[month - 1] : "???"); break;
+        case OP_DAY: p = put_zero_padded(p, day, 2); break;
+        case OP_DAY_SPACE:
+            if (day >= 0 && day < 10) {
+                *p++ = ' ';
+            }
+            p = put_zero_padded(p, day, 1);
+            break;
+        case OP_DAY_OF_YEAR: p = put_zero_padded(p, day_of_year, 3); break;
+        case OP_ISO_YEAR: p = put_zero_padded(p, iso_year, 4); break;
+        case OP_ISO_WEEK: p = put_zero_padded(p, iso_week, 2); break;
+        case OP_ISO_WEEKDAY: p = put_zero_padded(p, !real ? 0 : weekday == 0 ? 7 : weekday, 1); break;
+        case OP_WEEKDAY: p = put_zero_padded(p, weekday, 1); break;
+        case OP_WEEKDAY_ABBR:
+            memcpy(p, real ? weekday_names[weekday] : "???", 3);
+            p += 3;
+            break;
+        case OP_WEEKDAY_NAME: p = put_name(p, real ? weekday_names[weekday] : "???"); break;
+        case OP_HOUR: p = put_zero_padded(p, seconds / 3600, 2); break;
+        case OP_MINUTE: p = put_zero_padded(p, seconds / 60 % 60, 2); break;
+        case OP_SECOND: p = put_zero_padded(p, seconds % 60, 2); break;
+        case OP_EPOCH: p = put_zero_padded(p, real ? (long long)days * SECOND_PER_DAY + seconds : 0, 1); break;
+        }
+    }
+    *p = '\0';
+    return (int)(p - out);
+}
@@ -0,0 +1,43 @@
+/**
+     @file date_format.h
+     This header file defines the date format engine. A --date-format argument is compiled once into a
+     short sequence of steps, which is then run for every row to render its start date.
+ */
+#ifndef DATE_FORMAT_H
+#define DATE_FORMAT_H
+
+#include <stdbool.h>
+
+#define DATE_FORMAT_MAX_STEPS 32 // Most steps in a compiled format
+#define DATE_FORMAT_MAX_LITERAL 64 // Most literal characters in a compiled format
+#define DATE_TEXT_MAX 1024 // Room for any rendered date, with its NUL
+
+typedef enum {
+    DATE_AS_IS,    // No format given: print the date as it appears, in a 12-character column
+    DATE_COPY,     // Unsupported format: print the date as it appears, in an 11-character column
+    DATE_COMPILED  // Render the date with the compiled steps, in an 11-character column
+} DateMode;
+
+typedef struct {
+    unsigned char op;     // What the step writes (a DateOp from date_format.c)
+    unsigned char len;    // Length of a literal step
+    unsigned short start; // Start of a literal step in literals
+} DateStep;
+
+typedef struct {
+    DateMode mode;                          // How the date column is printed
+    int step_count;                         // Number of steps
+    DateStep steps[DATE_FORMAT_MAX_STEPS];  // Steps in output order
+    char literals[DATE_FORMAT_MAX_LITERAL]; // Text copied by literal steps
+    bool needs_days;                        // Set if a step needs the day number of the date
+    bool needs_time;                        // Set if a step needs the start time, so the text is not the same for every row of a date
+    unsigned serial;                        // Distinct for every compiled format, so rendered dates can be cached by it
+} DateFormat;
+
+// Compile a --date-format argument, returning false if it uses an unknown conversion or is too long
+bool date_format_compile(const char *spec, DateFormat *fmt);
+
+// Render a date and start time of day with a compiled format, returning the length written to out
+int date_format_render(const DateFormat *fmt, int year, int month, int day, int seconds, char *out);
+
+#endif
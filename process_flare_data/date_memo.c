@@ -0,0 +1,147 @@
+/**
+    @file date_memo.c
+    This program keeps a memo of converted start dates for each thread. Dates are interned in a
+    string dictionary, so a date's code indexes its converted text directly. Each thread has its own
+    memo, so no lock is taken per row; the memo is released when its thread exits.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "date_memo.h"
+
+static __thread DateMemo *thread_memo;  // Memo of the calling thread, created on first use
+static pthread_key_t memo_key;           // Releases a thread's memo when the thread exits
+static pthread_once_t memo_key_once = PTHREAD_ONCE_INIT;
+
+/**
+    This function reallocates an array, exiting if memory runs out.
+    @param p Array to grow
+    @param size New size in bytes
+    @return The reallocated array
+ */
+static void *grow(void *p, size_t size)
+{
+    p = realloc(p, size);
+    if (p == NULL) {
+        fprintf(stderr, "Error: out of memory in date_memo.\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/**
+    This function empties a memo and ties it to a format.
+    @param memo Memo to reset
+    @param serial Serial of the format its dates will be converted with
+ */
+static void reset_memo(DateMemo *memo, unsigned serial)
+{
+    dict_free(&memo->dates);
+    dict_init(&memo->dates);
+    memo->serial = serial;
+    memo->text_len = 0;
+    memo->last = 0;
+}
+
+/**
+    This function releases a thread's memo when the thread exits.
+    @param p Memo to release
+ */
+static void free_memo(void *p)
+{
+    DateMemo *memo = p;
+    dict_free(&memo->dates);
+    free(memo->text_chars);
+    free(memo->text_ends);
+    free(memo);
+}
+
+/**
+    This function creates the key that releases memos at thread exit.
+ */
+static void make_memo_key(void)
+{
+    if (pthread_key_create(&memo_key, free_memo) != 0) {
+        fprintf(stderr, "Error: cannot create the date memo key.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+    This function returns the memo of the calling thread, creating it on first use. A memo filled
+    for another format is emptied first.
+    @param format Format the dates are converted with
+    @return The memo of the calling thread
+ */
+DateMemo *date_memo_thread(const DateFormat *format)
+{
+    DateMemo *memo = thread_memo;
+    if (memo == NULL) {
+        pthread_once(&memo_key_once, make_memo_key);
+        memo = grow(NULL, sizeof(DateMemo));
+        memset(memo, 0, sizeof(*memo));
+        dict_init(&memo->dates);
+        memo->serial = format->serial;
+        pthread_setspecific(memo_key, memo);
+        thread_memo = memo;
+    } else if (memo->serial != format->serial) {
+        reset_memo(memo, format->serial);
+    }
+    return memo;
+}
+
+/**
+    This function returns the converted text of a start date. Rows come sorted by date, so the date
+    found last is tried before the dictionary.
+    @param memo Memo to search
+    @param date Start date as it appears in the input
+    @param len Length of the converted text
+    @return The converted text (not NUL-terminated), or NULL if the date has not been stored
+ */
+const char *date_memo_find(DateMemo *memo, Field date, int *len)
+{
+    if (memo->dates.count == 0) {
+        return NULL;
+    }
+    int last_len;
+    const char *last = dict_string(&memo->dates, memo->last, &last_len);
+    uint32_t code = memo->last;
+    if (last_len != date.len || memcmp(last, date.ptr, date.len) != 0) {
+        code = dict_find(&memo->dates, date.ptr, date.len);
+        if (code == DICT_ABSENT) {
+            return NULL;
+        }
+        memo->last = code;
+    }
+    uint32_t start = code > 0 ? memo->text_ends[code - 1] : 0;
+    *len = (int)(memo->text_ends[code] - start);
+    return memo->text_chars + start;
+}
+
+/**
+    This function remembers the converted text of a start date that date_memo_find did not hold.
+    @param memo Memo to add to
+    @param date Start date as it appears in the input
+    @param text Converted text
+    @param len Length of the converted text
+ */
+void date_memo_store(DateMemo *memo, Field date, const char *text, int len)
+{
+    if (memo->dates.count >= DATE_MEMO_MAX) {
+        return;
+    }
+    if (memo->text_len + len > memo->text_cap) {
+        memo->text_cap = (memo->text_len + len) * 2 + 256;
+        memo->text_chars = grow(memo->text_chars, memo->text_cap);
+    }
+    if (memo->dates.count == memo->ends_cap) {
+        memo->ends_cap = memo->ends_cap ? memo->ends_cap * 2 : 64;
+        memo->text_ends = grow(memo->text_ends, memo->ends_cap * sizeof(uint32_t));
+    }
+    uint32_t code = dict_intern(&memo->dates, date.ptr, date.len);
+    memcpy(memo->text_chars + memo->text_len, text, len);
+    memo->text_len += len;
+    memo->text_ends[code] = (uint32_t)memo->text_len;
+    memo->last = code;
+}
@@ -0,0 +1,38 @@
+/**
+     @file date_memo.h
+     This header file defines the memo of converted start dates. A flare list repeats each start date
+     for every flare of that day, so a date is converted with a compiled format the first time a
+     thread sees it, and later rows with the same date copy the stored text.
+ */
+#ifndef DATE_MEMO_H
+#define DATE_MEMO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "date_format.h"
+#include "flare_parse.h"
+#include "string_dict.h"
+
+#define DATE_MEMO_MAX 65536 // Most dates a memo holds; dates seen after it is full are converted every time
+
+typedef struct {
+    unsigned serial;     // Serial of the format the dates were converted with
+    StringDict dates;    // Start dates as they appear in the input
+    char *text_chars;    // Converted dates, back to back in code order
+    size_t text_len;     // Bytes in use in text_chars
+    size_t text_cap;     // Allocated size of text_chars
+    uint32_t *text_ends; // Converted date c ends at text_ends[c] and starts where date c - 1 ends
+    uint32_t ends_cap;   // Allocated entries of text_ends
+    uint32_t last;       // Code of the date found or stored last
+} DateMemo;
+
+// Return the calling thread's memo for dates converted with format, emptying it if it holds another format's dates
+DateMemo *date_memo_thread(const DateFormat *format);
+
+// Return the converted text of a start date and store its length in len, or NULL if the memo does not hold it
+const char *date_memo_find(DateMemo *memo, Field date, int *len);
+
+// Remember the converted text of a start date, unless the memo is full
+void date_memo_store(DateMemo *memo, Field date, const char *text, int len);
+
+#endif
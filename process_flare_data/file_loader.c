@@ -0,0 +1,481 @@
+/**
+    @file file_loader.c
+    This program reads whole files into memory for the batch workers. The io_uring backend talks to
+    the kernel through the raw io_uring_setup and io_uring_enter system calls and the two shared
+    rings, so it needs no library. A loader thread opens the files in order, queues one read per file
+    in the submission ring, and hands each buffer to the workers when its completion arrives; a
+    short read is queued again for the rest of the file. It stays at most LOADER_DEPTH files and
+    about LOADER_MAX_BYTES ahead of the workers, which release each file when they are done with it.
+    If io_uring is unavailable, because the kernel lacks it or a sandbox forbids it, the workers
+    read their files with pread instead.
+ */
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#include "file_loader.h"
+#include "flare_stats.h"
+
+typedef enum {
+    FILE_WAITING,  // Not opened yet
+    FILE_READING,  // Read in flight
+    FILE_LOADED,   // Contents in data
+    FILE_FAILED,   // Could not be opened or read
+    FILE_RELEASED  // Released by its worker
+} FileState;
+
+typedef struct {
+    char *data;        // Contents of the file
+    size_t size;       // Size of the file when it was opened
+    size_t done;       // Bytes read so far
+    int fd;            // Open file while its read is in flight
+    struct iovec iov;  // Rest of the file, for the read in flight
+    FileState state;   // Where the file is; guarded by the loader lock once it is loaded
+} LoadedFile;
+
+#ifdef __linux__
+typedef struct {
+    int fd;                     // io_uring instance
+    unsigned *sq_tail;          // Submission ring tail, advanced by this program
+    unsigned *sq_mask;          // Submission ring index mask
+    unsigned *sq_array;         // Submission ring of indexes into sqes
+    unsigned *cq_head;          // Completion ring head, advanced by this program
+    unsigned *cq_tail;          // Completion ring tail, advanced by the kernel
+    unsigned *cq_mask;          // Completion ring index mask
+    struct io_uring_sqe *sqes;  // Submission queue entries
+    struct io_uring_cqe *cqes;  // Completion queue entries
+    void *sq_ring;              // Mapping of the submission ring
+    void *cq_ring;              // Mapping of the completion ring, the same as sq_ring on newer kernels
+    size_t sq_ring_size;        // Length of the sq_ring mapping
+    size_t cq_ring_size;        // Length of the cq_ring mapping
+    size_t sqes_size;           // Length of the sqes mapping
+    unsigned unsubmitted;       // Entries queued since the last io_uring_enter
+} Uring;
+#endif
+
+struct FileLoader {
+    char *const *paths;     // Files to load
+    int count;              // Number of files
+    LoadedFile *files;      // State and contents of each file
+    bool uring;             // Set if the loader thread reads through io_uring
+#ifdef __linux__
+    Uring ring;             // io_uring instance of the loader thread
+#endif
+    pthread_t thread;       // Loader thread
+    pthread_mutex_t lock;   // Guards the file states, held, and held_bytes
+    pthread_cond_t changed; // Signaled when a file is loaded or released
+    int next;               // Next file to open; used only by the loader thread
+    int held;               // Files opened and not yet released
+    size_t held_bytes;      // Bytes of the files opened and not yet released
+};
+
+/**
+    This function allocates memory, exiting if it runs out.
+    @param size Number of bytes
+    @return The memory
+ */
+static void *checked_malloc(size_t size)
+{
+    void *p = malloc(size > 0 ? size : 1);
+    if (p == NULL) {
+        fprintf(stderr, "Error: out of memory in file_loader.\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/**
+    This function opens a regular file and allocates room for its contents.
+    @param path Name of the file
+    @param f File to fill in
+    @return false if the file cannot be opened or is not a regular file
+ */
+static bool open_file(const char *path, LoadedFile *f)
+{
+    f->fd = open(path, O_RDONLY);
+    if (f->fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(f->fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(f->fd);
+        return false;
+    }
+    f->size = (size_t)st.st_size;
+    f->done = 0;
+    f->data = checked_malloc(f->size);
+    return true;
+}
+
+/**
+    This function reads a whole file with pread on the calling thread.
+    @param path Name of the file
+    @param f File to fill in
+    @return false if the file cannot be opened or read
+ */
+static bool pread_file(const char *path, LoadedFile *f)
+{
+    if (!open_file(path, f)) {
+        return false;
+    }
+    while (f->done < f->size) {
+        ssize_t got = pread(f->fd, f->data + f->done, f->size - f->done, (off_t)f->done);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            close(f->fd);
+            free(f->data);
+            f->data = NULL;
+            return false;
+        }
+        if (got == 0) {
+            break; // The file shrank since it was opened
+        }
+        f->done += (size_t)got;
+    }
+    close(f->fd);
+    stats_add(COUNT_BYTES_IN, (long long)f->done);
+    return true;
+}
+
+#ifdef __linux__
+/**
+    This function creates an io_uring instance and maps its rings.
+    @param r Instance to fill in
+    @param entries Number of submission entries wanted
+    @return false if the kernel does not provide io_uring or refuses it
+ */
+static bool uring_init(Uring *r, unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+    long fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) {
+        return false;
+    }
+    r->fd = (int)fd;
+    r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    // Newer kernels share one mapping between both rings
+    bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && r->cq_ring_size > r->sq_ring_size) {
+        r->sq_ring_size = r->cq_ring_size;
+    }
+    r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd, IORING_OFF_SQ_RING);
+    r->cq_ring = single ? r->sq_ring
+                        : mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd, IORING_OFF_CQ_RING);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd, IORING_OFF_SQES);
+    if (r->sq_ring == MAP_FAILED || r->cq_ring == MAP_FAILED || r->sqes == MAP_FAILED) {
+        close(r->fd);
+        return false;
+    }
+
+    char *sq = r->sq_ring, *cq = r->cq_ring;
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return true;
+}
+
+/**
+    This function unmaps the rings and closes an io_uring instance.
+    @param r Instance to release
+ */
+static void uring_free(Uring *r)
+{
+    munmap(r->sqes, r->sqes_size);
+    if (r->cq_ring != r->sq_ring) {
+        munmap(r->cq_ring, r->cq_ring_size);
+    }
+    munmap(r->sq_ring, r->sq_ring_size);
+    close(r->fd);
+}
+
+/**
+    This function queues a read of the rest of a file. The kernel sees it at the next uring_enter.
+    @param r Instance to queue on
+    @param f File to read
+    @param index Index of the file, returned with the completion
+ */
+static void uring_queue_read(Uring *r, LoadedFile *f, int index)
+{
+    unsigned tail = *r->sq_tail;
+    unsigned slot = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[slot];
+    f->iov.iov_base = f->data + f->done;
+    f->iov.iov_len = f->size - f->done;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = f->fd;
+    sqe->off = f->done;
+    sqe->addr = (uint64_t)(uintptr_t)&f->iov;
+    sqe->len = 1;
+    sqe->user_data = (uint64_t)index;
+    r->sq_array[slot] = slot;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->unsubmitted++;
+}
+
+/**
+    This function submits the queued reads and waits until at least one has completed.
+    @param r Instance to submit on
+ */
+static void uring_enter(Uring *r)
+{
+    for (;;) {
+        long rc = syscall(__NR_io_uring_enter, r->fd, r->unsubmitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (rc >= 0) {
+            r->unsubmitted -= (unsigned)rc;
+            return;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            fprintf(stderr, "Error: io_uring_enter failed.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+#endif
+
+/**
+    This function records that a file has been read or has failed, and wakes the workers.
+    @param l Loader
+    @param f File that finished
+    @param ok true if the file was read
+ */
+static void finish_file(FileLoader *l, LoadedFile *f, bool ok)
+{
+    if (!ok) {
+        free(f->data);
+        f->data = NULL;
+    }
+    pthread_mutex_lock(&l->lock);
+    f->state = ok ? FILE_LOADED : FILE_FAILED;
+    pthread_cond_broadcast(&l->changed);
+    pthread_mutex_unlock(&l->lock);
+}
+
+#ifdef __linux__
+/**
+    This function handles the completions that have arrived. A read that stopped short of the end
+    of its file is queued again for the rest; the file is done when it is complete or at its end.
+    @param l Loader
+    @param in_flight Number of files being read, which this function lowers
+ */
+static void reap_completions(FileLoader *l, int *in_flight)
+{
+    Uring *r = &l->ring;
+    unsigned head = *r->cq_head;
+    while (head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        int index = (int)cqe->user_data;
+        LoadedFile *f = &l->files[index];
+        int res = cqe->res;
+        head++;
+
+        if (res == -EINTR || res == -EAGAIN) {
+            uring_queue_read(r, f, index);
+            continue;
+        }
+        if (res > 0) {
+            f->done += (size_t)res;
+            stats_add(COUNT_BYTES_IN, res);
+            if (f->done < f->size) {
+                uring_queue_read(r, f, index);
+                continue;
+            }
+        }
+        // Complete, at an end of file that moved since it was opened, or failed
+        close(f->fd);
+        finish_file(l, f, res >= 0);
+        (*in_flight)--;
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/**
+    This function is the body of the loader thread. It opens files in order while the loader is
+    within its limits, queues their reads, and waits on the ring for completions; when it may not
+    open more and nothing is in flight, it waits for the workers to release files instead.
+    @param arg The FileLoader
+    @return NULL
+ */
+static void *loader_thread(void *arg)
+{
+    FileLoader *l = arg;
+    int in_flight = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&l->lock);
+        while (l->next < l->count && l->held < LOADER_DEPTH && l->held_bytes < LOADER_MAX_BYTES) {
+            int i = l->next++;
+            LoadedFile *f = &l->files[i];
+            l->held++;
+            pthread_mutex_unlock(&l->lock);
+
+            bool opened = open_file(l->paths[i], f);
+            if (opened && f->size > 0) {
+                f->state = FILE_READING;
+                uring_queue_read(&l->ring, f, i);
+                in_flight++;
+            } else {
+                if (opened) {
+                    close(f->fd);
+                }
+                finish_file(l, f, opened);
+            }
+
+            pthread_mutex_lock(&l->lock);
+            l->held_bytes += f->size;
+        }
+        bool done = l->next == l->count && in_flight == 0;
+        if (!done && in_flight == 0) {
+            pthread_cond_wait(&l->changed, &l->lock);
+        }
+        pthread_mutex_unlock(&l->lock);
+        if (done) {
+            break;
+        }
+        if (in_flight > 0) {
+            uring_enter(&l->ring);
+            reap_completions(l, &in_flight);
+        }
+    }
+    stats_merge_thread();
+    return NULL;
+}
+#endif
+
+/**
+    This function creates a loader for a list of files. With io_uring it starts the loader thread,
+    which begins reading right away; otherwise files are read when the workers ask for them.
+    @param paths Names of the files
+    @param count Number of files
+    @param use_uring true to read through io_uring when it is available
+    @return The loader
+ */
+FileLoader *loader_start(char *const *paths, int count, bool use_uring)
+{
+    FileLoader *l = checked_malloc(sizeof(FileLoader));
+    memset(l, 0, sizeof(*l));
+    l->paths = paths;
+    l->count = count;
+    l->files = checked_malloc(count * sizeof(LoadedFile));
+    memset(l->files, 0, count * sizeof(LoadedFile));
+    pthread_mutex_init(&l->lock, NULL);
+    pthread_cond_init(&l->changed, NULL);
+
+#ifdef __linux__
+    // Twice the depth leaves room to queue the rest of short reads alongside new files
+    if (use_uring && count > 0 && uring_init(&l->ring, 2 * LOADER_DEPTH)) {
+        l->uring = true;
+        if (pthread_create(&l->thread, NULL, loader_thread, l) != 0) {
+            fprintf(stderr, "Error: cannot create the loader thread.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+#else
+    (void)use_uring;
+#endif
+    return l;
+}
+
+/**
+    This function tells whether a loader reads through io_uring.
+    @param l Loader
+    @return true for io_uring, false for pread
+ */
+bool loader_uses_uring(const FileLoader *l)
+{
+    return l->uring;
+}
+
+/**
+    This function returns the contents of a file, waiting for the loader thread to read it, or
+    reading it on the calling thread when there is no loader thread.
+    @param l Loader
+    @param i Index of the file
+    @param data Set to the contents of the file (NULL if it is empty)
+    @param size Set to the number of bytes read
+    @return false if the file cannot be opened or read
+ */
+bool loader_get(FileLoader *l, int i, const char **data, size_t *size)
+{
+    LoadedFile *f = &l->files[i];
+    if (!l->uring) {
+        bool ok = pread_file(l->paths[i], f);
+        f->state = ok ? FILE_LOADED : FILE_FAILED;
+    } else {
+        pthread_mutex_lock(&l->lock);
+        while (f->state == FILE_WAITING || f->state == FILE_READING) {
+            pthread_cond_wait(&l->changed, &l->lock);
+        }
+        pthread_mutex_unlock(&l->lock);
+    }
+    *data = f->size > 0 ? f->data : NULL;
+    *size = f->done;
+    return f->state == FILE_LOADED;
+}
+
+/**
+    This function releases the contents of a file, after its worker is done with it.
+    @param l Loader
+    @param i Index of the file
+ */
+void loader_release(FileLoader *l, int i)
+{
+    LoadedFile *f = &l->files[i];
+    free(f->data);
+    f->data = NULL;
+    pthread_mutex_lock(&l->lock);
+    f->state = FILE_RELEASED;
+    if (l->uring) {
+        l->held--;
+        l->held_bytes -= f->size;
+        pthread_cond_broadcast(&l->changed);
+    }
+    pthread_mutex_unlock(&l->lock);
+}
+
+/**
+    This function waits for the loader thread to finish and releases the loader. Every file must
+    have been asked for, so the thread has nothing left to read.
+    @param l Loader to release
+ */
+void loader_finish(FileLoader *l)
+{
+#ifdef __linux__
+    if (l->uring) {
+        pthread_join(l->thread, NULL);
+        uring_free(&l->ring);
+    }
+#endif
+    for (int i = 0; i < l->count; i++) {
+        free(l->files[i].data);
+    }
+    pthread_mutex_destroy(&l->lock);
+    pthread_cond_destroy(&l->changed);
+    free(l->files);
+    free(l);
+}
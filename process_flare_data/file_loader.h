@@ -0,0 +1,34 @@
+/**
+     @file file_loader.h
+     This header file defines a loader that reads a list of whole files into memory ahead of the
+     threads that process them. With io_uring, one thread keeps many reads in flight at once, so
+     cold files arrive in parallel while the workers parse the ones already loaded. Without it,
+     each worker reads its own file with pread when it asks for it.
+ */
+#ifndef FILE_LOADER_H
+#define FILE_LOADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define LOADER_DEPTH 32 // Files the io_uring loader keeps in flight or loaded ahead of the workers
+#define LOADER_MAX_BYTES ((size_t)256 << 20) // Bytes the loader holds before it waits for workers to release files
+
+typedef struct FileLoader FileLoader;
+
+// Start loading count files in order, through io_uring if use_uring is set and the kernel allows it, or with pread
+FileLoader *loader_start(char *const *paths, int count, bool use_uring);
+
+// Return true if the loader reads through io_uring
+bool loader_uses_uring(const FileLoader *l);
+
+// Wait for file i and return its contents in data and size, or false if it cannot be read
+bool loader_get(FileLoader *l, int i, const char **data, size_t *size);
+
+// Release the contents of file i, letting the loader read further ahead
+void loader_release(FileLoader *l, int i);
+
+// Wait for the loader thread and release the loader
+void loader_finish(FileLoader *l);
+
+#endif
@@ -0,0 +1,173 @@
+/**
+    @file fixed_decimal.c
+    This program provides fixed-point decimal values for the peaks, rates, and total counts of a
+    flare list. Values are carried as scaled 128-bit integers, so they are exact, and they are
+    reduced to fractions by cancelling powers of two and five instead of by a GCD.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "fixed_decimal.h"
+
+typedef __int128 int128;          // Scaled value of a decimal
+typedef unsigned __int128 uint128;
+
+// Powers of ten that fit in int64, indexed by exponent
+static const int64 powers_of_ten[FIXED_SCALE_MAX + 1] = {
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL, 1000000000LL,
+    10000000000LL, 100000000000LL, 1000000000000LL, 10000000000000LL, 100000000000000LL,
+    1000000000000000LL, 10000000000000000LL, 100000000000000000LL, 1000000000000000000LL
+};
+
+// Powers of five up to the largest scale, indexed by exponent
+static const int64 powers_of_five[FIXED_SCALE_MAX + 1] = {
+    1LL, 5LL, 25LL, 125LL, 625LL, 3125LL, 15625LL, 78125LL, 390625LL, 1953125LL, 9765625LL, 48828125LL,
+    244140625LL, 1220703125LL, 6103515625LL, 30517578125LL, 152587890625LL, 762939453125LL, 3814697265625LL
+};
+
+/**
+    This function counts the trailing zero bits of a nonzero 128-bit value.
+    @param x Value to check
+    @return Number of trailing zero bits
+ */
+static int ctz128(uint128 x)
+{
+    unsigned long long low = (unsigned long long)x;
+    return low != 0 ? __builtin_ctzll(low) : 64 + __builtin_ctzll((unsigned long long)(x >> 64));
+}
+
+/**
+    This function converts an integer part and a decimal part into a fixed-point decimal. As in
+    from_decimal_parts, the decimal part moves the value away from zero. An int64 times 10^18
+    always fits in 128 bits, so no input can overflow.
+    @param input Decimal parts [integer_part, decimal_part, decimal_length]
+    @param d Decimal to store the result in
+    @return true on success, false if the decimal length is outside 0 - FIXED_SCALE_MAX
+ */
+bool fixed_from_decimal(const DecimalParts input, FixedDecimal *d)
+{
+    int64 integer_part = input[0];
+    int64 decimal_part = input[1];
+    int64 decimal_length = input[2];
+    if (decimal_length < 0 || decimal_length > FIXED_SCALE_MAX) {
+        return false;
+    }
+
+    int128 units = (int128)integer_part * powers_of_ten[decimal_length];
+    d->units = integer_part >= 0 ? units + decimal_part : units - decimal_part;
+    d->scale = (int)decimal_length;
+    return true;
+}
+
+/**
+    This function multiplies a fixed-point decimal by an integer. The scale is unchanged, so the
+    product is exact whenever it fits.
+    @param a Decimal to multiply
+    @param k Integer to multiply by
+    @param result Decimal to store the product in (may be a)
+    @return true on success, false if the product does not fit in 128 bits
+ */
+bool fixed_multiply_int(const FixedDecimal *a, int64 k, FixedDecimal *result)
+{
+    int128 units;
+    if (__builtin_mul_overflow(a->units, (int128)k, &units)) {
+        return false;
+    }
+    result->units = units;
+    result->scale = a->scale;
+    return true;
+}
+
+/**
+    This function stores a fixed-point decimal as a fraction in lowest terms. The denominator
+    10^scale has no prime factors but 2 and 5, so the common factors of two are cancelled with one
+    count of trailing zeros, and the factors of five by at most scale divisions by five.
+    @param d Decimal to convert
+    @param f Fraction to store the result in
+    @return true on success, false if the reduced fraction does not fit in int64
+ */
+bool fixed_to_fraction(const FixedDecimal *d, Fraction f)
+{
+    if (d->units == 0) {
+        f[0] = 0;
+        f[1] = 1;
+        return true;
+    }
+    uint128 magnitude = d->units < 0 ? (uint128)0 - (uint128)d->units : (uint128)d->units;
+
+    // Factors of 2 and 5 left in the denominator
+    int twos = d->scale;
+    int fives = d->scale;
+    int shift = ctz128(magnitude);
+    if (shift > twos) {
+        shift = twos;
+    }
+    magnitude >>= shift;
+    twos -= shift;
+
+    // Most values fit in 64 bits by now, where dividing by five is a multiply
+    if (magnitude <= UINT64_MAX) {
+        unsigned long long m = (unsigned long long)magnitude;
+        while (fives > 0 && m % 5 == 0) {
+            m /= 5;
+            fives--;
+        }
+        magnitude = m;
+    } else {
+        while (fives > 0 && magnitude % 5 == 0) {
+            magnitude /= 5;
+            fives--;
+        }
+    }
+    if (magnitude > INT64_MAX) {
+        return false;
+    }
+
+    // 5^fives * 2^twos divides 10^scale, so it fits
+    f[0] = d->units < 0 ? -(int64)magnitude : (int64)magnitude;
+    f[1] = powers_of_five[fives] << twos;
+    return true;
+}
+
+/**
+    This function writes a fixed-point decimal with all of its decimal places, such as
+    "-12.3400000000". A decimal with no places is written as a whole number.
+    @param d Decimal to write
+    @param buf Buffer of FIXED_TEXT_MAX bytes to hold the text
+    @return The length of the text
+ */
+int fixed_format(const FixedDecimal *d, char *buf)
+{
+    uint128 magnitude = d->units < 0 ? (uint128)0 - (uint128)d->units : (uint128)d->units;
+
+    // Write the digits backwards, with at least one digit before the point
+    char digits[FIXED_TEXT_MAX];
+    char *p = digits + sizeof(digits);
+    int count = 0;
+    while (magnitude > UINT64_MAX) {
+        *--p = (char)('0' + (int)(magnitude % 10));
+        magnitude /= 10;
+        count++;
+    }
+    unsigned long long m = (unsigned long long)magnitude;
+    while (m != 0 || count <= d->scale) {
+        *--p = (char)('0' + (int)(m % 10));
+        m /= 10;
+        count++;
+    }
+
+    char *q = buf;
+    if (d->units < 0) {
+        *q++ = '-';
+    }
+    int whole = count - d->scale;
+    memcpy(q, p, whole);
+    q += whole;
+    if (d->scale > 0) {
+        *q++ = '.';
+        memcpy(q, p + whole, d->scale);
+        q += d->scale;
+    }
+    *q = '\0';
+    return (int)(q - buf);
+}
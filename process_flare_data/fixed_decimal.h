@@ -0,0 +1,35 @@
+/**
+     @file fixed_decimal.h
+     This header file defines fixed-point decimals: values held as a whole number of units of
+     10^-scale. The flare lists give peaks to 3 places and rates to 10, so these values, and a
+     rate times a whole duration, are exact without any fraction arithmetic. Because the
+     denominator is a power of ten, turning a value into a fraction in lowest terms only cancels
+     factors of 2 and 5, and needs no GCD.
+ */
+#ifndef FIXED_DECIMAL_H
+#define FIXED_DECIMAL_H
+
+#include <stdbool.h>
+#include "fraction.h"
+
+#define FIXED_SCALE_MAX 18 // Most decimal places a fixed-point decimal can have
+#define FIXED_TEXT_MAX 48 // Room for the text of any fixed-point decimal, with its NUL
+
+typedef struct {
+    __int128 units; // Value times 10^scale
+    int scale;      // Number of decimal places (0 - FIXED_SCALE_MAX)
+} FixedDecimal;
+
+// Set d to the value of decimal parts, as from_decimal_parts reads them, returning false on an invalid length
+bool fixed_from_decimal(const DecimalParts input, FixedDecimal *d);
+
+// Multiply a decimal by an integer: a * k → result (result may be a), returning false on overflow
+bool fixed_multiply_int(const FixedDecimal *a, int64 k, FixedDecimal *result);
+
+// Store d as a fraction in lowest terms without calling gcd(), returning false if it does not fit in int64
+bool fixed_to_fraction(const FixedDecimal *d, Fraction f);
+
+// Write d with all of its decimal places into buf (FIXED_TEXT_MAX bytes), returning the length of the text
+int fixed_format(const FixedDecimal *d, char *buf);
+
+#endif
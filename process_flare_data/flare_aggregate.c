@@ -0,0 +1,598 @@
+/**
+    @file flare_aggregate.c
+    This program summarizes a flare list per day or per month. Worker threads claim chunks of a text
+    list at line boundaries, or ranges of records of a snapshot, and add every flare to a hash map of
+    periods of their own, so they never share a counter. A flare's total count is a rate with
+    AVG_DECIMAL_LENGTH places times a whole duration, so each worker sums it exactly as a 128-bit
+    number of units of 10^-AVG_DECIMAL_LENGTH, and only a sum that would overflow is carried in a
+    Rational. Once the workers finish, their partial sums are merged the same way: units are added
+    to units, and only a part that would overflow them joins the Rational, which is exact at any
+    size. The periods are then written in date order, a sum held entirely in units as an exact
+    decimal when that layout is asked for.
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fixed_decimal.h"
+#include "flare_aggregate.h"
+#include "flare_date.h"
+#include "flare_format.h"
+#include "flare_index.h"
+#include "flare_parse.h"
+#include "flare_snapshot.h"
+#include "flare_stats.h"
+#include "flare_table.h"
+#include "out_buffer.h"
+#include "rational.h"
+
+#define UNITS_PER_COUNT 10000000000LL // 10^AVG_DECIMAL_LENGTH, the units a total count is summed in
+
+typedef struct {
+    int32_t key;               // Days since 1970-01-01, or months since year 0
+    long long flares;          // Flares starting in the period
+    __int128 units;            // Summed total counts in units of 10^-AVG_DECIMAL_LENGTH
+    Rational total;            // Summed total counts that did not fit units
+    long long bins[PEAK_BINS]; // Flares in each peak bin
+} Bucket;
+
+typedef struct {
+    uint32_t *slots;      // Open-addressing table of bucket indexes plus one, 0 for an empty slot
+    uint32_t cap;         // Number of slots, a power of two
+    Bucket *buckets;      // Periods in the order they were first seen
+    uint32_t count;       // Periods in buckets
+    uint32_t bucket_cap;  // Allocated entries of buckets
+    uint32_t last;        // Bucket found last, tried first since rows come sorted by date
+    ProcessCounts counts; // Flares added and malformed lines skipped
+} BucketMap;
+
+typedef struct {
+    const char *pos;        // Start of the text not yet handed to a worker
+    const char *end;        // End of the text
+    const FlareTable *table; // Snapshot records, or NULL for text
+    uint32_t next_row;      // First snapshot record not yet handed to a worker
+    AggregatePeriod period; // Period flares are grouped by
+    pthread_mutex_t lock;
+} AggregateQueue;
+
+typedef struct {
+    AggregateQueue *queue; // Shared work
+    BucketMap map;         // Periods seen by this worker
+} AggregateWorker;
+
+/**
+    This function allocates zeroed memory, exiting if it runs out.
+    @param size Number of bytes
+    @return The memory
+ */
+static void *checked_calloc(size_t size)
+{
+    void *p = calloc(1, size > 0 ? size : 1);
+    if (p == NULL) {
+        fprintf(stderr, "Error: out of memory in flare_aggregate.\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/**
+    This function initializes an empty map of periods.
+    @param m Map to initialize
+ */
+static void map_init(BucketMap *m)
+{
+    memset(m, 0, sizeof(*m));
+    m->cap = 64;
+    m->slots = checked_calloc(m->cap * sizeof(uint32_t));
+}
+
+/**
+    This function returns the slot where a key is, or where it would be inserted.
+    @param m Map to search
+    @param key Period to look for
+    @return Index of the slot
+ */
+static uint32_t probe(const BucketMap *m, int32_t key)
+{
+    uint32_t i = ((uint32_t)key * 2654435761u) & (m->cap - 1);
+    while (m->slots[i] != 0 && m->buckets[m->slots[i] - 1].key != key) {
+        i = (i + 1) & (m->cap - 1);
+    }
+    return i;
+}
+
+/**
+    This function returns the bucket of a period, adding an empty one the first time it is seen.
+    The slots only hold indexes, so doubling them when they become half full moves no buckets.
+    @param m Map to search
+    @param key Period
+    @return The bucket of the period
+ */
+static Bucket *find_bucket(BucketMap *m, int32_t key)
+{
+    if (m->count > 0 && m->buckets[m->last].key == key) {
+        return &m->buckets[m->last];
+    }
+    uint32_t i = probe(m, key);
+    if (m->slots[i] != 0) {
+        m->last = m->slots[i] - 1;
+        return &m->buckets[m->last];
+    }
+
+    if (m->count == m->bucket_cap) {
+        m->bucket_cap = m->bucket_cap ? m->bucket_cap * 2 : 64;
+        m->buckets = realloc(m->buckets, m->bucket_cap * sizeof(Bucket));
+        if (m->buckets == NULL) {
+            fprintf(stderr, "Error: out of memory in flare_aggregate.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    Bucket *b = &m->buckets[m->count];
+    memset(b, 0, sizeof(*b));
+    b->key = key;
+    b->total = (Rational)RATIONAL_ZERO;
+    m->slots[i] = ++m->count;
+    m->last = m->count - 1;
+
+    if (2 * m->count > m->cap) {
+        free(m->slots);
+        m->cap *= 2;
+        m->slots = checked_calloc(m->cap * sizeof(uint32_t));
+        for (uint32_t k = 0; k < m->count; k++) {
+            m->slots[probe(m, m->buckets[k].key)] = k + 1;
+        }
+    }
+    return b;
+}
+
+/**
+    This function releases a map and the Rationals of its buckets.
+    @param m Map to release
+ */
+static void map_free(BucketMap *m)
+{
+    for (uint32_t i = 0; i < m->count; i++) {
+        rational_free(&m->buckets[i].total);
+    }
+    free(m->buckets);
+    free(m->slots);
+}
+
+/**
+    This function returns the period a date belongs to.
+    @param days Date as days since 1970-01-01
+    @param period Period flares are grouped by
+    @return The day itself, or the month as year * 12 + month - 1
+ */
+static int32_t period_key(int days, AggregatePeriod period)
+{
+    if (period == AGGREGATE_DAY) {
+        return days;
+    }
+    int year, month, day;
+    civil_from_days(days, &year, &month, &day);
+    return year * 12 + month - 1;
+}
+
+/**
+    This function finds the peak bin of a value: bin k holds peaks from 10^(k-1) up to 10^k, the
+    first bin everything below 1, and the last everything from 10^(PEAK_BINS-2) up.
+    @param peak Peak as a fixed-point decimal
+    @return The bin
+ */
+static int peak_bin(const FixedDecimal *peak)
+{
+    __int128 edge = 1;
+    for (int i = 0; i < peak->scale; i++) {
+        edge *= 10;
+    }
+    int bin = 0;
+    while (bin < PEAK_BINS - 1 && peak->units >= edge) {
+        bin++;
+        edge *= 10;
+    }
+    return bin;
+}
+
+/**
+    This function brings a fixed-point decimal to AVG_DECIMAL_LENGTH places.
+    @param d Decimal with at most AVG_DECIMAL_LENGTH places
+    @param units Set to its value in units of 10^-AVG_DECIMAL_LENGTH
+    @return false if it has more places or the result does not fit
+ */
+static bool to_units(const FixedDecimal *d, __int128 *units)
+{
+    if (d->scale > AVG_DECIMAL_LENGTH) {
+        return false;
+    }
+    __int128 u = d->units;
+    for (int i = d->scale; i < AVG_DECIMAL_LENGTH; i++) {
+        if (__builtin_mul_overflow(u, 10, &u)) {
+            return false;
+        }
+    }
+    *units = u;
+    return true;
+}
+
+/**
+    This function adds one flare to its period. The total count is added to the bucket's units when
+    it is exact and the sum fits, and otherwise computed and added as Rationals.
+    @param m Map of the calling worker
+    @param key Period of the flare
+    @param peak Peak column
+    @param avg Average count rate column
+    @param duration Duration in seconds
+ */
+static void add_flare(BucketMap *m, int32_t key, const DecimalParts peak, const DecimalParts avg, int duration)
+{
+    Bucket *b = find_bucket(m, key);
+    b->flares++;
+    FixedDecimal p, total;
+    b->bins[fixed_from_decimal(peak, &p) ? peak_bin(&p) : 0]++;
+
+    __int128 units, sum;
+    if (fixed_from_decimal(avg, &total) && fixed_multiply_int(&total, duration, &total) && to_units(&total, &units) &&
+        !__builtin_add_overflow(b->units, units, &sum)) {
+        b->units = sum;
+        return;
+    }
+    Rational r = RATIONAL_ZERO, d = RATIONAL_ZERO;
+    if (rational_from_decimal(avg, &r) && rational_set(&d, duration, 1) && rational_multiply(&r, &d, &r)) {
+        rational_add(&b->total, &r, &b->total);
+    }
+    rational_free(&r);
+    rational_free(&d);
+}
+
+/**
+    This function aggregates the data lines of one chunk of text. Blank lines are skipped silently;
+    a line that does not tokenize or has no real start date is counted as a warning.
+    @param m Map of the calling worker
+    @param p Start of the first line
+    @param end End of the last line
+    @param period Period flares are grouped by
+ */
+static void aggregate_lines(BucketMap *m, const char *p, const char *end, AggregatePeriod period)
+{
+    FlareRow row;
+    FlareScanner sc;
+    const char *line, *line_end;
+    int last_len = 0, year, month, day;
+    const char *last_date = NULL;
+    int32_t key = 0;
+
+    flare_scanner_init(&sc, p, end);
+    while (flare_scanner_next(&sc, &line, &line_end)) {
+        if (!flare_scanner_row(&sc, line, line_end, &row)) {
+            if (!flare_scanner_blank(&sc, line, line_end)) {
+                m->counts.warnings++;
+            }
+            continue;
+        }
+        // Rows come sorted by date, so a date is only converted when it changes
+        if (last_date == NULL || row.start_date.len != last_len || memcmp(row.start_date.ptr, last_date, last_len) != 0) {
+            if (!flare_parse_date(row.start_date, &year, &month, &day) || !valid_civil(year, month, day)) {
+                m->counts.warnings++;
+                last_date = NULL;
+                continue;
+            }
+            last_date = row.start_date.ptr;
+            last_len = row.start_date.len;
+            key = period_key(days_from_civil(year, month, day), period);
+        }
+        add_flare(m, key, row.peak, row.avg, row_duration(&row));
+        m->counts.rows++;
+    }
+}
+
+/**
+    This function aggregates a range of snapshot records from their columns.
+    @param m Map of the calling worker
+    @param t Table of the snapshot
+    @param first First record
+    @param stop Record after the last
+    @param period Period flares are grouped by
+ */
+static void aggregate_records(BucketMap *m, const FlareTable *t, uint32_t first, uint32_t stop, AggregatePeriod period)
+{
+    uint32_t last_code = UINT32_MAX;
+    int32_t key = 0;
+    for (uint32_t i = first; i < stop; i++) {
+        // A start date that is not a real date has no period, as in aggregate_lines
+        if (t->date_days[t->date_codes[i]] == DATE_DAYS_NONE) {
+            m->counts.warnings++;
+            continue;
+        }
+        if (t->date_codes[i] != last_code) {
+            last_code = t->date_codes[i];
+            key = period_key(t->date_days[last_code], period);
+        }
+        DecimalParts peak = {t->peak_int[i], t->peak_dec[i], PEAK_DECIMAL_LENGTH};
+        DecimalParts avg = {t->avg_int[i], t->avg_dec[i], AVG_DECIMAL_LENGTH};
+        int duration = t->end_sec[i] - t->start_sec[i];
+        add_flare(m, key, peak, avg, duration < 0 ? duration + SECOND_PER_DAY : duration);
+        m->counts.rows++;
+    }
+}
+
+/**
+    This function is the body of a worker thread. It claims chunks of text, or ranges of snapshot
+    records, until none are left, and aggregates them into its own map.
+    @param arg The AggregateWorker
+    @return NULL
+ */
+static void *aggregate_worker(void *arg)
+{
+    AggregateWorker *w = arg;
+    AggregateQueue *q = w->queue;
+
+    while (1) {
+        pthread_mutex_lock(&q->lock);
+        const char *begin = q->pos, *stop = q->end;
+        uint32_t first = q->next_row, last = first;
+        if (q->table != NULL) {
+            last = q->table->count - first > AGGREGATE_ROWS ? first + AGGREGATE_ROWS : q->table->count;
+            q->next_row = last;
+        } else if (begin < q->end) {
+            // Claim the next chunk, extended to the end of the line it stops in
+            stop = (q->end - begin > CHUNK_BYTES) ? flare_next_line(begin + CHUNK_BYTES, q->end) : q->end;
+            q->pos = stop;
+        }
+        pthread_mutex_unlock(&q->lock);
+
+        uint64_t t = stats_start();
+        if (q->table != NULL) {
+            if (first == last) {
+                break;
+            }
+            aggregate_records(&w->map, q->table, first, last, q->period);
+        } else {
+            if (begin == stop) {
+                break;
+            }
+            aggregate_lines(&w->map, begin, stop, q->period);
+        }
+        stats_lap(STAGE_PARSE, t);
+    }
+    stats_merge_thread();
+    return NULL;
+}
+
+/**
+    This function converts a sum of units of 10^-AVG_DECIMAL_LENGTH into a Rational. A sum beyond
+    int64 is built from its base 10^18 digits with Rational arithmetic.
+    @param units Sum to convert
+    @param r Set to the sum; must hold zero
+ */
+static void units_to_rational(__int128 units, Rational *r)
+{
+    if (units >= INT64_MIN && units <= INT64_MAX) {
+        rational_set(r, (int64)units, UNITS_PER_COUNT);
+        return;
+    }
+    const int64 base = 1000000000000000000LL;
+    int64 digits[3];
+    for (int k = 2; k >= 0; k--) {
+        digits[k] = (int64)(units % base);
+        units /= base;
+    }
+    Rational scale = RATIONAL_ZERO, digit = RATIONAL_ZERO;
+    rational_set(&scale, base, 1);
+    for (int k = 0; k < 3; k++) {
+        rational_multiply(r, &scale, r);
+        rational_set(&digit, digits[k], 1);
+        rational_add(r, &digit, r);
+    }
+    rational_set(&scale, UNITS_PER_COUNT, 1);
+    rational_divide(r, &scale, r);
+}
+
+/**
+    This function merges the map of a worker into the final map. Its units are added to the final
+    units, or as a Rational if the sum would overflow, and its Rational part to the final one.
+    @param into Final map
+    @param from Map of a worker
+ */
+static void merge_map(BucketMap *into, const BucketMap *from)
+{
+    for (uint32_t i = 0; i < from->count; i++) {
+        const Bucket *b = &from->buckets[i];
+        Bucket *to = find_bucket(into, b->key);
+        to->flares += b->flares;
+        for (int k = 0; k < PEAK_BINS; k++) {
+            to->bins[k] += b->bins[k];
+        }
+        __int128 sum;
+        if (__builtin_add_overflow(to->units, b->units, &sum)) {
+            Rational part = RATIONAL_ZERO;
+            units_to_rational(b->units, &part);
+            rational_add(&to->total, &part, &to->total);
+            rational_free(&part);
+        } else {
+            to->units = sum;
+        }
+        rational_add(&to->total, &b->total, &to->total);
+    }
+    into->counts.rows += from->counts.rows;
+    into->counts.warnings += from->counts.warnings;
+}
+
+/**
+    This function orders buckets by period.
+    @param a First bucket
+    @param b Second bucket
+    @return Negative, zero, or positive as a comes before, with, or after b
+ */
+static int compare_buckets(const void *a, const void *b)
+{
+    int32_t x = ((const Bucket *)a)->key, y = ((const Bucket *)b)->key;
+    return (x > y) - (x < y);
+}
+
+/**
+    This function writes the summed total count of a period. The decimal layout prints a sum held
+    entirely in units with all of its places, which is exact at any size the units can hold; only a
+    sum that overflowed them into the Rational is printed as a fraction, like every sum in the
+    fraction layout.
+    @param out Buffer to append to
+    @param b Bucket of the period
+    @param decimal true for the decimal layout
+ */
+static void put_total(OutBuffer *out, const Bucket *b, bool decimal)
+{
+    bool units_only = rational_is_small(&b->total) && b->total.num == 0;
+    if (decimal && units_only) {
+        FixedDecimal d = {b->units, AVG_DECIMAL_LENGTH};
+        char *p = out_claim(out, FIXED_TEXT_MAX);
+        out->len += fixed_format(&d, p);
+        return;
+    }
+
+    Rational total = RATIONAL_ZERO;
+    units_to_rational(b->units, &total);
+    rational_add(&total, &b->total, &total);
+    if (decimal && rational_is_small(&total) && UNITS_PER_COUNT % total.den == 0) {
+        FixedDecimal d = {(__int128)total.num * (UNITS_PER_COUNT / total.den), AVG_DECIMAL_LENGTH};
+        char *p = out_claim(out, FIXED_TEXT_MAX);
+        out->len += fixed_format(&d, p);
+        rational_free(&total);
+        return;
+    }
+    char buf[128];
+    size_t len = rational_format(&total, buf, sizeof(buf));
+    if (len < sizeof(buf)) {
+        out_write(out, buf, len);
+    } else {
+        char *p = out_claim(out, len + 1);
+        rational_format(&total, p, len + 1);
+        out->len += len;
+    }
+    rational_free(&total);
+}
+
+/**
+    This function writes the aggregated table: a header, then one line per period in date order.
+    @param m Final map, whose buckets are left sorted by period
+    @param period Period flares are grouped by
+    @param decimal true to print sums as decimals
+    @param out Buffer to append to
+ */
+static void write_table(BucketMap *m, AggregatePeriod period, bool decimal, OutBuffer *out)
+{
+    // The slots are not needed any more, so the buckets are sorted in place
+    Bucket *rows = m->buckets;
+    uint32_t n = m->count;
+    qsort(rows, n, sizeof(Bucket), compare_buckets);
+
+    out_printf(out, "%-10s %10s %10s %10s %10s %10s %10s  %s\n", period == AGGREGATE_DAY ? "day" : "month", "flares",
+               "peak<1", "peak<10", "peak<100", "peak<1000", "peak>=1000", "total_count");
+    for (uint32_t i = 0; i < n; i++) {
+        const Bucket *b = &rows[i];
+        char label[16];
+        if (period == AGGREGATE_DAY) {
+            int year, month, day;
+            civil_from_days(b->key, &year, &month, &day);
+            snprintf(label, sizeof(label), "%04d-%02d-%02d", year, month, day);
+        } else {
+            snprintf(label, sizeof(label), "%04d-%02d", b->key / 12, b->key % 12 + 1);
+        }
+        out_printf(out, "%-10s %10lld %10lld %10lld %10lld %10lld %10lld  ", label, b->flares, b->bins[0], b->bins[1],
+                   b->bins[2], b->bins[3], b->bins[4]);
+        put_total(out, b, decimal);
+        out_write(out, "\n", 1);
+    }
+}
+
+/**
+    This function aggregates a flare list or snapshot per period and writes the aggregated table.
+    Text is tokenized by the workers as they go, so it is never built into a table first.
+    @param data Contents of the file
+    @param size Length of the file in bytes
+    @param period Period flares are grouped by
+    @param decimal true to print sums as decimals rather than fractions
+    @param threads Number of worker threads
+    @param sink Stream the table is written to
+    @param counts Set to the flares aggregated and the malformed lines skipped
+    @return true on success, false if a snapshot is damaged or incompatible
+ */
+bool aggregate_mapped(const char *data, size_t size, AggregatePeriod period, bool decimal, int threads, FILE *sink,
+                      ProcessCounts *counts)
+{
+    AggregateQueue q;
+    FlareTable table;
+    memset(&q, 0, sizeof(q));
+    q.period = period;
+    if (snapshot_detect(data, size)) {
+        if (!snapshot_open(data, size, &table)) {
+            return false;
+        }
+        q.table = &table;
+    } else {
+        q.pos = flare_skip_lines(data, data + size, MAX_HEADER_LINES);
+        q.end = data + size;
+    }
+    pthread_mutex_init(&q.lock, NULL);
+
+    AggregateWorker *workers = checked_calloc(threads * sizeof(AggregateWorker));
+    pthread_t *ids = checked_calloc(threads * sizeof(pthread_t));
+    for (int i = 0; i < threads; i++) {
+        workers[i].queue = &q;
+        map_init(&workers[i].map);
+        if (pthread_create(&ids[i], NULL, aggregate_worker, &workers[i]) != 0) {
+            fprintf(stderr, "Error: cannot create worker thread.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Merge the partial maps in thread order once every worker is done
+    BucketMap total;
+    map_init(&total);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+        merge_map(&total, &workers[i].map);
+        map_free(&workers[i].map);
+    }
+    for (long long i = 0; i < total.counts.warnings; i++) {
+        fprintf(stderr, "Warning: line format error, skipping line.\n");
+    }
+    stats_add(COUNT_ROWS, total.counts.rows);
+    stats_add(COUNT_SKIPPED, total.counts.warnings);
+
+    OutBuffer out;
+    out_init(&out, sink);
+    write_table(&total, period, decimal, &out);
+    out_flush(&out);
+    out_free(&out);
+    *counts = total.counts;
+
+    map_free(&total);
+    pthread_mutex_destroy(&q.lock);
+    free(workers);
+    free(ids);
+    return true;
+}
+
+/**
+    This function aggregates tables that are already loaded, such as the lists a server holds, into
+    one table of periods. It runs on the calling thread, since the records are read straight from
+    their columns with no parsing to share out.
+    @param tables Tables to aggregate
+    @param count Number of tables
+    @param period Period flares are grouped by
+    @param decimal true to print sums as decimals rather than fractions
+    @param out Buffer the aggregated table is appended to
+    @param counts Set to the flares aggregated and the records without a real start date
+ */
+void aggregate_tables(const FlareTable *const *tables, int count, AggregatePeriod period, bool decimal, OutBuffer *out,
+                      ProcessCounts *counts)
+{
+    BucketMap m;
+    map_init(&m);
+    for (int i = 0; i < count; i++) {
+        aggregate_records(&m, tables[i], 0, tables[i]->count, period);
+    }
+    write_table(&m, period, decimal, out);
+    *counts = m.counts;
+    map_free(&m);
+}
@@ -0,0 +1,32 @@
+/**
+     @file flare_aggregate.h
+     This header file defines aggregation mode, which summarizes a flare list per day or per month
+     instead of printing its rows: the number of flares starting in each period, their summed total
+     counts, and a histogram of their peaks by decade.
+ */
+#ifndef FLARE_AGGREGATE_H
+#define FLARE_AGGREGATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "flare_process.h"
+#include "out_buffer.h"
+
+#define PEAK_BINS 5             // Peak histogram bins: below 1, 1 - 10, 10 - 100, 100 - 1000, and 1000 and up
+#define AGGREGATE_ROWS (1 << 16) // Snapshot records handed to a worker at a time
+
+typedef enum {
+    AGGREGATE_DAY,  // One line per start date
+    AGGREGATE_MONTH // One line per month of the start date
+} AggregatePeriod;
+
+// Aggregate a mapped flare list or snapshot per period on threads workers and write the table to sink; false if the snapshot is damaged
+bool aggregate_mapped(const char *data, size_t size, AggregatePeriod period, bool decimal, int threads, FILE *sink,
+                      ProcessCounts *counts);
+
+// Aggregate the records of count tables together per period on the calling thread and append the table to out
+void aggregate_tables(const FlareTable *const *tables, int count, AggregatePeriod period, bool decimal, OutBuffer *out,
+                      ProcessCounts *counts);
+
+#endif
@@ -0,0 +1,389 @@
+/**
+    @file flare_batch.c
+    This program processes many flare list files in one invocation. Input arguments may be file names
+    or glob patterns. The files are handed out to a shared pool of worker threads, each of which
+    processes whole files, or with a query loads each file into an indexed table and prints only its
+    matching rows. By default a file loader reads the files ahead of the workers through
+    io_uring, keeping many reads in flight so cold files arrive while earlier ones are parsed; the
+    workers may also read their files with pread or map them. Output goes either to one file per input in an output directory, or to
+    standard output with the files concatenated in argument order. A file written to standard output
+    is buffered until its turn only up to BATCH_HOLD_SIZE; past that its worker waits for the files
+    before it to be written and then streams the rest, so memory stays bounded however large the
+    inputs are. A summary of rows, warnings and elapsed time per file is written to standard error.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <glob.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "file_loader.h"
+#include "flare_batch.h"
+#include "flare_parse.h"
+#include "flare_process.h"
+#include "flare_snapshot.h"
+#include "flare_stats.h"
+#include "flare_table.h"
+#include "input_stream.h"
+#include "mapped_file.h"
+
+#define MAX_PATH 4096                // Maximum length of an output file path
+#define BATCH_HOLD_SIZE (8 << 20)    // Output a file buffers for standard output before waiting for its turn
+
+typedef struct BatchQueue BatchQueue;
+
+typedef struct {
+    BatchQueue *queue;    // Queue the file belongs to
+    const char *path;     // Input file
+    OutBuffer out;        // Formatted output when writing to standard output
+    ProcessCounts counts; // Rows and malformed lines in the file
+    double elapsed_ms;    // Wall time spent processing the file
+    bool failed;          // Set if the file could not be read or its output written
+    bool ready;           // Set once a worker has finished the file
+} BatchFile;
+
+struct BatchQueue {
+    BatchFile *files;        // Files in argument order
+    int count;               // Number of files
+    int next_file;           // Index of the next file to hand out
+    int written;             // Files whose output and summary have been written
+    int window;              // Files a worker may run ahead of the writer
+    const RowFormat *format; // Output row format
+    const FlareQuery *query; // Conditions the printed rows must meet, or NULL to print every row
+    const char *output_dir;  // Directory for per-file output, or NULL for standard output
+    FileLoader *loader;      // Reads the files for the workers, or NULL to map them
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+/**
+    This function checks whether a command-line argument is a glob pattern rather than a file name.
+    @param arg Argument to check
+    @return true if arg contains '*', '?' or '['
+ */
+bool is_glob_pattern(const char *arg)
+{
+    return strpbrk(arg, "*?[") != NULL;
+}
+
+/**
+    This function returns a monotonic timestamp.
+    @return Current time in milliseconds
+ */
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/**
+    This function is called when a file's buffered output for standard output reaches BATCH_HOLD_SIZE.
+    It waits until every file before it has been written, then points the buffer at standard output
+    so the rest of the file streams out as it is formatted.
+    @param out Buffer of the file
+    @param ctx BatchFile the buffer belongs to
+ */
+static void wait_for_turn(OutBuffer *out, void *ctx)
+{
+    BatchFile *file = ctx;
+    BatchQueue *q = file->queue;
+    int index = (int)(file - q->files);
+    pthread_mutex_lock(&q->lock);
+    while (q->written < index) {
+        pthread_cond_wait(&q->changed, &q->lock);
+    }
+    pthread_mutex_unlock(&q->lock);
+    out->sink = stdout;
+}
+
+/**
+    This function prints the rows of a flare list or snapshot that match the batch query. The
+    records are loaded into a table and indexed, as for a single file.
+    @param q Shared queue
+    @param data Contents of the file
+    @param size Length of the file in bytes
+    @param out Buffer for the matching rows
+    @param counts Counts to add the printed rows and malformed lines to
+    @return true on success, false if the file is a damaged or incompatible snapshot
+ */
+static bool query_batch_file(BatchQueue *q, const char *data, size_t size, OutBuffer *out, ProcessCounts *counts)
+{
+    const char *end = data + size;
+    FlareTable table;
+    if (snapshot_detect(data, size)) {
+        if (!snapshot_open(data, size, &table)) {
+            return false;
+        }
+    } else {
+        // Only the malformed lines count here; process_table counts the rows it prints
+        ProcessCounts loaded = {0, 0};
+        table_init(&table);
+        table_load_lines(&table, flare_skip_lines(data, end, MAX_HEADER_LINES), end, NULL, &loaded);
+        counts->warnings += loaded.warnings;
+    }
+
+    FlareIndex index;
+    index_build(&index, &table);
+    uint64_t *selected = calloc(index.words ? index.words : 1, sizeof(uint64_t));
+    if (selected == NULL) {
+        fprintf(stderr, "Error: out of memory in query_batch_file.\n");
+        exit(EXIT_FAILURE);
+    }
+    index_query(&index, &table, q->query, selected);
+    process_table(&table, selected, q->format, out, counts);
+    free(selected);
+    index_free(&index);
+    table_free(&table);
+    return true;
+}
+
+/**
+    This function processes one input file, either into a per-file output in the output directory
+    or into the file's buffer for the writer to print in order. A compressed file is mapped instead
+    of taken from the loader, since map_file decompresses it.
+    @param q Shared queue
+    @param file File to process
+ */
+static void process_batch_file(BatchQueue *q, BatchFile *file)
+{
+    double start = now_ms();
+    int index = (int)(file - q->files);
+    MappedFile mf;
+    const char *data = NULL;
+    size_t size = 0;
+    bool loaded = false;
+    if (q->loader != NULL) {
+        if (!loader_get(q->loader, index, &data, &size)) {
+            loader_release(q->loader, index);
+            file->failed = true;
+            return;
+        }
+        loaded = detect_compression(data, size) == COMPRESSION_NONE;
+        if (!loaded) {
+            loader_release(q->loader, index);
+        }
+    }
+    if (!loaded) {
+        if (!map_file(file->path, &mf)) {
+            file->failed = true;
+            return;
+        }
+        data = mf.data;
+        size = mf.size;
+    }
+
+    FILE *sink = NULL;
+    if (q->output_dir != NULL) {
+        // Name the output after the input file, without its directory
+        const char *base = strrchr(file->path, '/');
+        base = base ? base + 1 : file->path;
+        char out_path[MAX_PATH];
+        snprintf(out_path, sizeof(out_path), "%s/%s.out", q->output_dir, base);
+        sink = fopen(out_path, "w");
+        if (sink == NULL) {
+            if (loaded) {
+                loader_release(q->loader, index);
+            } else {
+                unmap_file(&mf);
+            }
+            file->failed = true;
+            return;
+        }
+    }
+
+    const char *end = data + size;
+    out_init(&file->out, sink);
+    if (sink == NULL) {
+        out_set_limit(&file->out, BATCH_HOLD_SIZE, wait_for_turn, file);
+    }
+    if (q->query != NULL) {
+        if (!query_batch_file(q, data, size, &file->out, &file->counts)) {
+            file->failed = true;
+        }
+    } else if (snapshot_detect(data, size)) {
+        FlareTable table;
+        if (snapshot_open(data, size, &table)) {
+            process_table(&table, NULL, q->format, &file->out, &file->counts);
+        } else {
+            file->failed = true;
+        }
+    } else {
+        process_lines(flare_skip_lines(data, end, MAX_HEADER_LINES), end, q->format, &file->out, NULL,
+                      &file->counts);
+    }
+    // Output that went past the hold size is streaming and goes out now, ahead of the writer
+    if (file->out.sink != NULL) {
+        out_flush(&file->out);
+        out_free(&file->out);
+    }
+    if (sink != NULL && fclose(sink) != 0) {
+        file->failed = true;
+    }
+    if (loaded) {
+        loader_release(q->loader, index);
+    } else {
+        unmap_file(&mf);
+    }
+    file->elapsed_ms = now_ms() - start;
+}
+
+/**
+    This function is the body of a pool thread. It claims files one at a time until none are left.
+    @param arg The shared BatchQueue
+    @return NULL
+ */
+static void *batch_worker(void *arg)
+{
+    BatchQueue *q = arg;
+
+    while (1) {
+        pthread_mutex_lock(&q->lock);
+        while (q->next_file < q->count && q->next_file >= q->written + q->window) {
+            pthread_cond_wait(&q->changed, &q->lock);
+        }
+        if (q->next_file == q->count) {
+            pthread_mutex_unlock(&q->lock);
+            break;
+        }
+        BatchFile *file = &q->files[q->next_file++];
+        pthread_mutex_unlock(&q->lock);
+
+        process_batch_file(q, file);
+
+        pthread_mutex_lock(&q->lock);
+        file->ready = true;
+        pthread_cond_broadcast(&q->changed);
+        pthread_mutex_unlock(&q->lock);
+    }
+    stats_merge_thread();
+    return NULL;
+}
+
+/**
+    This function expands the input arguments into a list of files. Arguments without wildcards
+    are kept as given, so a missing file is reported when it is processed.
+    @param patterns File names and glob patterns
+    @param count Number of patterns
+    @param matches Expanded file list, released by the caller with globfree
+    @return true on success, false if a pattern matches nothing
+ */
+static bool expand_patterns(char **patterns, int count, glob_t *matches)
+{
+    memset(matches, 0, sizeof(*matches));
+    for (int i = 0; i < count; i++) {
+        int flags = (i > 0 ? GLOB_APPEND : 0) | (is_glob_pattern(patterns[i]) ? 0 : GLOB_NOCHECK);
+        int rc = glob(patterns[i], flags, NULL, matches);
+        if (rc == GLOB_NOMATCH) {
+            fprintf(stderr, "Error: no files match %s\n", patterns[i]);
+            return false;
+        } else if (rc != 0) {
+            fprintf(stderr, "Error: cannot expand %s\n", patterns[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+    This function processes a batch of flare list files on a pool of worker threads. The calling
+    thread writes output and summary lines in argument order as files complete.
+    @param patterns File names and glob patterns
+    @param count Number of patterns
+    @param format Output row format
+    @param query Conditions the printed rows must meet, or NULL to print every row
+    @param threads Number of worker threads in the pool
+    @param output_dir Directory for per-file output, or NULL to write everything to standard output
+    @param io How the workers get at the contents of the files
+    @return EXIT_SUCCESS if every file was processed, EXIT_FAILURE otherwise
+ */
+int run_batch(char **patterns, int count, const RowFormat *format, const FlareQuery *query, int threads,
+              const char *output_dir, BatchIo io)
+{
+    glob_t matches;
+    if (!expand_patterns(patterns, count, &matches)) {
+        globfree(&matches);
+        return EXIT_FAILURE;
+    }
+
+    BatchQueue q;
+    q.count = (int)matches.gl_pathc;
+    q.files = calloc(q.count > 0 ? q.count : 1, sizeof(BatchFile));
+    if (threads > q.count) {
+        threads = q.count > 0 ? q.count : 1;
+    }
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    if (q.files == NULL || workers == NULL) {
+        fprintf(stderr, "Error: out of memory in run_batch.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < q.count; i++) {
+        q.files[i].queue = &q;
+        q.files[i].path = matches.gl_pathv[i];
+    }
+    q.next_file = 0;
+    q.written = 0;
+    q.window = 2 * threads;
+    q.format = format;
+    q.query = query;
+    q.output_dir = output_dir;
+    pthread_mutex_init(&q.lock, NULL);
+    pthread_cond_init(&q.changed, NULL);
+
+    double start = now_ms();
+    q.loader = io == BATCH_IO_MMAP ? NULL : loader_start(matches.gl_pathv, q.count, io == BATCH_IO_URING);
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, batch_worker, &q) != 0) {
+            fprintf(stderr, "Error: cannot create worker thread.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Write each file's output and summary line in argument order
+    ProcessCounts total = {0, 0};
+    int failures = 0;
+    fprintf(stderr, "%-40s %12s %10s %12s\n", "file", "rows", "warnings", "elapsed_ms");
+    pthread_mutex_lock(&q.lock);
+    while (q.written < q.count) {
+        BatchFile *file = &q.files[q.written];
+        if (!file->ready) {
+            pthread_cond_wait(&q.changed, &q.lock);
+            continue;
+        }
+        pthread_mutex_unlock(&q.lock);
+
+        if (file->failed) {
+            fprintf(stderr, "%-40s %s\n", file->path, "error: cannot read input or write output");
+            failures++;
+        } else {
+            if (output_dir == NULL) {
+                write_all(stdout, file->out.data, file->out.len);
+                out_free(&file->out);
+            }
+            fprintf(stderr, "%-40s %12lld %10lld %12.3f\n", file->path,
+                    file->counts.rows, file->counts.warnings, file->elapsed_ms);
+            total.rows += file->counts.rows;
+            total.warnings += file->counts.warnings;
+        }
+
+        pthread_mutex_lock(&q.lock);
+        q.written++;
+        pthread_cond_broadcast(&q.changed);
+    }
+    pthread_mutex_unlock(&q.lock);
+    fprintf(stderr, "%-40s %12lld %10lld %12.3f\n", "total", total.rows, total.warnings, now_ms() - start);
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    if (q.loader != NULL) {
+        loader_finish(q.loader);
+    }
+    pthread_mutex_destroy(&q.lock);
+    pthread_cond_destroy(&q.changed);
+    free(workers);
+    free(q.files);
+    globfree(&matches);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,26 @@
+/**
+     @file flare_batch.h
+     This header file defines batch processing of many flare list files on a shared worker pool, and
+     the ways the workers may get at the contents of the files.
+ */
+#ifndef FLARE_BATCH_H
+#define FLARE_BATCH_H
+
+#include <stdbool.h>
+#include "flare_format.h"
+#include "flare_index.h"
+
+typedef enum {
+    BATCH_IO_URING, // Read whole files ahead of the workers through io_uring, or with pread if it is unavailable
+    BATCH_IO_PREAD, // Read each file with pread on the worker that processes it
+    BATCH_IO_MMAP   // Map each file on the worker that processes it
+} BatchIo;
+
+// Return true if the argument contains glob wildcard characters
+bool is_glob_pattern(const char *arg);
+
+// Process every file named or matched by the count patterns, printing only rows matching query unless it is NULL
+int run_batch(char **patterns, int count, const RowFormat *format, const FlareQuery *query, int threads,
+              const char *output_dir, BatchIo io);
+
+#endif
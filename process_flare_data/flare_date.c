@@ -0,0 +1,98 @@
+/**
+    @file flare_date.c
+    This program converts between calendar dates and a day count since 1970-01-01. The conversions
+    use whole 400-year eras of the Gregorian calendar, so they are exact for any year and need no tables.
+ */
+#include <string.h>
+#include "flare_date.h"
+
+/**
+    This function counts the days from 1970-01-01 to a date.
+    @param year Year
+    @param month Month (1 - 12)
+    @param day Day of the month
+    @return Days since the epoch, negative for earlier dates
+ */
+int days_from_civil(int year, int month, int day)
+{
+    // Count years from March so the leap day is the last day of the year
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int year_of_era = year - era * 400;
+    int day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+/**
+    This function converts a day count since 1970-01-01 into a date.
+    @param days Days since the epoch
+    @param year Year
+    @param month Month (1 - 12)
+    @param day Day of the month
+ */
+void civil_from_days(int days, int *year, int *month, int *day)
+{
+    days += 719468;
+    int era = (days >= 0 ? days : days - 146096) / 146097;
+    int day_of_era = days - era * 146097;
+    int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    int month_from_march = (5 * day_of_year + 2) / 153;
+    *day = day_of_year - (153 * month_from_march + 2) / 5 + 1;
+    *month = month_from_march < 10 ? month_from_march + 3 : month_from_march - 9;
+    *year = year_of_era + era * 400 + (*month <= 2);
+}
+
+/**
+    This function checks that a date exists, such as rejecting 30-Feb.
+    @param year Year
+    @param month Month
+    @param day Day of the month
+    @return true if the date exists
+ */
+bool valid_civil(int year, int month, int day)
+{
+    if (month < 1 || month > 12 || day < 1 || day > 31) {
+        return false;
+    }
+    int y, m, d;
+    civil_from_days(days_from_civil(year, month, day), &y, &m, &d);
+    return y == year && m == month && d == day;
+}
+
+/**
+    This function returns the abbreviation used for a month in the flare list.
+    @param month Month (1 - 12)
+    @return The 3-letter abbreviation, or "???" for an invalid month
+ */
+const char *month_abbreviation(int month)
+{
+    // Array of 3-letter month abbreviations
+    static const char *months[] = {
+        "Jan","Feb","Mar","Apr","May","Jun",
+        "Jul","Aug","Sep","Oct","Nov","Dec"
+    };
+    return (month >= 1 && month <= 12) ? months[month - 1] : "???";
+}
+
+/**
+    This function decodes a 3-letter month abbreviation with a perfect hash: the low five bits of
+    the sum of the second and third letters differ for all twelve months, so one table lookup and
+    one compare replace the search through the month names.
+    @param s First of the three letters (need not be NUL-terminated)
+    @return The month (1 - 12), or 0 if s is not a month abbreviation
+ */
+int month_from_abbreviation(const char *s)
+{
+    // Month for each hash value, 0 where no month hashes
+    static const unsigned char slots[32] = {
+        [1] = 7, [2] = 4, [3] = 6, [5] = 11, [7] = 2, [8] = 12,
+        [15] = 1, [19] = 3, [21] = 9, [23] = 10, [26] = 5, [28] = 8
+    };
+    int month = slots[(unsigned char)(s[1] + s[2]) & 31];
+    if (month == 0 || memcmp(s, month_abbreviation(month), 3) != 0) {
+        return 0;
+    }
+    return month;
+}
@@ -0,0 +1,25 @@
+/**
+     @file flare_date.h
+     This header file defines conversions between calendar dates and days since the Unix epoch.
+ */
+#ifndef FLARE_DATE_H
+#define FLARE_DATE_H
+
+#include <stdbool.h>
+
+// Return the number of days from 1970-01-01 to the given proleptic Gregorian date
+int days_from_civil(int year, int month, int day);
+
+// Convert a number of days since 1970-01-01 back into a calendar date
+void civil_from_days(int days, int *year, int *month, int *day);
+
+// Return true if the date exists in the calendar
+bool valid_civil(int year, int month, int day);
+
+// Return the 3-letter abbreviation of a month (1 - 12)
+const char *month_abbreviation(int month);
+
+// Return the month (1 - 12) named by the 3 letters at s, or 0 if they are not an abbreviation
+int month_from_abbreviation(const char *s);
+
+#endif
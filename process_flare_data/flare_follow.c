@@ -0,0 +1,200 @@
+/**
+    @file flare_follow.c
+    This program follows a growing flare list, like "tail -f". It keeps the byte offset just past the
+    last complete line it processed and, each time inotify reports a change, reads only the bytes
+    after that offset. Complete lines are processed and written at once; a trailing partial line is
+    kept until the rest of it arrives. The header is skipped once, when the file is first read.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "flare_follow.h"
+#include "flare_parse.h"
+#include "flare_process.h"
+#include "flare_stats.h"
+
+#define POLL_INTERVAL_MS 1000 // Wait between checks when inotify is unavailable
+
+typedef struct {
+    int fd;                  // Followed file
+    off_t offset;            // Offset just past the last complete line consumed
+    int header_lines;        // Header lines skipped so far
+    char *pending;           // Bytes read past offset that do not end in a newline yet
+    size_t pending_len;      // Bytes in pending
+    size_t pending_cap;      // Allocated size of pending
+    const RowFormat *format; // Output row format
+    OutBuffer out;           // Formatted rows waiting to be written
+    ProcessCounts counts;    // Rows and warnings so far
+} FollowState;
+
+/**
+    This function consumes the complete lines at the front of the pending bytes. Header lines are
+    skipped until MAX_HEADER_LINES have been seen; later lines are processed as rows.
+    @param st Follow state
+ */
+static void consume_lines(FollowState *st)
+{
+    const char *p = st->pending;
+    const char *end = st->pending + st->pending_len;
+
+    while (st->header_lines < MAX_HEADER_LINES) {
+        const char *nl = memchr(p, '\n', end - p);
+        if (nl == NULL) {
+            break;
+        }
+        p = nl + 1;
+        st->header_lines++;
+    }
+
+    // Only process up to the last newline; anything after it is a line still being written
+    const char *last = p;
+    for (const char *q = end; q > p; q--) {
+        if (q[-1] == '\n') {
+            last = q;
+            break;
+        }
+    }
+    if (st->header_lines == MAX_HEADER_LINES && last > p) {
+        process_lines(p, last, st->format, &st->out, stderr, &st->counts);
+        p = last;
+    }
+
+    size_t used = (size_t)(p - st->pending);
+    memmove(st->pending, p, st->pending_len - used);
+    st->pending_len -= used;
+    st->offset += (off_t)used;
+}
+
+/**
+    This function reads everything appended since the last call and processes the complete lines.
+    A file that got shorter is taken to be rewritten and is read again from the start.
+    @param st Follow state
+    @return false if the file cannot be read
+ */
+static bool catch_up(FollowState *st)
+{
+    struct stat sb;
+    if (fstat(st->fd, &sb) != 0) {
+        return false;
+    }
+    if (sb.st_size < st->offset + (off_t)st->pending_len) {
+        fprintf(stderr, "Warning: file truncated, reading it again from the start.\n");
+        st->offset = 0;
+        st->pending_len = 0;
+        st->header_lines = 0;
+    }
+
+    while (1) {
+        if (st->pending_cap - st->pending_len < FOLLOW_READ_SIZE) {
+            st->pending_cap = st->pending_len + 2 * FOLLOW_READ_SIZE;
+            st->pending = realloc(st->pending, st->pending_cap);
+            if (st->pending == NULL) {
+                fprintf(stderr, "Error: out of memory in follow_file.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        ssize_t n = pread(st->fd, st->pending + st->pending_len, FOLLOW_READ_SIZE,
+                          st->offset + (off_t)st->pending_len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        st->pending_len += (size_t)n;
+        stats_add(COUNT_BYTES_IN, n);
+        consume_lines(st);
+    }
+
+    out_flush(&st->out);
+    fflush(stdout);
+    return true;
+}
+
+/**
+    This function processes a flare list and then keeps following it. It blocks on inotify between
+    updates, or polls once a second if inotify cannot watch the file, and returns once the file is
+    deleted or renamed.
+    @param filename File to follow
+    @param format Output row format
+    @return EXIT_SUCCESS once the file goes away, EXIT_FAILURE if it cannot be read
+ */
+int follow_file(const char *filename, const RowFormat *format)
+{
+    FollowState st;
+    memset(&st, 0, sizeof(st));
+    st.format = format;
+    st.fd = open(filename, O_RDONLY);
+    if (st.fd < 0) {
+        printf("Error opening file");
+        return EXIT_FAILURE;
+    }
+    out_init(&st.out, stdout);
+
+    // Watch before the first read so no append between the two is missed
+    int watch = inotify_init1(IN_CLOEXEC);
+    if (watch >= 0 && inotify_add_watch(watch, filename,
+                                        IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF) < 0) {
+        close(watch);
+        watch = -1;
+    }
+
+    int status = EXIT_SUCCESS;
+    bool following = true;
+    while (following) {
+        if (!catch_up(&st)) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        if (watch < 0) {
+            struct timespec delay = {POLL_INTERVAL_MS / 1000, (POLL_INTERVAL_MS % 1000) * 1000000L};
+            nanosleep(&delay, NULL);
+        } else {
+            // Wait for at least one event, then drain everything already queued
+            char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+            ssize_t n = read(watch, events, sizeof(events));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                status = EXIT_FAILURE;
+                break;
+            }
+            for (char *e = events; e < events + n; ) {
+                const struct inotify_event *ev = (const struct inotify_event *)e;
+                if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                    following = false;
+                }
+                e += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+
+        // While the file is open its inode survives an unlink, which only shows up as a link count change
+        struct stat sb;
+        if (fstat(st.fd, &sb) == 0 && sb.st_nlink == 0) {
+            following = false;
+        }
+    }
+
+    // Pick up anything written just before the file went away
+    if (status == EXIT_SUCCESS) {
+        catch_up(&st);
+    }
+    if (watch >= 0) {
+        close(watch);
+    }
+    close(st.fd);
+    out_free(&st.out);
+    free(st.pending);
+    return status;
+}
@@ -0,0 +1,15 @@
+/**
+     @file flare_follow.h
+     This header file defines follow mode, which keeps processing rows as they are appended to a flare list.
+ */
+#ifndef FLARE_FOLLOW_H
+#define FLARE_FOLLOW_H
+
+#include "flare_format.h"
+
+#define FOLLOW_READ_SIZE 65536 // Bytes read from the file at a time
+
+// Process filename, then wait for and process appended rows until it is removed; returns an exit status
+int follow_file(const char *filename, const RowFormat *format);
+
+#endif
@@ -0,0 +1,455 @@
+/**
+    @file flare_format.c
+    This program formats processed flare rows: dates in the requested format, fractions centered
+    around their slash, and whole rows in the fixed-width output layout.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "date_memo.h"
+#include "flare_format.h"
+#include "flare_stats.h"
+
+/**
+    Converts the start date of a tokenized row with a compiled format, without the memo. A date that
+    does not parse, or a format that keeps dates unchanged, leaves the date as it appears in the input.
+    @param row the tokenized row
+    @param format the compiled date format
+    @param output the output buffer of DATE_TEXT_MAX bytes for the formatted date
+    @return the length of the formatted date
+ */
+static int render_date_field(const FlareRow *row, const DateFormat *format, char *output) {
+    int year, month, day;
+    if (format->mode == DATE_COMPILED && flare_parse_date(row->start_date, &year, &month, &day))
+        return date_format_render(format, year, month, day, row->start_sec, output);
+
+    // Copy the date unchanged, limited to the 31 characters the original reader kept
+    int len = row->start_date.len < 31 ? row->start_date.len : 31;
+    memcpy(output, row->start_date.ptr, len);
+    output[len] = '\0';
+    return len;
+}
+
+/**
+    Converts the start date of a tokenized row with a compiled format. Unless the format prints the
+    start time, the text depends only on the date, so each distinct date is converted once per
+    thread and later rows copy the remembered text.
+    @param row the tokenized row
+    @param format the compiled date format
+    @param output the output buffer of DATE_TEXT_MAX bytes for the formatted date
+    @return the length of the formatted date
+ */
+int convert_date_field(const FlareRow *row, const DateFormat *format, char *output) {
+    if (format->mode != DATE_COMPILED || format->needs_time)
+        return render_date_field(row, format, output);
+
+    DateMemo *memo = date_memo_thread(format);
+    int len;
+    const char *text = date_memo_find(memo, row->start_date, &len);
+    if (text != NULL) {
+        memcpy(output, text, len);
+        output[len] = '\0';
+        return len;
+    }
+    len = render_date_field(row, format, output);
+    date_memo_store(memo, row->start_date, output, len);
+    return len;
+}
+
+/**
+    Writes the decimal digits of an integer so that they end at a given position, two digits at a time.
+    @param end the position just past the last digit
+    @param v the value to write
+    @return the position of the first character written
+ */
+static char *int_text(char *end, int64 v) {
+    // Pairs of digits "00" to "99"
+    static const char pairs[201] =
+        "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+        "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+    unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    char *p = end;
+    while (u >= 100) {
+        unsigned idx = (unsigned)(u % 100) * 2;
+        u /= 100;
+        *--p = pairs[idx + 1];
+        *--p = pairs[idx];
+    }
+    if (u >= 10) {
+        *--p = pairs[u * 2 + 1];
+        *--p = pairs[u * 2];
+    } else {
+        *--p = (char)('0' + u);
+    }
+    if (v < 0) {
+        *--p = '-';
+    }
+    return p;
+}
+
+/**
+    Copies text right-justified in a field, like the "%*.*s" conversion.
+    @param p the output position
+    @param s the text
+    @param len the length of the text
+    @param width the minimum field width
+    @return the position after the field
+ */
+static char *put_right(char *p, const char *s, int len, int width) {
+    if (len < width) {
+        memset(p, ' ', width - len);
+        p += width - len;
+    }
+    memcpy(p, s, len);
+    return p + len;
+}
+
+/**
+    Writes an integer right-justified in a field, like the "%*lld" conversion.
+    @param p the output position
+    @param v the value
+    @param width the minimum field width
+    @return the position after the field
+ */
+static char *put_int(char *p, int64 v, int width) {
+    char tmp[24];
+    char *s = int_text(tmp + sizeof(tmp), v);
+    return put_right(p, s, (int)(tmp + sizeof(tmp) - s), width);
+}
+
+/**
+    Writes an integer padded with zeros after its sign, like the "%0*lld" conversion.
+    @param p the output position
+    @param v the value
+    @param width the minimum field width
+    @return the position after the field
+ */
+static char *put_int_zero(char *p, int64 v, int width) {
+    char tmp[24];
+    char *s = int_text(tmp + sizeof(tmp), v);
+    int len = (int)(tmp + sizeof(tmp) - s);
+    if (v < 0) {
+        *p++ = *s++;
+        len--;
+        width--;
+    }
+    if (len < width) {
+        memset(p, '0', width - len);
+        p += width - len;
+    }
+    memcpy(p, s, len);
+    return p + len;
+}
+
+/**
+    Writes a fraction centered on its slash, with the slash at column WIDTH / 2. A numerator or
+    denominator too long for its side pushes the padding out the same way "%*s" with a negative
+    width did in the printf version, so the layout stays identical.
+    @param p the output position
+    @param num_text the digits of the numerator
+    @param len_f0 the length of the numerator
+    @param den_text the digits of the denominator
+    @param len_f1 the length of the denominator
+    @return the position after the field
+ */
+static char *put_centered(char *p, const char *num_text, int len_f0, const char *den_text, int len_f1) {
+    // The padding on each side depends only on the length of the number on that side
+    int slash_pos = WIDTH / 2;
+    int left_spaces = abs(slash_pos - len_f0);
+    int right_spaces = abs(WIDTH - slash_pos - 1 - len_f1);
+
+    memset(p, ' ', left_spaces);
+    p += left_spaces;
+    memcpy(p, num_text, len_f0);
+    p += len_f0;
+    *p++ = '/';
+    memcpy(p, den_text, len_f1);
+    p += len_f1;
+    memset(p, ' ', right_spaces);
+    return p + right_spaces;
+}
+
+/**
+    Writes a fraction of two int64 values centered on its slash.
+    @param p the output position
+    @param f the fraction
+    @return the position after the field
+ */
+static char *put_centered_fraction(char *p, const Fraction f) {
+    char num[24], den[24];
+    char *num_text = int_text(num + sizeof(num), f[0]);
+    char *den_text = int_text(den + sizeof(den), f[1]);
+    return put_centered(p, num_text, (int)(num + sizeof(num) - num_text), den_text, (int)(den + sizeof(den) - den_text));
+}
+
+/**
+    Writes a rational centered on its slash. Values held inline go through put_centered_fraction;
+    the rare value that spilled to arbitrary precision is formatted to text first.
+    @param p the output position
+    @param r the rational
+    @return the position after the field
+ */
+static char *put_centered_rational(char *p, const Rational *r) {
+    if (rational_is_small(r)) {
+        Fraction f = {r->num, r->den};
+        return put_centered_fraction(p, f);
+    }
+    size_t len = rational_format(r, NULL, 0);
+    char *text = malloc(len + 1);
+    if (text == NULL) {
+        fprintf(stderr, "Error: out of memory in put_centered_rational.\n");
+        exit(EXIT_FAILURE);
+    }
+    rational_format(r, text, len + 1);
+    int len_f0 = (int)(strchr(text, '/') - text);
+    p = put_centered(p, text, len_f0, text + len_f0 + 1, (int)len - len_f0 - 1);
+    free(text);
+    return p;
+}
+
+/**
+    Returns the room a centered rational needs beyond what ROW_MAX allows for two int64 values.
+    @param r the rational
+    @return extra bytes needed
+ */
+static size_t centered_extra(const Rational *r) {
+    return rational_is_small(r) ? 0 : rational_format(r, NULL, 0) + WIDTH;
+}
+
+/**
+    Formats a fraction into a centered string representation.
+    @param f the fraction array
+    @param buf buffer of at least CENTERED_MAX bytes to hold the formatted output
+ */
+void center_format_fraction(const Fraction f, char *buf) {
+    *put_centered_fraction(buf, f) = '\0';
+}
+
+/**
+    Formats a rational into a centered string representation. A value held inline is formatted into
+    buf like center_format_fraction; one that spilled to arbitrary precision needs more room and is
+    formatted into heap memory instead.
+    @param r the rational
+    @param buf buffer of at least CENTERED_MAX bytes
+    @return buf, or heap memory holding the text that the caller frees
+ */
+char *center_format_rational(const Rational *r, char *buf) {
+    char *text = buf;
+    if (!rational_is_small(r)) {
+        text = malloc(CENTERED_MAX + centered_extra(r));
+        if (text == NULL) {
+            fprintf(stderr, "Error: out of memory in center_format_rational.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    *put_centered_rational(text, r) = '\0';
+    return text;
+}
+
+/**
+    Calculates the duration of a row in seconds, handling flares that run past midnight.
+    @param row the tokenized row
+    @return the duration in seconds
+ */
+int row_duration(const FlareRow *row) {
+    int duration = row->end_sec - row->start_sec;
+    if (duration < 0) {
+        duration += SECOND_PER_DAY;
+    }
+    return duration;
+}
+
+/**
+    Picks the start date text of a row: the date as it appears in the input, or the date in the
+    compiled format if one was given.
+    @param row the tokenized row
+    @param format the output row format
+    @param formatted_date a buffer of DATE_TEXT_MAX bytes for a formatted date
+    @param date_len set to the length of the date text
+    @param date_width set to the width of the date column
+    @return the date text
+ */
+static const char *row_date(const FlareRow *row, const RowFormat *format, char *formatted_date, int *date_len,
+                            int *date_width) {
+    if (format->date.mode != DATE_AS_IS) {
+        *date_len = convert_date_field(row, &format->date, formatted_date);
+        *date_width = 11;
+        return formatted_date;
+    }
+    *date_len = row->start_date.len;
+    *date_width = 12;
+    return row->start_date.ptr;
+}
+
+/**
+    Writes the columns both output layouts start with: the flare ID, the start date, the three
+    times, the duration, and the peak.
+    @param p the output position
+    @param row the tokenized row
+    @param date_text the start date text
+    @param date_len the length of the date text
+    @param date_width the width of the date column
+    @return the position after the peak
+ */
+static char *put_row_start(char *p, const FlareRow *row, const char *date_text, int date_len, int date_width) {
+    p = put_right(p, row->flare_id.ptr, row->flare_id.len, 12);
+    p = put_right(p, date_text, date_len, date_width);
+    p = put_right(p, row->start_time.ptr, row->start_time.len, 9);
+    p = put_right(p, row->peak_time.ptr, row->peak_time.len, 9);
+    p = put_right(p, row->end_time.ptr, row->end_time.len, 9);
+    p = put_int(p, row_duration(row), 6);
+    *p++ = ' ';
+    p = put_int(p, row->peak[0], 4);
+    *p++ = '.';
+    return put_int_zero(p, row->peak[1], 3);
+}
+
+/**
+    Computes the derived values of one tokenized row: its start date text and its peak, rate, and
+    total count. The values are carried as fixed-point decimals, so the total is exact, and they are
+    reduced to fractions only when the fraction columns are printed. A value too large for int64 is
+    computed with Rationals, so it is printed exactly rather than stopping the program.
+    @param row the tokenized row
+    @param format the output row format
+    @param formatted_date a buffer of DATE_TEXT_MAX bytes for a formatted date, which must live as
+                          long as the values
+    @param values set to the values of the row; release them with row_values_free
+ */
+void compute_row(const FlareRow *row, const RowFormat *format, char *formatted_date, RowValues *values) {
+    uint64_t t = stats_start();
+    values->date_text = row_date(row, format, formatted_date, &values->date_len, &values->date_width);
+    t = stats_lap(STAGE_DATE, t);
+
+    FixedDecimal peak, avg_count_rate;
+    bool exact = fixed_from_decimal(row->peak, &peak) && fixed_from_decimal(row->avg, &avg_count_rate) &&
+                 fixed_multiply_int(&avg_count_rate, row_duration(row), &values->total_count);
+    if (format->decimal) {
+        if (!exact) {
+            fprintf(stderr, "Error: total count of flare %.*s is out of range.\n", row->flare_id.len, row->flare_id.ptr);
+            exit(EXIT_FAILURE);
+        }
+        values->peak = values->avg = values->total = (Rational)RATIONAL_ZERO;
+        stats_lap(STAGE_FRACTION, t);
+        return;
+    }
+
+    // Reduce each value once, by cancelling the factors of 2 and 5 it shares with its power of ten
+    Fraction peak_frac, avg_count_rate_frac, total_count_frac;
+    if (exact && fixed_to_fraction(&peak, peak_frac) && fixed_to_fraction(&avg_count_rate, avg_count_rate_frac) &&
+        fixed_to_fraction(&values->total_count, total_count_frac)) {
+        values->peak = (Rational){peak_frac[0], peak_frac[1], NULL};
+        values->avg = (Rational){avg_count_rate_frac[0], avg_count_rate_frac[1], NULL};
+        values->total = (Rational){total_count_frac[0], total_count_frac[1], NULL};
+        stats_lap(STAGE_FRACTION, t);
+        return;
+    }
+
+    // Convert peak and average decimal parts to Rationals
+    values->peak = values->avg = values->total = (Rational)RATIONAL_ZERO;
+    rational_from_decimal(row->peak, &values->peak);
+    rational_from_decimal(row->avg, &values->avg);
+
+    // Calculate total count in fraction. A whole number of seconds is already in lowest terms
+    Rational duration_frac = {row_duration(row), 1, NULL};
+    rational_multiply(&values->avg, &duration_frac, &values->total);
+    stats_lap(STAGE_FRACTION, t);
+}
+
+/**
+    Releases the heap storage a row's values may hold.
+    @param values the values to release
+ */
+void row_values_free(RowValues *values) {
+    rational_free(&values->peak);
+    rational_free(&values->avg);
+    rational_free(&values->total);
+}
+
+/**
+    Computes the derived values of one tokenized row and appends it in the same layout as process_stdio.
+    @param row the tokenized row
+    @param format the output row format
+    @param out the buffer to append the row to
+ */
+void emit_row(const FlareRow *row, const RowFormat *format, OutBuffer *out) {
+    char formatted_date[DATE_TEXT_MAX];
+    RowValues values;
+    compute_row(row, format, formatted_date, &values);
+    emit_row_values(row, &values, format, out);
+    row_values_free(&values);
+}
+
+/**
+    Appends a row whose fractions were already computed, in the same layout as process_stdio.
+    @param row the tokenized row
+    @param peak_frac the peak as a simplified fraction
+    @param avg_count_rate_frac the average count rate as a simplified fraction
+    @param total_count_frac the total count as a simplified fraction
+    @param format the output row format
+    @param out the buffer to append the row to
+ */
+void emit_row_fractions(const FlareRow *row, const Fraction peak_frac, const Fraction avg_count_rate_frac,
+                        const Fraction total_count_frac, const RowFormat *format, OutBuffer *out) {
+    char formatted_date[DATE_TEXT_MAX];
+    RowValues values;
+    uint64_t t = stats_start();
+    values.date_text = row_date(row, format, formatted_date, &values.date_len, &values.date_width);
+    stats_lap(STAGE_DATE, t);
+    values.peak = (Rational){peak_frac[0], peak_frac[1], NULL};
+    values.avg = (Rational){avg_count_rate_frac[0], avg_count_rate_frac[1], NULL};
+    values.total = (Rational){total_count_frac[0], total_count_frac[1], NULL};
+    emit_row_values(row, &values, format, out);
+}
+
+/**
+    Appends a row whose values were already computed, in the same layout as process_stdio, or in
+    the decimal layout, which prints the total count as a decimal in place of the three fraction
+    columns. The row is written straight into the output buffer without going through printf.
+    @param row the tokenized row
+    @param values the values computed by compute_row
+    @param format the output row format
+    @param out the buffer to append the row to
+ */
+void emit_row_values(const FlareRow *row, const RowValues *values, const RowFormat *format, OutBuffer *out) {
+    uint64_t t = stats_start();
+    char total_text[FIXED_TEXT_MAX];
+    int total_len = format->decimal ? fixed_format(&values->total_count, total_text) : 0;
+
+    // The numeric columns fit in ROW_MAX bytes; the text fields can be any length
+    size_t need = ROW_MAX + row->flare_id.len + values->date_len + row->start_time.len + row->peak_time.len +
+                  row->end_time.len + row->detectors.len;
+    if (!format->decimal) {
+        need += centered_extra(&values->peak) + centered_extra(&values->avg) + centered_extra(&values->total);
+    }
+    char *p = out_claim(out, need);
+    char *start = p;
+
+    p = put_row_start(p, row, values->date_text, values->date_len, values->date_width);
+    *p++ = ' ';
+    if (!format->decimal) {
+        *p++ = '(';
+        p = put_centered_rational(p, &values->peak);
+        *p++ = ')';
+        *p++ = ' ';
+    }
+    p = put_int(p, row->avg[0], 7);
+    *p++ = '.';
+    p = put_int_zero(p, row->avg[1], 10);
+    *p++ = ' ';
+    if (format->decimal) {
+        p = put_right(p, total_text, total_len, DECIMAL_WIDTH);
+    } else {
+        *p++ = '(';
+        p = put_centered_rational(p, &values->avg);
+        *p++ = ')';
+        *p++ = ' ';
+        *p++ = '(';
+        p = put_centered_rational(p, &values->total);
+        *p++ = ')';
+    }
+    *p++ = ' ';
+    p = put_right(p, row->detectors.ptr, row->detectors.len, 12);
+    *p++ = '\n';
+    out->len += (size_t)(p - start);
+    stats_lap(STAGE_FORMAT, t);
+}
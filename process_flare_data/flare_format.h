@@ -0,0 +1,65 @@
+/**
+     @file flare_format.h
+     This header file defines the functions that turn a tokenized flare row into its formatted output line.
+ */
+#ifndef FLARE_FORMAT_H
+#define FLARE_FORMAT_H
+
+#include <stdbool.h>
+#include "date_format.h"
+#include "fixed_decimal.h"
+#include "flare_parse.h"
+#include "fraction.h"
+#include "out_buffer.h"
+#include "rational.h"
+
+#define WIDTH 39 // Output width for formatted fractions
+#define SECOND_PER_DAY 86400 // Seconds in a day
+#define CENTERED_MAX 64 // Room for a centered fraction of two 20-character integers, with its NUL
+#define ROW_MAX 512 // Bound on an output row, not counting its text fields
+#define DECIMAL_WIDTH 24 // Output width for the total count in decimal output
+
+// How output rows are printed
+typedef struct {
+    DateFormat date; // Compiled date format
+    bool decimal;    // Print the total count as a decimal in place of the three fraction columns
+} RowFormat;
+
+// Derived values of a row, computed apart from its formatting
+typedef struct {
+    const char *date_text;     // Start date text: the input field, or a date in the compiled format
+    int date_len, date_width;  // Length of the date text, and width of its column
+    FixedDecimal total_count;  // Total count, kept for the decimal layout
+    Rational peak, avg, total; // Peak, average count rate, and total count in lowest terms
+} RowValues;
+
+// Convert the start date of a row with a compiled format into output (DATE_TEXT_MAX bytes), returning its length
+int convert_date_field(const FlareRow *row, const DateFormat *format, char *output);
+
+// Format a fraction centered on its slash in a WIDTH-character field (buf holds CENTERED_MAX bytes)
+void center_format_fraction(const Fraction f, char *buf);
+
+// Format a rational centered on its slash into buf (CENTERED_MAX bytes), or into heap memory the caller
+// frees if it does not fit; return the text
+char *center_format_rational(const Rational *r, char *buf);
+
+// Return the duration of a row in seconds, handling flares that run past midnight
+int row_duration(const FlareRow *row);
+
+// Compute the start date text and the peak, rate, and total count of a row (formatted_date holds DATE_TEXT_MAX bytes)
+void compute_row(const FlareRow *row, const RowFormat *format, char *formatted_date, RowValues *values);
+
+// Release the heap storage the values of a row may hold
+void row_values_free(RowValues *values);
+
+// Compute the derived values of a row and append its formatted output line
+void emit_row(const FlareRow *row, const RowFormat *format, OutBuffer *out);
+
+// Append the formatted output line of a row whose fractions were already computed and simplified
+void emit_row_fractions(const FlareRow *row, const Fraction peak_frac, const Fraction avg_count_rate_frac,
+                        const Fraction total_count_frac, const RowFormat *format, OutBuffer *out);
+
+// Append the formatted output line of a row whose values were already computed
+void emit_row_values(const FlareRow *row, const RowValues *values, const RowFormat *format, OutBuffer *out);
+
+#endif
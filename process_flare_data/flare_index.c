@@ -0,0 +1,460 @@
+/**
+    @file flare_index.c
+    This program builds and queries indexes over a flare table. Start times and peaks are kept as
+    sorted key arrays with the row of each key, so a range is found with two binary searches. Each
+    detector has a bitmap of the rows it saw. A query walks the smaller of its ranges, checks the
+    remaining conditions on those rows only, and marks matches in a result bitmap, which keeps the
+    output in table order. A query for the flares active during a window takes its candidates from
+    the interval tree instead: those active at the window's first instant, plus those starting later
+    within it, which the start keys give by binary search.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flare_date.h"
+#include "flare_format.h"
+#include "flare_index.h"
+
+typedef struct {
+    int64_t key;  // Sort key
+    uint32_t row; // Row the key belongs to
+} KeyedRow;
+
+typedef struct {
+    const FlareIndex *idx; // Indexes over the table
+    const FlareTable *t;   // Indexed table
+    const FlareQuery *q;   // Query being answered
+    uint64_t *result;      // Bitmap of matching rows
+    uint32_t matches;      // Rows marked so far
+} QueryScan;
+
+/**
+    This function allocates memory, exiting if it runs out.
+    @param size Number of bytes
+    @return The allocated memory, zeroed
+ */
+static void *alloc_zeroed(size_t size)
+{
+    void *p = calloc(size ? size : 1, 1);
+    if (p == NULL) {
+        fprintf(stderr, "Error: out of memory in flare_index.\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/**
+    This function orders keyed rows by key, then by row so equal keys keep table order.
+    @param a First keyed row
+    @param b Second keyed row
+    @return Negative, zero or positive as in qsort
+ */
+static int compare_keyed(const void *a, const void *b)
+{
+    const KeyedRow *x = a;
+    const KeyedRow *y = b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+/**
+    This function sorts rows by key into a pair of parallel arrays.
+    @param pairs Keys and rows to sort (reordered in place)
+    @param count Number of pairs
+    @param keys Sorted keys
+    @param rows Row of each sorted key
+ */
+static void build_sorted(KeyedRow *pairs, uint32_t count, int64_t **keys, uint32_t **rows)
+{
+    qsort(pairs, count, sizeof(KeyedRow), compare_keyed);
+    *keys = alloc_zeroed(count * sizeof(int64_t));
+    *rows = alloc_zeroed(count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < count; i++) {
+        (*keys)[i] = pairs[i].key;
+        (*rows)[i] = pairs[i].row;
+    }
+}
+
+/**
+    This function finds the first key that is not less than value (or greater than value if strict).
+    @param keys Sorted keys
+    @param count Number of keys
+    @param value Value to search for
+    @param strict Set to skip keys equal to value
+    @return Index of the first key past the bound
+ */
+static uint32_t lower_bound(const int64_t *keys, uint32_t count, int64_t value, bool strict)
+{
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (keys[mid] < value || (strict && keys[mid] == value)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+    This function computes when a flare started.
+    @param t Table holding the flare
+    @param i Row of the flare
+    @return Start time in seconds since 1970-01-01
+ */
+int64_t table_start_time(const FlareTable *t, uint32_t i)
+{
+    return (int64_t)t->date_days[t->date_codes[i]] * SECOND_PER_DAY + t->start_sec[i];
+}
+
+/**
+    This function computes when a flare ended. An end time earlier in the day than the start time
+    means the flare ran past midnight, as in process_table's durations.
+    @param t Table holding the flare
+    @param i Row of the flare
+    @return End time in seconds since 1970-01-01
+ */
+int64_t table_end_time(const FlareTable *t, uint32_t i)
+{
+    int64_t day = (int64_t)t->date_days[t->date_codes[i]] * SECOND_PER_DAY;
+    return day + t->end_sec[i] + (t->end_sec[i] < t->start_sec[i] ? SECOND_PER_DAY : 0);
+}
+
+/**
+    This function turns the peak of a flare into an integer, combining its parts the same way
+    from_decimal_parts does.
+    @param t Table holding the flare
+    @param i Row of the flare
+    @return Peak multiplied by 10^PEAK_DECIMAL_LENGTH
+ */
+int64_t table_peak_scaled(const FlareTable *t, uint32_t i)
+{
+    int64_t scaled = (int64_t)t->peak_int[i] * PEAK_SCALE;
+    return t->peak_int[i] >= 0 ? scaled + t->peak_dec[i] : scaled - t->peak_dec[i];
+}
+
+/**
+    This function converts a detector list into a mask with bit k set for detector n<k>, where
+    detectors 10 and 11 are written na and nb. Other names, such as the BGO detectors, are ignored.
+    @param s Detector list separated by whitespace or commas
+    @param len Length of the list
+    @return Mask of the detectors found
+ */
+uint16_t detector_mask(const char *s, int len)
+{
+    uint16_t mask = 0;
+    int i = 0;
+    while (i < len) {
+        // Find the next name
+        while (i < len && (s[i] == ' ' || s[i] == '\t' || s[i] == ',' || s[i] == '\r')) {
+            i++;
+        }
+        int start = i;
+        while (i < len && s[i] != ' ' && s[i] != '\t' && s[i] != ',' && s[i] != '\r') {
+            i++;
+        }
+        if (i - start == 2 && s[start] == 'n') {
+            char c = s[start + 1];
+            if (c >= '0' && c <= '9') {
+                mask |= 1u << (c - '0');
+            } else if (c == 'a' || c == 'b') {
+                mask |= 1u << (10 + c - 'a');
+            }
+        }
+    }
+    return mask;
+}
+
+/**
+    This function reads an unsigned decimal number of exactly width digits.
+    @param s Text to read
+    @param width Number of digits
+    @param value Parsed number
+    @return true if s starts with width digits
+ */
+static bool read_digits(const char *s, int width, int *value)
+{
+    *value = 0;
+    for (int i = 0; i < width; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return false;
+        }
+        *value = *value * 10 + (s[i] - '0');
+    }
+    return true;
+}
+
+/**
+    This function parses the time bound of a query. Without a time of day the bound is the start
+    of the day, or its last second if end_of_day is set, so "--to" includes the whole day.
+    @param s Text of the bound
+    @param end_of_day Set to default to 23:59:59 instead of 00:00:00
+    @param seconds Bound in seconds since 1970-01-01
+    @return true if the text is a valid date and time
+ */
+bool query_parse_time(const char *s, bool end_of_day, int64_t *seconds)
+{
+    int year, month, day;
+    const char *rest;
+    if (read_digits(s, 4, &year) && s[4] == '-' && read_digits(s + 5, 2, &month) && s[7] == '-' &&
+        read_digits(s + 8, 2, &day)) {
+        rest = s + 10;
+    } else {
+        // Fall back to the "D-Mon-YYYY" layout of the flare list
+        const char *sep = strpbrk(s, "T ");
+        Field date = {s, sep ? (int)(sep - s) : (int)strlen(s)};
+        if (!flare_parse_date(date, &year, &month, &day)) {
+            return false;
+        }
+        rest = s + date.len;
+    }
+    if (!valid_civil(year, month, day)) {
+        return false;
+    }
+
+    int h = 0, m = 0, sec = 0;
+    if (*rest == 'T' || *rest == ' ') {
+        if (!read_digits(rest + 1, 2, &h) || rest[3] != ':' || !read_digits(rest + 4, 2, &m)) {
+            return false;
+        }
+        rest += 6;
+        if (*rest == ':') {
+            if (!read_digits(rest + 1, 2, &sec)) {
+                return false;
+            }
+            rest += 3;
+        }
+    } else if (end_of_day) {
+        h = 23;
+        m = 59;
+        sec = 59;
+    }
+    if (*rest != '\0' || h > 23 || m > 59 || sec > 59) {
+        return false;
+    }
+    *seconds = (int64_t)days_from_civil(year, month, day) * SECOND_PER_DAY + h * 3600 + m * 60 + sec;
+    return true;
+}
+
+/**
+    This function parses an activity window "FROM,TO". Each side is a query time, and a side
+    without a time of day covers its whole day, so "2020-01-01,2020-01-02" spans both days.
+    @param s Text of the window
+    @param from Start of the window in seconds since 1970-01-01
+    @param to End of the window in seconds since 1970-01-01, inclusive
+    @return true if both sides are valid and the window does not end before it starts
+ */
+bool query_parse_window(const char *s, int64_t *from, int64_t *to)
+{
+    const char *comma = strchr(s, ',');
+    char first[64];
+    if (comma == NULL || comma - s >= (long)sizeof(first)) {
+        return false;
+    }
+    memcpy(first, s, (size_t)(comma - s));
+    first[comma - s] = '\0';
+    return query_parse_time(first, false, from) && query_parse_time(comma + 1, true, to) && *from <= *to;
+}
+
+/**
+    This function parses a peak threshold with up to PEAK_DECIMAL_LENGTH decimals.
+    @param s Text of the threshold
+    @param scaled Threshold multiplied by PEAK_SCALE
+    @return true if the text is a non-negative decimal number whose scaled value fits in int64
+ */
+bool query_parse_peak(const char *s, int64_t *scaled)
+{
+    int64_t value = 0;
+    int decimals = -1;
+    if (*s == '\0') {
+        return false;
+    }
+    for (; *s != '\0'; s++) {
+        if (*s == '.' && decimals < 0) {
+            decimals = 0;
+        } else if (*s >= '0' && *s <= '9' && decimals < PEAK_DECIMAL_LENGTH &&
+                   value <= (INT64_MAX - (*s - '0')) / 10) {
+            value = value * 10 + (*s - '0');
+            if (decimals >= 0) {
+                decimals++;
+            }
+        } else {
+            return false;
+        }
+    }
+    for (int i = decimals < 0 ? 0 : decimals; i < PEAK_DECIMAL_LENGTH; i++) {
+        if (value > INT64_MAX / 10) {
+            return false;
+        }
+        value *= 10;
+    }
+    *scaled = value;
+    return true;
+}
+
+/**
+    This function builds the start time, peak, detector and interval indexes over a table.
+    @param idx Indexes to build
+    @param t Table to index
+ */
+void index_build(FlareIndex *idx, const FlareTable *t)
+{
+    uint32_t n = t->count;
+    idx->count = n;
+    KeyedRow *pairs = alloc_zeroed(n * sizeof(KeyedRow));
+
+    for (uint32_t i = 0; i < n; i++) {
+        pairs[i].key = table_start_time(t, i);
+        pairs[i].row = i;
+    }
+    build_sorted(pairs, n, &idx->start_keys, &idx->start_rows);
+
+    // The interval tree wants the rows in start order, which the start index already has
+    int64_t *starts = alloc_zeroed(n * sizeof(int64_t));
+    int64_t *ends = alloc_zeroed(n * sizeof(int64_t));
+    for (uint32_t i = 0; i < n; i++) {
+        starts[i] = table_start_time(t, i);
+        ends[i] = table_end_time(t, i);
+    }
+    interval_build(&idx->intervals, starts, ends, idx->start_rows, n);
+    free(starts);
+    free(ends);
+
+    for (uint32_t i = 0; i < n; i++) {
+        pairs[i].key = table_peak_scaled(t, i);
+        pairs[i].row = i;
+    }
+    build_sorted(pairs, n, &idx->peak_keys, &idx->peak_rows);
+    free(pairs);
+
+    // Decode each distinct detector string once, then spread the masks over the rows
+    idx->detector_masks = alloc_zeroed(t->detector_count * sizeof(uint16_t));
+    for (uint32_t c = 0; c < t->detector_count; c++) {
+        idx->detector_masks[c] = detector_mask(t->detector_chars + t->detector_offsets[c],
+                                               (int)(t->detector_offsets[c + 1] - t->detector_offsets[c]));
+    }
+    idx->words = (n + 63) / 64;
+    for (int d = 0; d < DETECTOR_COUNT; d++) {
+        idx->detector_bits[d] = alloc_zeroed(idx->words * sizeof(uint64_t));
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint16_t mask = idx->detector_masks[t->detector_codes[i]];
+        for (int d = 0; d < DETECTOR_COUNT; d++) {
+            if (mask & (1u << d)) {
+                idx->detector_bits[d][i / 64] |= (uint64_t)1 << (i % 64);
+            }
+        }
+    }
+}
+
+/**
+    This function marks a candidate row if it satisfies every condition of a query.
+    @param i Row to check
+    @param ctx QueryScan of the query
+ */
+static void mark_if_match(uint32_t i, void *ctx)
+{
+    QueryScan *scan = ctx;
+    const FlareQuery *q = scan->q;
+    const FlareTable *t = scan->t;
+    // A row whose start date is not a real date has no time, so no time condition holds for it
+    if ((q->has_from || q->has_to || q->has_active) && t->date_days[t->date_codes[i]] == DATE_DAYS_NONE) {
+        return;
+    }
+    int64_t start = table_start_time(t, i);
+    if ((q->has_from && start < q->from) || (q->has_to && start > q->to) ||
+        (q->has_min_peak && table_peak_scaled(t, i) <= q->min_peak) ||
+        (scan->idx->detector_masks[t->detector_codes[i]] & q->detectors) != q->detectors) {
+        return;
+    }
+    scan->result[i / 64] |= (uint64_t)1 << (i % 64);
+    scan->matches++;
+}
+
+/**
+    This function marks every row that satisfies a query. The start time and peak ranges are located
+    by binary search and the narrower one is scanned; a query with only detectors ANDs their bitmaps.
+    A flare is active during [active_from, active_to] if it contains active_from, which the interval
+    tree answers, or starts after it but no later than active_to; the two sets do not overlap.
+    @param idx Indexes over the table
+    @param t Indexed table
+    @param q Query to answer
+    @param result Bitmap of idx->words words that receives the matching rows
+    @return Number of matching rows
+ */
+uint32_t index_query(const FlareIndex *idx, const FlareTable *t, const FlareQuery *q, uint64_t *result)
+{
+    uint32_t n = idx->count;
+    memset(result, 0, idx->words * sizeof(uint64_t));
+
+    // Locate the start time and peak ranges
+    uint32_t start_lo = q->has_from ? lower_bound(idx->start_keys, n, q->from, false) : 0;
+    uint32_t start_hi = q->has_to ? lower_bound(idx->start_keys, n, q->to, true) : n;
+    uint32_t peak_lo = q->has_min_peak ? lower_bound(idx->peak_keys, n, q->min_peak, true) : 0;
+    if (start_hi < start_lo) {
+        start_hi = start_lo;
+    }
+
+    QueryScan scan = {idx, t, q, result, 0};
+    if (q->has_active) {
+        interval_stab(&idx->intervals, q->active_from, mark_if_match, &scan);
+        uint32_t lo = lower_bound(idx->start_keys, n, q->active_from, true);
+        uint32_t hi = lower_bound(idx->start_keys, n, q->active_to, true);
+        for (uint32_t k = lo; k < hi; k++) {
+            mark_if_match(idx->start_rows[k], &scan);
+        }
+        return scan.matches;
+    }
+
+    uint32_t matches = 0;
+    if (!q->has_from && !q->has_to && !q->has_min_peak) {
+        // No range condition: intersect the detector bitmaps, or take every row
+        for (size_t w = 0; w < idx->words; w++) {
+            uint64_t bits = (w + 1 < idx->words || n % 64 == 0) ? ~(uint64_t)0 : ((uint64_t)1 << (n % 64)) - 1;
+            for (int d = 0; d < DETECTOR_COUNT; d++) {
+                if (q->detectors & (1u << d)) {
+                    bits &= idx->detector_bits[d][w];
+                }
+            }
+            result[w] = bits;
+            matches += (uint32_t)__builtin_popcountll(bits);
+        }
+        return matches;
+    }
+
+    // Scan the narrower range and check the other conditions row by row
+    const uint32_t *rows;
+    uint32_t count;
+    if (start_hi - start_lo <= n - peak_lo) {
+        rows = idx->start_rows + start_lo;
+        count = start_hi - start_lo;
+    } else {
+        rows = idx->peak_rows + peak_lo;
+        count = n - peak_lo;
+    }
+    for (uint32_t k = 0; k < count; k++) {
+        mark_if_match(rows[k], &scan);
+    }
+    return scan.matches;
+}
+
+/**
+    This function releases the memory held by the indexes.
+    @param idx Indexes to release
+ */
+void index_free(FlareIndex *idx)
+{
+    free(idx->start_keys);
+    free(idx->start_rows);
+    free(idx->peak_keys);
+    free(idx->peak_rows);
+    free(idx->detector_masks);
+    for (int d = 0; d < DETECTOR_COUNT; d++) {
+        free(idx->detector_bits[d]);
+    }
+    interval_free(&idx->intervals);
+    memset(idx, 0, sizeof(*idx));
+}
@@ -0,0 +1,73 @@
+/**
+     @file flare_index.h
+     This header file defines the indexes used to answer queries over a flare table without scanning
+     it: start time and peak value sorted for range lookups, one bitmap of rows per detector, and an
+     interval tree over each flare's start and end for finding the flares active at a given time.
+ */
+#ifndef FLARE_INDEX_H
+#define FLARE_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "flare_interval.h"
+#include "flare_table.h"
+
+#define DETECTOR_COUNT 12 // NaI detectors n0 .. n9, na and nb
+#define PEAK_SCALE 1000 // 10^PEAK_DECIMAL_LENGTH
+
+typedef struct {
+    uint32_t count;                           // Number of rows indexed
+    int64_t *start_keys;                      // Absolute start times in seconds, ascending
+    uint32_t *start_rows;                     // Row of each start key
+    int64_t *peak_keys;                       // Peaks scaled by 10^PEAK_DECIMAL_LENGTH, ascending
+    uint32_t *peak_rows;                      // Row of each peak key
+    uint16_t *detector_masks;                 // Detector mask of each detector dictionary code
+    size_t words;                             // 64-bit words per bitmap
+    uint64_t *detector_bits[DETECTOR_COUNT];  // Rows seen by each detector
+    IntervalIndex intervals;                  // Absolute start and end time of each row
+} FlareIndex;
+
+typedef struct {
+    bool has_from;       // Set to keep rows starting at or after from
+    int64_t from;        // Absolute start time lower bound in seconds
+    bool has_to;         // Set to keep rows starting at or before to
+    int64_t to;          // Absolute start time upper bound in seconds
+    bool has_min_peak;   // Set to keep rows with a peak above min_peak
+    int64_t min_peak;    // Exclusive peak lower bound, scaled by 10^PEAK_DECIMAL_LENGTH
+    uint16_t detectors;  // Mask of detectors that must all have seen the flare
+    bool has_active;     // Set to keep rows active at some time in [active_from, active_to]
+    int64_t active_from; // Absolute start of the activity window in seconds
+    int64_t active_to;   // Absolute end of the activity window in seconds, inclusive
+} FlareQuery;
+
+// Return the absolute start time of row i in seconds since 1970-01-01
+int64_t table_start_time(const FlareTable *t, uint32_t i);
+
+// Return the absolute end time of row i in seconds, on the next day if the flare wrapped past midnight
+int64_t table_end_time(const FlareTable *t, uint32_t i);
+
+// Return the peak of row i scaled by 10^PEAK_DECIMAL_LENGTH
+int64_t table_peak_scaled(const FlareTable *t, uint32_t i);
+
+// Convert a detector list such as "n5 n1 n3 n4" into a mask, ignoring other detectors
+uint16_t detector_mask(const char *s, int len);
+
+// Parse a query time "YYYY-MM-DD" or "D-Mon-YYYY", optionally followed by "THH:MM[:SS]"
+bool query_parse_time(const char *s, bool end_of_day, int64_t *seconds);
+
+// Parse an activity window "FROM,TO" of two query times, where a bare date covers its whole day
+bool query_parse_window(const char *s, int64_t *from, int64_t *to);
+
+// Parse a peak threshold such as "10" or "2.5" scaled by PEAK_SCALE
+bool query_parse_peak(const char *s, int64_t *scaled);
+
+// Build all indexes over a table
+void index_build(FlareIndex *idx, const FlareTable *t);
+
+// Set the bit of every matching row in result (idx->words words) and return the number of matches
+uint32_t index_query(const FlareIndex *idx, const FlareTable *t, const FlareQuery *q, uint64_t *result);
+
+// Release the memory held by the indexes
+void index_free(FlareIndex *idx);
+
+#endif
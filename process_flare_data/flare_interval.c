@@ -0,0 +1,234 @@
+/**
+    @file flare_interval.c
+    This program builds and queries a centered interval tree over flare time windows. The center of
+    each node is the median of the endpoints below it, so at most half of the intervals go to either
+    side and the tree is O(log n) deep. Its intervals are partitioned in start order, so every node's
+    list is already sorted by start and only the end order has to be sorted. A stabbing query at t
+    reads, at each node on its path, only the intervals that contain t: from the front of the start
+    list if t is before the center, or from the front of the end list if it is after.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flare_interval.h"
+
+typedef struct {
+    int64_t start; // Absolute start time
+    int64_t end;   // Absolute end time
+    uint32_t row;  // Row of the interval
+} Interval;
+
+/**
+    This function allocates memory, exiting if it runs out.
+    @param size Number of bytes
+    @return The allocated memory
+ */
+static void *checked_malloc(size_t size)
+{
+    void *p = malloc(size ? size : 1);
+    if (p == NULL) {
+        fprintf(stderr, "Error: out of memory in flare_interval.\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/**
+    This function finds the k-th smallest value by quickselect, reordering the array. The pivot is
+    the middle element, so input that is already nearly sorted, as flare times are, splits evenly.
+    @param a Values
+    @param n Number of values
+    @param k Rank to find (0 for the smallest)
+    @return The k-th smallest value
+ */
+static int64_t select_kth(int64_t *a, long n, long k)
+{
+    long lo = 0, hi = n - 1;
+    while (lo < hi) {
+        int64_t pivot = a[lo + (hi - lo) / 2];
+        long i = lo, j = hi;
+        while (i <= j) {
+            while (a[i] < pivot) {
+                i++;
+            }
+            while (a[j] > pivot) {
+                j--;
+            }
+            if (i <= j) {
+                int64_t tmp = a[i];
+                a[i++] = a[j];
+                a[j--] = tmp;
+            }
+        }
+        // Now a[lo .. j] <= pivot <= a[i .. hi], and everything between equals the pivot
+        if (k <= j) {
+            hi = j;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            return a[k];
+        }
+    }
+    return a[lo];
+}
+
+/**
+    This function orders intervals by descending end.
+    @param a First interval
+    @param b Second interval
+    @return Negative, zero, or positive as a ends after, with, or before b
+ */
+static int compare_end_descending(const void *a, const void *b)
+{
+    int64_t x = ((const Interval *)a)->end, y = ((const Interval *)b)->end;
+    return (x < y) - (x > y);
+}
+
+/**
+    This function builds the subtree of a run of intervals sorted by start. The run is reordered
+    into the intervals before the center, those containing it, and those after, each still in start
+    order; the middle part becomes the node and the two sides its children.
+    @param x Index being built
+    @param items Intervals of the subtree, in ascending order of start
+    @param n Number of intervals
+    @param endpoints Scratch room for 2 * n endpoints
+    @param scratch Scratch room for n intervals
+    @return The node of the subtree, or INTERVAL_NONE if it is empty
+ */
+static uint32_t build_node(IntervalIndex *x, Interval *items, uint32_t n, int64_t *endpoints, Interval *scratch)
+{
+    if (n == 0) {
+        return INTERVAL_NONE;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        endpoints[2 * i] = items[i].start;
+        endpoints[2 * i + 1] = items[i].end;
+    }
+    int64_t center = select_kth(endpoints, 2 * (long)n, n);
+
+    // Partition in start order: before the center, containing it, after it
+    uint32_t before = 0, containing = 0, after = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (items[i].end < center) {
+            scratch[before++] = items[i];
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (items[i].start <= center && items[i].end >= center) {
+            scratch[before + containing++] = items[i];
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (items[i].start > center) {
+            scratch[before + containing + after++] = items[i];
+        }
+    }
+    memcpy(items, scratch, n * sizeof(Interval));
+
+    // The center is an endpoint, so at least its own interval contains it and the node is not empty
+    // and nodes are numbered in the order they are filled, so its entries follow the previous node's
+    uint32_t node = x->node_count++;
+    uint32_t first = node == 0 ? 0 : x->nodes[node - 1].first + x->nodes[node - 1].count;
+    Interval *mid = items + before;
+    for (uint32_t i = 0; i < containing; i++) {
+        x->by_start_keys[first + i] = mid[i].start;
+        x->by_start_rows[first + i] = mid[i].row;
+    }
+    memcpy(scratch, mid, containing * sizeof(Interval));
+    qsort(scratch, containing, sizeof(Interval), compare_end_descending);
+    for (uint32_t i = 0; i < containing; i++) {
+        x->by_end_keys[first + i] = scratch[i].end;
+        x->by_end_rows[first + i] = scratch[i].row;
+    }
+    x->nodes[node] = (IntervalNode){center, INTERVAL_NONE, INTERVAL_NONE, first, containing};
+
+    uint32_t left = build_node(x, items, before, endpoints, scratch);
+    uint32_t right = build_node(x, mid + containing, after, endpoints, scratch);
+    x->nodes[node].left = left;
+    x->nodes[node].right = right;
+    return node;
+}
+
+/**
+    This function builds the interval index over a table's flares.
+    @param x Index to build
+    @param starts Absolute start time of each row
+    @param ends Absolute end time of each row, not before its start
+    @param order Rows in ascending order of start
+    @param count Number of rows
+ */
+void interval_build(IntervalIndex *x, const int64_t *starts, const int64_t *ends, const uint32_t *order,
+                    uint32_t count)
+{
+    memset(x, 0, sizeof(*x));
+    x->nodes = checked_malloc(count * sizeof(IntervalNode));
+    x->by_start_keys = checked_malloc(count * sizeof(int64_t));
+    x->by_start_rows = checked_malloc(count * sizeof(uint32_t));
+    x->by_end_keys = checked_malloc(count * sizeof(int64_t));
+    x->by_end_rows = checked_malloc(count * sizeof(uint32_t));
+
+    Interval *items = checked_malloc(count * sizeof(Interval));
+    Interval *scratch = checked_malloc(count * sizeof(Interval));
+    int64_t *endpoints = checked_malloc(2 * (size_t)count * sizeof(int64_t));
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t row = order[i];
+        items[i] = (Interval){starts[row], ends[row], row};
+    }
+    x->root = build_node(x, items, count, endpoints, scratch);
+    free(items);
+    free(scratch);
+    free(endpoints);
+}
+
+/**
+    This function reports every interval that contains an instant. On the path from the root, a
+    node whose center is after t can only hold matches at the front of its start list, and one whose
+    center is before t at the front of its end list, so no interval is looked at without reporting it
+    except the one that ends each scan.
+    @param x Index to search
+    @param t Instant in seconds since 1970-01-01
+    @param report Called with the row of each interval containing t
+    @param ctx Passed to report
+    @return Number of intervals reported
+ */
+uint32_t interval_stab(const IntervalIndex *x, int64_t t, void (*report)(uint32_t row, void *ctx), void *ctx)
+{
+    uint32_t found = 0;
+    uint32_t node = x->root;
+    while (node != INTERVAL_NONE) {
+        const IntervalNode *nd = &x->nodes[node];
+        uint32_t k = nd->first, stop = nd->first + nd->count;
+        if (t < nd->center) {
+            for (; k < stop && x->by_start_keys[k] <= t; k++) {
+                report(x->by_start_rows[k], ctx);
+            }
+            node = nd->left;
+        } else if (t > nd->center) {
+            for (; k < stop && x->by_end_keys[k] >= t; k++) {
+                report(x->by_end_rows[k], ctx);
+            }
+            node = nd->right;
+        } else {
+            for (; k < stop; k++) {
+                report(x->by_start_rows[k], ctx);
+            }
+            node = INTERVAL_NONE;
+        }
+        found += k - nd->first;
+    }
+    return found;
+}
+
+/**
+    This function releases the memory held by an interval index.
+    @param x Index to release
+ */
+void interval_free(IntervalIndex *x)
+{
+    free(x->nodes);
+    free(x->by_start_keys);
+    free(x->by_start_rows);
+    free(x->by_end_keys);
+    free(x->by_end_rows);
+    memset(x, 0, sizeof(*x));
+}
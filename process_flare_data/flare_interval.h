@@ -0,0 +1,44 @@
+/**
+     @file flare_interval.h
+     This header file defines an interval index over the absolute start and end times of flares,
+     answering which flares were active at an instant. It is a centered interval tree: each node
+     holds the intervals that contain its center, sorted both by start and by end, and the intervals
+     entirely before or after the center go to its two children. A query follows one path from the
+     root, so it takes O(log n) steps plus one per flare it reports.
+ */
+#ifndef FLARE_INTERVAL_H
+#define FLARE_INTERVAL_H
+
+#include <stdint.h>
+
+#define INTERVAL_NONE UINT32_MAX // Child index of a missing subtree
+
+typedef struct {
+    int64_t center; // Instant every interval of the node contains
+    uint32_t left;  // Node of the intervals that end before center, or INTERVAL_NONE
+    uint32_t right; // Node of the intervals that start after center, or INTERVAL_NONE
+    uint32_t first; // First entry of the node's intervals in the sorted arrays
+    uint32_t count; // Number of intervals of the node
+} IntervalNode;
+
+typedef struct {
+    uint32_t root;           // Root node, or INTERVAL_NONE if there are no intervals
+    uint32_t node_count;     // Nodes in use
+    IntervalNode *nodes;     // Nodes of the tree
+    int64_t *by_start_keys;  // Start of each node's intervals, ascending within the node
+    uint32_t *by_start_rows; // Row of each by_start_keys entry
+    int64_t *by_end_keys;    // End of each node's intervals, descending within the node
+    uint32_t *by_end_rows;   // Row of each by_end_keys entry
+} IntervalIndex;
+
+// Build the index over count intervals [starts[r], ends[r]], given the rows in ascending order of start
+void interval_build(IntervalIndex *x, const int64_t *starts, const int64_t *ends, const uint32_t *order,
+                    uint32_t count);
+
+// Call report for the row of every interval that contains the instant t, returning how many there were
+uint32_t interval_stab(const IntervalIndex *x, int64_t t, void (*report)(uint32_t row, void *ctx), void *ctx);
+
+// Release the memory held by the index
+void interval_free(IntervalIndex *x);
+
+#endif
@@ -0,0 +1,591 @@
+/**
+    @file flare_parse.c
+    This program provides a hand-written field scanner for the Fermi GBM flare list. Lines and field
+    boundaries are found from the newline and blank bit masks of 64-byte blocks, so the scanner jumps
+    from one boundary to the next; each text field is recorded as a view into the line, and the
+    numeric columns and times of day are converted without going through the scanf family.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flare_parse.h"
+#include "flare_date.h"
+#include "flare_scan.h"
+
+typedef struct {
+    const char *base;      // First byte described by the masks
+    const uint64_t *blank; // Blank mask of each block from base on
+} MaskView;
+
+typedef struct {
+    const MaskView *v; // Masks covering the line
+    const char *end;   // End of the line
+    size_t block;      // Block of the changes in edges
+    uint64_t edges;    // Class changes of the block not taken yet
+} EdgeCursor;
+
+// Work done on a line covered by masks
+typedef bool (*LineFn)(const MaskView *v, const char *p, const char *end, FlareRow *row);
+
+/**
+    This function finds the first position in [p, end) whose blank bit differs from flip. The bits
+    before p are masked off and the lowest set bit left gives the position, so a run of characters
+    of the same class is passed in one step.
+    @param v Masks covering the line
+    @param p Position to start at
+    @param end End of the line
+    @param flip 0 to find a blank, or all ones to find a character that is not blank
+    @return The position found, or end
+ */
+static inline const char *find_class(const MaskView *v, const char *p, const char *end, uint64_t flip)
+{
+    if (p >= end) {
+        return end;
+    }
+    size_t i = (size_t)(p - v->base);
+    size_t block = i / SCAN_BLOCK;
+    uint64_t bits = (v->blank[block] ^ flip) & (~0ULL << (i % SCAN_BLOCK));
+    while (bits == 0) {
+        block++;
+        if (v->base + block * SCAN_BLOCK >= end) {
+            return end;
+        }
+        bits = v->blank[block] ^ flip;
+    }
+    const char *q = v->base + block * SCAN_BLOCK + __builtin_ctzll(bits);
+    return q < end ? q : end;
+}
+
+/**
+    This function advances past whitespace.
+    @param v Masks covering the line
+    @param p Current position
+    @param end End of the line
+    @return The first non-whitespace position, or end
+ */
+static inline const char *skip_blanks(const MaskView *v, const char *p, const char *end)
+{
+    return find_class(v, p, end, ~0ULL);
+}
+
+/**
+    This function reads a whitespace-delimited token, like the %s conversion.
+    @param v Masks covering the line
+    @param p Current position, updated to the character after the token
+    @param end End of the line
+    @param field Field to store the token in
+    @return true if a non-empty token was found
+ */
+static bool scan_token(const MaskView *v, const char **p, const char *end, Field *field)
+{
+    const char *start = skip_blanks(v, *p, end);
+    const char *q = find_class(v, start, end, 0);
+    field->ptr = start;
+    field->len = (int)(q - start);
+    *p = q;
+    return q > start;
+}
+
+/**
+    This function reads an optionally signed decimal integer at the current position,
+    without skipping leading whitespace. A number too large for int64 makes the line malformed.
+    @param p Current position, updated to the character after the number
+    @param end End of the line
+    @param value Parsed value
+    @return true if at least one digit was read and the number fits in int64
+ */
+static bool scan_int(const char **p, const char *end, int64 *value)
+{
+    const char *q = *p;
+    bool negative = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+        negative = *q == '-';
+        q++;
+    }
+    const char *digits = q;
+    int64 v = 0;
+    while (q < end && *q >= '0' && *q <= '9') {
+        if (__builtin_mul_overflow(v, 10, &v) || __builtin_add_overflow(v, *q - '0', &v)) {
+            return false;
+        }
+        q++;
+    }
+    if (q == digits) {
+        return false;
+    }
+    *value = negative ? -v : v;
+    *p = q;
+    return true;
+}
+
+/**
+    This function converts a run of digits whose length is already known. The loop does not stop
+    at the first character that is not a digit, so its exit branch follows the length alone.
+    @param p First character
+    @param n Number of characters (at most 18, so the value cannot overflow)
+    @param value Parsed value
+    @return true if every character is a digit
+ */
+static inline bool scan_digits(const char *p, int n, int64 *value)
+{
+    uint64_t v = 0;
+    unsigned bad = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // Eight digits at once: check that every byte is 0x30 - 0x39, then combine pairs, quads, and halves
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t x;
+        memcpy(&x, p, 8);
+        bad |= (((x & 0xF0F0F0F0F0F0F0F0ULL) | (((x + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) !=
+                0x3333333333333333ULL);
+        x -= 0x3030303030303030ULL;
+        x = (x * 10) + (x >> 8);
+        x = (((x & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+             (((x >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+        v = v * 100000000 + x;
+    }
+#endif
+    for (int i = 0; i < n; i++) {
+        unsigned d = (unsigned)(unsigned char)p[i] - '0';
+        bad |= d > 9;
+        v = v * 10 + d;
+    }
+    *value = (int64)v;
+    return bad == 0;
+}
+
+/**
+    This function reads a column that is exactly "<digits>.<digits>", with at most 18 digits on
+    each side, as scan_decimal would read it.
+    @param p Start of the column
+    @param end End of the column
+    @param decimal_length Decimal length to record in the parts
+    @param parts DecimalParts to store the result in
+    @return true if the column has that shape
+ */
+static inline bool scan_plain_decimal(const char *p, const char *end, int64 decimal_length, DecimalParts parts)
+{
+    const char *dot = memchr(p, '.', (size_t)(end - p));
+    if (dot == NULL || dot == p || dot - p > 18 || end - dot < 2 || end - dot > 19 ||
+        !scan_digits(p, (int)(dot - p), &parts[0]) || !scan_digits(dot + 1, (int)(end - dot - 1), &parts[1])) {
+        return false;
+    }
+    parts[2] = decimal_length;
+    return true;
+}
+
+/**
+    This function reads a "<int>.<int>" column into DecimalParts with the given decimal length,
+    the same way the "%lld.%lld" conversion pair splits it.
+    @param v Masks covering the line
+    @param p Current position, updated to the character after the number
+    @param end End of the line
+    @param decimal_length Decimal length to record in the parts
+    @param parts DecimalParts to store the result in
+    @return true if both halves were read
+ */
+static bool scan_decimal(const MaskView *v, const char **p, const char *end, int64 decimal_length,
+                         DecimalParts parts)
+{
+    const char *q = skip_blanks(v, *p, end);
+
+    // The masks give the end of the column, so a plain "digits.digits" column is read in one go
+    const char *token_end = find_class(v, q, end, 0);
+    if (scan_plain_decimal(q, token_end, decimal_length, parts)) {
+        *p = token_end;
+        return true;
+    }
+
+    // Anything else, such as a sign, goes through the general reader
+    if (!scan_int(&q, end, &parts[0]) || q >= end || *q != '.') {
+        return false;
+    }
+    q++;
+    if (!scan_int(&q, end, &parts[1])) {
+        return false;
+    }
+    parts[2] = decimal_length;
+    *p = q;
+    return true;
+}
+
+/**
+    This function converts an "HH:MM:SS" field into seconds.
+    @param field Field holding the time of day
+    @param seconds Total seconds
+    @return true if the field has the expected shape
+ */
+static bool parse_time(Field field, int *seconds)
+{
+    const char *p = field.ptr;
+    const char *end = field.ptr + field.len;
+    int64 h, m, s;
+    if (field.len == 8 && p[2] == ':' && p[5] == ':' && scan_digits(p, 2, &h) && scan_digits(p + 3, 2, &m) &&
+        scan_digits(p + 6, 2, &s)) {
+        *seconds = (int)(h * 3600 + m * 60 + s);
+        return true;
+    }
+    if (!scan_int(&p, end, &h) || p >= end || *p++ != ':' ||
+        !scan_int(&p, end, &m) || p >= end || *p++ != ':' ||
+        !scan_int(&p, end, &s)) {
+        return false;
+    }
+    // Hold the other shapes to the two-digit range of the fast path, so the seconds always fit
+    if (h < 0 || h > 99 || m < 0 || m > 99 || s < 0 || s > 99) {
+        return false;
+    }
+    *seconds = (int)(h * 3600 + m * 60 + s);
+    return true;
+}
+
+/**
+    This function finds the start of the next line.
+    @param p Current position
+    @param end End of the buffer
+    @return The character after the next newline, or end
+ */
+const char *flare_next_line(const char *p, const char *end)
+{
+    const char *nl = memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+/**
+    This function skips a number of lines, such as the header at the top of the flare list.
+    @param p Current position
+    @param end End of the buffer
+    @param count Number of lines to skip
+    @return Start of the line after the skipped ones
+ */
+const char *flare_skip_lines(const char *p, const char *end, int count)
+{
+    for (int i = 0; i < count && p < end; i++) {
+        p = flare_next_line(p, end);
+    }
+    return p;
+}
+
+/**
+    This function classifies the bytes of a single line and calls fn with masks covering it. Lines
+    that fit in a scanner window use masks on the stack; longer ones are given heap masks.
+    @param p Start of the line
+    @param end End of the line
+    @param fn Function to call with the masks
+    @param row Row passed on to fn
+    @return The result of fn
+ */
+static bool with_line_masks(const char *p, const char *end, LineFn fn, FlareRow *row)
+{
+    uint64_t newline[SCAN_WINDOW_BLOCKS], blank[SCAN_WINDOW_BLOCKS];
+    size_t len = (size_t)(end - p);
+    size_t blocks = (len + SCAN_BLOCK - 1) / SCAN_BLOCK;
+    uint64_t *masks = blocks <= SCAN_WINDOW_BLOCKS ? NULL : malloc(2 * blocks * sizeof(uint64_t));
+    if (blocks > SCAN_WINDOW_BLOCKS && masks == NULL) {
+        fprintf(stderr, "Error: out of memory in with_line_masks.\n");
+        exit(EXIT_FAILURE);
+    }
+    MaskView v = {p, masks != NULL ? masks + blocks : blank};
+    scan_range(p, len, masks != NULL ? masks : newline, (uint64_t *)v.blank);
+    bool result = fn(&v, p, end, row);
+    free(masks);
+    return result;
+}
+
+/**
+    This function checks a line covered by masks for anything but whitespace.
+    @param v Masks covering the line
+    @param p Start of the line
+    @param end End of the line
+    @param row Unused
+    @return true if the line is blank
+ */
+static bool blank_line(const MaskView *v, const char *p, const char *end, FlareRow *row)
+{
+    (void)row;
+    return skip_blanks(v, p, end) == end;
+}
+
+/**
+    This function returns the class changes of a block of masks: bit i is set if byte i is a blank
+    and byte i - 1 is not, or the other way round.
+    @param v Masks
+    @param block Index of the block
+    @return The class change bits
+ */
+static inline uint64_t block_edges(const MaskView *v, size_t block)
+{
+    uint64_t carry = block > 0 ? v->blank[block - 1] >> 63 : 0;
+    return v->blank[block] ^ ((v->blank[block] << 1) | carry);
+}
+
+/**
+    This function takes the next class change of a line, where a field starts or stops.
+    @param c Cursor over the class changes
+    @return The position of the change, or the end of the line
+ */
+static inline const char *next_edge(EdgeCursor *c)
+{
+    while (c->edges == 0) {
+        c->block++;
+        if (c->v->base + c->block * SCAN_BLOCK >= c->end) {
+            return c->end;
+        }
+        c->edges = block_edges(c->v, c->block);
+    }
+    const char *q = c->v->base + c->block * SCAN_BLOCK + __builtin_ctzll(c->edges);
+    c->edges &= c->edges - 1;
+    return q < c->end ? q : c->end;
+}
+
+/**
+    This function tokenizes a data line of the usual shape straight from its class changes: the
+    fields start and stop at alternate changes, so each boundary is one count of trailing zeros.
+    A line of any other shape is left to tokenize_row.
+    @param v Masks covering the line
+    @param p Start of the line
+    @param end End of the line
+    @param row Row to fill in
+    @return true if the line was tokenized, false if tokenize_row has to decide
+ */
+static bool tokenize_plain_row(const MaskView *v, const char *p, const char *end, FlareRow *row)
+{
+    if (p >= end) {
+        return false;
+    }
+    size_t i = (size_t)(p - v->base);
+    EdgeCursor c = {v, end, i / SCAN_BLOCK, 0};
+    c.edges = block_edges(v, c.block) & (~1ULL << (i % SCAN_BLOCK));
+
+    // The first field starts at the line start, or at the first change if the line starts blank
+    const char *start = (v->blank[c.block] >> (i % SCAN_BLOCK)) & 1 ? next_edge(&c) : p;
+    Field *fields[] = {&row->flare_id, &row->start_date, &row->start_time, &row->peak_time, &row->end_time};
+    for (int k = 0; k < 5; k++) {
+        const char *stop = next_edge(&c);
+        if (stop == start) {
+            return false;
+        }
+        fields[k]->ptr = start;
+        fields[k]->len = (int)(stop - start);
+        start = next_edge(&c);
+    }
+    const char *stop = next_edge(&c);
+    if (!scan_plain_decimal(start, stop, PEAK_DECIMAL_LENGTH, row->peak)) {
+        return false;
+    }
+    start = next_edge(&c);
+    stop = next_edge(&c);
+    if (stop == end || !scan_plain_decimal(start, stop, AVG_DECIMAL_LENGTH, row->avg)) {
+        return false;
+    }
+
+    // The detectors are everything left on the line after the separating whitespace
+    start = next_edge(&c);
+    if (start == end) {
+        return false;
+    }
+    row->detectors.ptr = start;
+    row->detectors.len = (int)(end - start);
+
+    return parse_time(row->start_time, &row->start_sec) &&
+           parse_time(row->peak_time, &row->peak_sec) &&
+           parse_time(row->end_time, &row->end_sec);
+}
+
+/**
+    This function tokenizes a data line covered by masks. The layout is the flare id, the start
+    date, the start, peak and end times, the peak and average count rate, and the rest of the line
+    as the detectors.
+    @param v Masks covering the line
+    @param p Start of the line
+    @param end End of the line (the newline or the end of the buffer)
+    @param row Row to fill in
+    @return true if every field was found, false on a line format error
+ */
+static bool tokenize_row(const MaskView *v, const char *p, const char *end, FlareRow *row)
+{
+    if (tokenize_plain_row(v, p, end, row)) {
+        return true;
+    }
+
+    // Signs, odd spacing, and malformed lines take the general path, which settles the result
+    if (!scan_token(v, &p, end, &row->flare_id) || !scan_token(v, &p, end, &row->start_date) ||
+        !scan_token(v, &p, end, &row->start_time) || !scan_token(v, &p, end, &row->peak_time) ||
+        !scan_token(v, &p, end, &row->end_time)) {
+        return false;
+    }
+    if (!scan_decimal(v, &p, end, PEAK_DECIMAL_LENGTH, row->peak) ||
+        !scan_decimal(v, &p, end, AVG_DECIMAL_LENGTH, row->avg)) {
+        return false;
+    }
+
+    // The detectors are everything left on the line after the separating whitespace
+    p = skip_blanks(v, p, end);
+    if (p == end) {
+        return false;
+    }
+    row->detectors.ptr = p;
+    row->detectors.len = (int)(end - p);
+
+    return parse_time(row->start_time, &row->start_sec) &&
+           parse_time(row->peak_time, &row->peak_sec) &&
+           parse_time(row->end_time, &row->end_sec);
+}
+
+/**
+    This function checks whether a line only contains whitespace. Such lines carry no row and
+    are skipped silently, as the whitespace in the fscanf format skips them.
+    @param p Start of the line
+    @param end End of the line
+    @return true if the line is blank
+ */
+bool flare_blank_line(const char *p, const char *end)
+{
+    return with_line_masks(p, end, blank_line, NULL);
+}
+
+/**
+    This function tokenizes one data line on its own, classifying just that line.
+    @param p Start of the line
+    @param end End of the line (the newline or the end of the buffer)
+    @param row Row to fill in
+    @return true if every field was found, false on a line format error
+ */
+bool flare_parse_row(const char *p, const char *end, FlareRow *row)
+{
+    return with_line_masks(p, end, tokenize_row, row);
+}
+
+/**
+    This function classifies the window of input that starts at p.
+    @param sc Scanner to refill
+    @param p First byte of the window
+ */
+static void scanner_fill(FlareScanner *sc, const char *p)
+{
+    size_t len = (size_t)(sc->end - p);
+    sc->base = p;
+    sc->len = len < SCAN_WINDOW_BLOCKS * SCAN_BLOCK ? len : SCAN_WINDOW_BLOCKS * SCAN_BLOCK;
+    scan_range(p, sc->len, sc->newline, sc->blank);
+}
+
+/**
+    This function starts scanning the lines of a buffer.
+    @param sc Scanner to start
+    @param p Start of the first line
+    @param end End of the last line
+ */
+void flare_scanner_init(FlareScanner *sc, const char *p, const char *end)
+{
+    sc->pos = p;
+    sc->end = end;
+    sc->base = p;
+    sc->len = 0;
+}
+
+/**
+    This function finds the next line from the newline masks of the window. A line that runs past
+    the window makes the window start again at that line, so every line the scanner returns lies
+    inside the masks unless it is longer than a whole window.
+    @param sc Scanner
+    @param line Set to the start of the line
+    @param line_end Set to the end of the line, excluding its newline
+    @return false once every line has been returned
+ */
+bool flare_scanner_next(FlareScanner *sc, const char **line, const char **line_end)
+{
+    const char *start = sc->pos;
+    if (start >= sc->end) {
+        return false;
+    }
+    while (1) {
+        if (start < sc->base || start >= sc->base + sc->len) {
+            scanner_fill(sc, start);
+        }
+        size_t i = (size_t)(start - sc->base);
+        size_t block = i / SCAN_BLOCK;
+        uint64_t bits = sc->newline[block] & (~0ULL << (i % SCAN_BLOCK));
+        while (bits == 0 && (block + 1) * SCAN_BLOCK < sc->len) {
+            bits = sc->newline[++block];
+        }
+        if (bits != 0) {
+            const char *nl = sc->base + block * SCAN_BLOCK + __builtin_ctzll(bits);
+            *line = start;
+            *line_end = nl;
+            sc->pos = nl + 1;
+            return true;
+        }
+        if (sc->base + sc->len == sc->end || start == sc->base) {
+            // The last line, or one longer than a window, which is found without the masks
+            const char *next = flare_next_line(start, sc->end);
+            *line = start;
+            *line_end = (next > start && next[-1] == '\n') ? next - 1 : next;
+            sc->pos = next;
+            return true;
+        }
+        scanner_fill(sc, start);
+    }
+}
+
+/**
+    This function tokenizes a line returned by flare_scanner_next, using the masks of the window.
+    @param sc Scanner
+    @param line Start of the line
+    @param line_end End of the line
+    @param row Row to fill in
+    @return true if every field was found, false on a line format error
+ */
+bool flare_scanner_row(const FlareScanner *sc, const char *line, const char *line_end, FlareRow *row)
+{
+    if (line < sc->base || line_end > sc->base + sc->len) {
+        return flare_parse_row(line, line_end, row);
+    }
+    MaskView v = {sc->base, sc->blank};
+    return tokenize_row(&v, line, line_end, row);
+}
+
+/**
+    This function checks whether a line returned by flare_scanner_next only contains whitespace.
+    @param sc Scanner
+    @param line Start of the line
+    @param line_end End of the line
+    @return true if the line is blank
+ */
+bool flare_scanner_blank(const FlareScanner *sc, const char *line, const char *line_end)
+{
+    if (line < sc->base || line_end > sc->base + sc->len) {
+        return flare_blank_line(line, line_end);
+    }
+    MaskView v = {sc->base, sc->blank};
+    return skip_blanks(&v, line, line_end) == line_end;
+}
+
+/**
+    This function parses a "D-Mon-YYYY" date. An unknown month abbreviation gives month 0.
+    @param date Field holding the date
+    @param year Parsed year
+    @param month Parsed month (1 - 12)
+    @param day Parsed day of the month
+    @return true if the date has the expected shape
+ */
+bool flare_parse_date(Field date, int *year, int *month, int *day)
+{
+    const char *p = date.ptr;
+    const char *end = date.ptr + date.len;
+    int64 d, y;
+    if (!scan_int(&p, end, &d) || p >= end || *p++ != '-') {
+        return false;
+    }
+    const char *mon = p;
+    if (end - p < 4 || p[3] != '-') {
+        return false;
+    }
+    p += 4;
+    if (!scan_int(&p, end, &y) || p != end) {
+        return false;
+    }
+
+    // Convert the month abbreviation to a number value (1 -12)
+    *month = month_from_abbreviation(mon);
+    *year = (int)y;
+    *day = (int)d;
+    return true;
+}
@@ -0,0 +1,68 @@
+/**
+     @file flare_parse.h
+     This header file defines a hand-written scanner for rows of the Fermi GBM flare list. Rows are
+     tokenized in place: every text field is a view into the caller's buffer, so no field is copied.
+     A FlareScanner classifies the input a window at a time into newline and blank bit masks, and
+     finds both the lines and their fields from those masks.
+ */
+#ifndef FLARE_PARSE_H
+#define FLARE_PARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "fraction.h"
+
+#define MAX_HEADER_LINES 7 // Number of header lines to skip
+#define PEAK_DECIMAL_LENGTH 3 // Digits after the point in the peak column
+#define AVG_DECIMAL_LENGTH 10 // Digits after the point in the average count rate column
+#define SCAN_WINDOW_BLOCKS 64 // 64-byte blocks of input a scanner classifies at a time
+
+typedef struct {
+    const char *ptr; // First character of the field (not NUL-terminated)
+    int len;         // Number of characters in the field
+} Field;
+
+typedef struct {
+    Field flare_id, start_date, start_time, peak_time, end_time, detectors;
+    int start_sec, peak_sec, end_sec; // Times of day converted to seconds
+    DecimalParts peak, avg;           // Peak and average count rate columns
+} FlareRow;
+
+typedef struct {
+    const char *pos;  // Start of the next line
+    const char *end;  // End of the input
+    const char *base; // Start of the classified window
+    size_t len;       // Bytes in the window
+    uint64_t newline[SCAN_WINDOW_BLOCKS]; // Newline mask of each block of the window
+    uint64_t blank[SCAN_WINDOW_BLOCKS];   // Blank mask of each block of the window
+} FlareScanner;
+
+// Return the start of the line after the one beginning at p, or end if p is on the last line
+const char *flare_next_line(const char *p, const char *end);
+
+// Skip count header lines starting at p and return the start of the first data line
+const char *flare_skip_lines(const char *p, const char *end, int count);
+
+// Return true if the line [p, end) only contains whitespace
+bool flare_blank_line(const char *p, const char *end);
+
+// Tokenize one data line [p, end) into row, returning false on a line format error
+bool flare_parse_row(const char *p, const char *end, FlareRow *row);
+
+// Start scanning the lines of [p, end), classifying a window of input at a time
+void flare_scanner_init(FlareScanner *sc, const char *p, const char *end);
+
+// Find the next line as [*line, *line_end) without its newline, returning false at the end of the input
+bool flare_scanner_next(FlareScanner *sc, const char **line, const char **line_end);
+
+// Tokenize a line from flare_scanner_next using the window's masks, as flare_parse_row does
+bool flare_scanner_row(const FlareScanner *sc, const char *line, const char *line_end, FlareRow *row);
+
+// Return true if a line from flare_scanner_next only contains whitespace
+bool flare_scanner_blank(const FlareScanner *sc, const char *line, const char *line_end);
+
+// Parse a "D-Mon-YYYY" date field, returning false if it does not have that shape
+bool flare_parse_date(Field date, int *year, int *month, int *day);
+
+#endif
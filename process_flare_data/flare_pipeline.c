@@ -0,0 +1,363 @@
+/**
+    @file flare_pipeline.c
+    This program processes a flare list as a three-stage pipeline. The reader thread reads the input
+    in blocks that end on a line boundary and tokenizes the rows in place; the transform thread
+    computes each row's date and values; the calling thread formats the rows and writes them. A fixed
+    set of batches circulates through three single-producer, single-consumer rings, so the stages
+    never take a lock, and a slow sink holds the reader back once every batch is waiting on it,
+    which bounds the memory in use.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "flare_parse.h"
+#include "flare_pipeline.h"
+#include "flare_snapshot.h"
+#include "flare_stats.h"
+
+#define SPIN_LIMIT 64 // Polls of a ring with the CPU relaxed before yielding
+#define YIELD_LIMIT 128 // Polls before sleeping between polls
+#define SLEEP_NS 50000 // Sleep between polls of a ring that stays empty or full
+#define CACHE_LINE 64 // Bytes that keep the two ends of a ring apart
+
+typedef struct {
+    char *text;           // Input lines of the batch; rows point into it
+    size_t len;           // Bytes of input in text
+    size_t cap;           // Allocated size of text
+    FlareRow *rows;       // Rows tokenized from text
+    RowValues *values;    // Values computed for each row
+    size_t *date_offsets; // Offset of each row's formatted date in dates
+    int count;            // Number of rows
+    int row_cap;          // Allocated length of rows, values, and date_offsets
+    long long warnings;   // Malformed lines skipped in the batch
+    OutBuffer dates;      // Formatted start dates of the rows
+} PipelineBatch;
+
+typedef struct {
+    PipelineBatch *slots[PIPELINE_BATCHES]; // Batch i is in slot i % PIPELINE_BATCHES
+    size_t head;                            // Batches pushed, written only by the producer
+    char head_pad[CACHE_LINE];
+    size_t tail;                            // Batches popped, written only by the consumer
+    char tail_pad[CACHE_LINE];
+} BatchRing;
+
+typedef struct {
+    InputStream *in;         // Input, decompressed on a thread of its own if it is compressed
+    const RowFormat *format; // Output row format
+    BatchRing free_batches;  // Writer to reader: batches ready to be filled
+    BatchRing parsed;        // Reader to transform: tokenized batches
+    BatchRing computed;      // Transform to writer: batches with their values
+} Pipeline;
+
+/**
+    This function waits a little before a ring is polled again: first by spinning, then by giving
+    up the CPU, and then by sleeping, so a stage that is starved for long does not burn a core.
+    @param polls Number of polls so far, which this function advances
+ */
+static void ring_backoff(int *polls)
+{
+    (*polls)++;
+    if (*polls < SPIN_LIMIT) {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#endif
+    } else if (*polls < YIELD_LIMIT) {
+        sched_yield();
+    } else {
+        struct timespec pause = {0, SLEEP_NS};
+        nanosleep(&pause, NULL);
+    }
+}
+
+/**
+    This function adds a batch to a ring, waiting while it is full. Only one thread may push to a ring.
+    @param r Ring to push to
+    @param b Batch to push, or NULL to mark the end of the input
+ */
+static void ring_push(BatchRing *r, PipelineBatch *b)
+{
+    size_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    int polls = 0;
+    while (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == PIPELINE_BATCHES) {
+        ring_backoff(&polls);
+    }
+    r->slots[head % PIPELINE_BATCHES] = b;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+    This function takes the oldest batch from a ring, waiting while it is empty. Only one thread
+    may pop from a ring.
+    @param r Ring to pop from
+    @return The batch, or NULL at the end of the input
+ */
+static PipelineBatch *ring_pop(BatchRing *r)
+{
+    size_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    int polls = 0;
+    while (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail) {
+        ring_backoff(&polls);
+    }
+    PipelineBatch *b = r->slots[tail % PIPELINE_BATCHES];
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    return b;
+}
+
+/**
+    This function makes sure a batch has room for size bytes of input.
+    @param b Batch to grow
+    @param size Number of bytes needed
+ */
+static void batch_reserve(PipelineBatch *b, size_t size)
+{
+    if (size <= b->cap) {
+        return;
+    }
+    char *text = realloc(b->text, size);
+    if (text == NULL) {
+        fprintf(stderr, "Error: out of memory in batch_reserve.\n");
+        exit(EXIT_FAILURE);
+    }
+    b->text = text;
+    b->cap = size;
+}
+
+/**
+    This function doubles the number of rows a batch can hold.
+    @param b Batch to grow
+ */
+static void batch_grow_rows(PipelineBatch *b)
+{
+    int cap = b->row_cap ? 2 * b->row_cap : PIPELINE_BLOCK / 64;
+    FlareRow *rows = realloc(b->rows, cap * sizeof(FlareRow));
+    RowValues *values = realloc(b->values, cap * sizeof(RowValues));
+    size_t *date_offsets = realloc(b->date_offsets, cap * sizeof(size_t));
+    if (rows == NULL || values == NULL || date_offsets == NULL) {
+        fprintf(stderr, "Error: out of memory in batch_grow_rows.\n");
+        exit(EXIT_FAILURE);
+    }
+    b->rows = rows;
+    b->values = values;
+    b->date_offsets = date_offsets;
+    b->row_cap = cap;
+}
+
+/**
+    This function reads into a batch until it is full or the input ends.
+    @param in Input
+    @param b Batch to read into
+    @return false once the input has ended
+ */
+static bool read_block(InputStream *in, PipelineBatch *b)
+{
+    while (b->len < b->cap) {
+        ssize_t n = input_read(in, b->text + b->len, b->cap - b->len);
+        if (n == 0) {
+            return false;
+        }
+        b->len += (size_t)n;
+        stats_add(COUNT_BYTES_IN, n);
+    }
+    return true;
+}
+
+/**
+    This function tokenizes the data lines in [p, end) into the rows of a batch. Blank lines are
+    skipped silently and malformed lines are counted, as process_lines does.
+    @param b Batch to fill
+    @param p Start of the first line
+    @param end End of the last line
+ */
+static void parse_batch(PipelineBatch *b, const char *p, const char *end)
+{
+    FlareScanner sc;
+    const char *line, *line_end;
+    b->count = 0;
+    b->warnings = 0;
+    flare_scanner_init(&sc, p, end);
+    while (flare_scanner_next(&sc, &line, &line_end)) {
+        if (b->count == b->row_cap) {
+            batch_grow_rows(b);
+        }
+        if (flare_scanner_row(&sc, line, line_end, &b->rows[b->count])) {
+            b->count++;
+        } else if (!flare_scanner_blank(&sc, line, line_end)) {
+            b->warnings++;
+        }
+    }
+}
+
+/**
+    This function is the body of the reader thread. Each batch gets the partial line left over from
+    the one before and a block of input, and its complete lines are tokenized; the partial line at
+    its end waits for the next batch. A line longer than a block makes the batch grow to hold it.
+    @param arg The shared Pipeline
+    @return NULL
+ */
+static void *reader_stage(void *arg)
+{
+    Pipeline *pl = arg;
+    char *carry = NULL;
+    size_t carry_len = 0;
+    int header_lines = 0;
+    bool more = true;
+    bool first = true;
+
+    while (more) {
+        PipelineBatch *b = ring_pop(&pl->free_batches);
+        batch_reserve(b, carry_len + PIPELINE_BLOCK);
+        memcpy(b->text, carry, carry_len);
+        b->len = carry_len;
+
+        // Read until the batch holds a complete line or the input ends
+        const char *last = NULL;
+        while (more && last == NULL) {
+            batch_reserve(b, b->len + PIPELINE_BLOCK);
+            more = read_block(pl->in, b);
+            for (const char *q = b->text + b->len; q > b->text; q--) {
+                if (q[-1] == '\n') {
+                    last = q;
+                    break;
+                }
+            }
+        }
+        if (first && snapshot_detect(b->text, b->len)) {
+            fprintf(stderr, "Error: a snapshot cannot be read with --pipeline or from compressed input.\n");
+            exit(EXIT_FAILURE);
+        }
+        first = false;
+
+        // At the end of the input the last line is complete even without a newline
+        const char *end = more ? last : b->text + b->len;
+        uint64_t t = stats_start();
+        const char *p = b->text;
+        while (header_lines < MAX_HEADER_LINES && p < end) {
+            p = flare_next_line(p, end);
+            header_lines++;
+        }
+        parse_batch(b, p, end);
+        stats_lap(STAGE_PARSE, t);
+        stats_add(COUNT_SKIPPED, b->warnings);
+
+        // Keep the partial line before the batch moves on, since it may come back as the next one
+        carry_len = (size_t)(b->text + b->len - end);
+        if (carry_len > 0) {
+            char *grown = realloc(carry, carry_len);
+            if (grown == NULL) {
+                fprintf(stderr, "Error: out of memory in reader_stage.\n");
+                exit(EXIT_FAILURE);
+            }
+            carry = grown;
+            memcpy(carry, end, carry_len);
+        }
+        ring_push(&pl->parsed, b);
+    }
+    ring_push(&pl->parsed, NULL);
+    free(carry);
+    stats_merge_thread();
+    return NULL;
+}
+
+/**
+    This function is the body of the transform thread. It computes the date and values of every
+    row of each batch. Formatted dates are collected in the batch, and the rows are pointed at them
+    once the batch is done, since the collection may move while it grows.
+    @param arg The shared Pipeline
+    @return NULL
+ */
+static void *transform_stage(void *arg)
+{
+    Pipeline *pl = arg;
+    bool own_dates = pl->format->date.mode != DATE_AS_IS;
+    char formatted_date[DATE_TEXT_MAX];
+    PipelineBatch *b;
+
+    while ((b = ring_pop(&pl->parsed)) != NULL) {
+        b->dates.len = 0;
+        for (int i = 0; i < b->count; i++) {
+            compute_row(&b->rows[i], pl->format, formatted_date, &b->values[i]);
+            if (own_dates) {
+                b->date_offsets[i] = b->dates.len;
+                out_write(&b->dates, formatted_date, b->values[i].date_len);
+            }
+        }
+        if (own_dates) {
+            for (int i = 0; i < b->count; i++) {
+                b->values[i].date_text = b->dates.data + b->date_offsets[i];
+            }
+        }
+        ring_push(&pl->computed, b);
+    }
+    ring_push(&pl->computed, NULL);
+    stats_merge_thread();
+    return NULL;
+}
+
+/**
+    This function processes a flare list on three threads. The reader and transform stages run on
+    threads of their own, and the calling thread formats and writes the rows in input order,
+    reporting the malformed lines of each batch after its rows.
+    @param in Input, read to its end
+    @param format Output row format
+    @param sink Stream the output is written to
+    @param counts Counts to add the rows and malformed lines to
+ */
+void process_pipelined(InputStream *in, const RowFormat *format, FILE *sink, ProcessCounts *counts)
+{
+    Pipeline pl;
+    memset(&pl, 0, sizeof(pl));
+    pl.in = in;
+    pl.format = format;
+
+    PipelineBatch *batches = calloc(PIPELINE_BATCHES, sizeof(PipelineBatch));
+    if (batches == NULL) {
+        fprintf(stderr, "Error: out of memory in process_pipelined.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < PIPELINE_BATCHES; i++) {
+        out_init(&batches[i].dates, NULL);
+        ring_push(&pl.free_batches, &batches[i]);
+    }
+
+    pthread_t reader, transform;
+    if (pthread_create(&reader, NULL, reader_stage, &pl) != 0 ||
+        pthread_create(&transform, NULL, transform_stage, &pl) != 0) {
+        fprintf(stderr, "Error: cannot create pipeline thread.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Format and write each batch, then hand it back to the reader
+    OutBuffer out;
+    out_init(&out, sink);
+    PipelineBatch *b;
+    while ((b = ring_pop(&pl.computed)) != NULL) {
+        for (int i = 0; i < b->count; i++) {
+            emit_row_values(&b->rows[i], &b->values[i], format, &out);
+            row_values_free(&b->values[i]);
+        }
+        for (long long i = 0; i < b->warnings; i++) {
+            fprintf(stderr, "Warning: line format error, skipping line.\n");
+        }
+        counts->rows += b->count;
+        counts->warnings += b->warnings;
+        stats_add(COUNT_ROWS, b->count);
+        ring_push(&pl.free_batches, b);
+    }
+    out_flush(&out);
+    out_free(&out);
+
+    pthread_join(reader, NULL);
+    pthread_join(transform, NULL);
+    for (int i = 0; i < PIPELINE_BATCHES; i++) {
+        free(batches[i].text);
+        free(batches[i].rows);
+        free(batches[i].values);
+        free(batches[i].date_offsets);
+        out_free(&batches[i].dates);
+    }
+    free(batches);
+}
@@ -0,0 +1,21 @@
+/**
+     @file flare_pipeline.h
+     This header file defines pipelined processing of a flare list read from an input stream. A
+     reader, a transform, and a writer stage run on their own threads and pass fixed batches of rows
+     through bounded single-producer, single-consumer rings, so reading, computing, and writing overlap.
+ */
+#ifndef FLARE_PIPELINE_H
+#define FLARE_PIPELINE_H
+
+#include <stdio.h>
+#include "flare_format.h"
+#include "flare_process.h"
+#include "input_stream.h"
+
+#define PIPELINE_BATCHES 8 // Batches circulating between the stages (a power of two)
+#define PIPELINE_BLOCK (1 << 18) // Input bytes read into a batch at a time
+
+// Process the flare list read from in and write the output to sink, using a thread per stage
+void process_pipelined(InputStream *in, const RowFormat *format, FILE *sink, ProcessCounts *counts);
+
+#endif
@@ -0,0 +1,339 @@
+/**
+    @file flare_process.c
+    This program processes the data lines of a flare list held in memory. The parallel path cuts the
+    input into chunks at line boundaries, lets worker threads parse and format the chunks on their
+    own, and writes the finished chunks in their original order, so the output matches the serial path.
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "flare_format.h"
+#include "flare_parse.h"
+#include "flare_process.h"
+#include "flare_stats.h"
+#include "flare_table.h"
+#include "fraction_batch.h"
+
+#define TABLE_BLOCK 256 // Table records whose fractions are computed together
+
+typedef struct {
+    uint32_t records[TABLE_BLOCK];                 // Index of each record in the table
+    int64 peak_int[TABLE_BLOCK], peak_dec[TABLE_BLOCK]; // Peak column of each record
+    int64 avg_int[TABLE_BLOCK], avg_dec[TABLE_BLOCK];   // Average count rate column of each record
+    int64 duration[TABLE_BLOCK], one[TABLE_BLOCK];      // Duration of each record as a fraction
+    int64 peak_num[TABLE_BLOCK], peak_den[TABLE_BLOCK]; // Fractions computed from the columns
+    int64 avg_num[TABLE_BLOCK], avg_den[TABLE_BLOCK];
+    int64 total_num[TABLE_BLOCK], total_den[TABLE_BLOCK];
+    unsigned char status[TABLE_BLOCK];             // Batch status flags of each record
+} TableBlock;
+
+typedef struct {
+    OutBuffer out;        // Formatted output of the chunk
+    ProcessCounts counts; // Rows and malformed lines in the chunk
+    bool ready;           // Set once a worker has finished the chunk
+} ChunkSlot;
+
+typedef struct {
+    const char *pos;         // Start of the input not yet handed to a worker
+    const char *end;         // End of the input
+    const RowFormat *format; // Output row format
+    int next_chunk;          // Index of the next chunk to hand out
+    int written;             // Number of chunks written so far
+    int total_chunks;        // Number of chunks, or -1 while input is left
+    int window;              // Number of chunk slots
+    ChunkSlot *slots;        // Chunk i uses slot i % window
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} ChunkQueue;
+
+/**
+    This function processes a run of data lines. Blank lines are skipped silently, and lines that
+    do not tokenize are skipped with a warning.
+    @param p Start of the first line
+    @param end End of the last line
+    @param format Output row format
+    @param out Buffer the formatted rows are appended to
+    @param warn Stream for warnings, or NULL to only count them
+    @param counts Counts to add the rows and malformed lines to
+ */
+void process_lines(const char *p, const char *end, const RowFormat *format, OutBuffer *out, FILE *warn,
+                   ProcessCounts *counts)
+{
+    FlareRow row;
+    FlareScanner sc;
+    long long rows = counts->rows, warnings = counts->warnings;
+    const char *line, *line_end;
+
+    flare_scanner_init(&sc, p, end);
+    while (1) {
+        // Find the next line, excluding the newline, and its fields from the scanner's masks
+        uint64_t t = stats_start();
+        if (!flare_scanner_next(&sc, &line, &line_end)) {
+            break;
+        }
+        bool parsed = flare_scanner_row(&sc, line, line_end, &row);
+        stats_lap(STAGE_PARSE, t);
+
+        if (parsed) {
+            emit_row(&row, format, out);
+            counts->rows++;
+        } else if (!flare_scanner_blank(&sc, line, line_end)) {
+            if (warn != NULL) {
+                fprintf(warn, "Warning: line format error, skipping line.\n");
+            }
+            counts->warnings++;
+        }
+    }
+    stats_add(COUNT_ROWS, counts->rows - rows);
+    stats_add(COUNT_SKIPPED, counts->warnings - warnings);
+}
+
+/**
+    This function is the body of a worker thread. It repeatedly claims the next chunk of input,
+    waiting while the writer is a full window behind, and formats the chunk into its slot.
+    @param arg The shared ChunkQueue
+    @return NULL
+ */
+static void *chunk_worker(void *arg)
+{
+    ChunkQueue *q = arg;
+
+    while (1) {
+        pthread_mutex_lock(&q->lock);
+        while (q->pos < q->end && q->next_chunk >= q->written + q->window) {
+            pthread_cond_wait(&q->changed, &q->lock);
+        }
+        if (q->pos == q->end) {
+            pthread_mutex_unlock(&q->lock);
+            break;
+        }
+
+        // Claim the next chunk, extended to the end of the line it stops in
+        int index = q->next_chunk++;
+        const char *begin = q->pos;
+        const char *stop = (q->end - begin > CHUNK_BYTES) ? flare_next_line(begin + CHUNK_BYTES, q->end) : q->end;
+        q->pos = stop;
+        if (stop == q->end) {
+            q->total_chunks = q->next_chunk;
+        }
+        ChunkSlot *slot = &q->slots[index % q->window];
+        pthread_mutex_unlock(&q->lock);
+
+        slot->out.len = 0;
+        slot->counts.rows = 0;
+        slot->counts.warnings = 0;
+        process_lines(begin, stop, q->format, &slot->out, NULL, &slot->counts);
+
+        pthread_mutex_lock(&q->lock);
+        slot->ready = true;
+        pthread_cond_broadcast(&q->changed);
+        pthread_mutex_unlock(&q->lock);
+    }
+    stats_merge_thread();
+    return NULL;
+}
+
+/**
+    This function processes data lines on several worker threads. The calling thread writes the
+    chunks in order as they complete; workers stay at most a fixed window of chunks ahead of it,
+    which bounds the memory held by finished output.
+    @param p Start of the first line
+    @param end End of the last line
+    @param format Output row format
+    @param threads Number of worker threads
+    @param sink Stream the output is written to
+    @param counts Counts to add the rows and malformed lines to
+ */
+void process_lines_parallel(const char *p, const char *end, const RowFormat *format, int threads, FILE *sink,
+                            ProcessCounts *counts)
+{
+    ChunkQueue q;
+    q.pos = p;
+    q.end = end;
+    q.format = format;
+    q.next_chunk = 0;
+    q.written = 0;
+    q.total_chunks = (p == end) ? 0 : -1;
+    q.window = 2 * threads;
+    q.slots = malloc(q.window * sizeof(ChunkSlot));
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    if (q.slots == NULL || workers == NULL) {
+        fprintf(stderr, "Error: out of memory in process_lines_parallel.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < q.window; i++) {
+        out_init(&q.slots[i].out, NULL);
+        q.slots[i].ready = false;
+    }
+    pthread_mutex_init(&q.lock, NULL);
+    pthread_cond_init(&q.changed, NULL);
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, chunk_worker, &q) != 0) {
+            fprintf(stderr, "Error: cannot create worker thread.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Write the chunks in input order as they become ready
+    pthread_mutex_lock(&q.lock);
+    while (q.total_chunks < 0 || q.written < q.total_chunks) {
+        ChunkSlot *slot = &q.slots[q.written % q.window];
+        if (!slot->ready) {
+            pthread_cond_wait(&q.changed, &q.lock);
+            continue;
+        }
+        pthread_mutex_unlock(&q.lock);
+
+        write_all(sink, slot->out.data, slot->out.len);
+        for (long long i = 0; i < slot->counts.warnings; i++) {
+            fprintf(stderr, "Warning: line format error, skipping line.\n");
+        }
+        counts->rows += slot->counts.rows;
+        counts->warnings += slot->counts.warnings;
+
+        pthread_mutex_lock(&q.lock);
+        slot->ready = false;
+        q.written++;
+        pthread_cond_broadcast(&q.changed);
+    }
+    pthread_mutex_unlock(&q.lock);
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    for (int i = 0; i < q.window; i++) {
+        out_free(&q.slots[i].out);
+    }
+    pthread_mutex_destroy(&q.lock);
+    pthread_cond_destroy(&q.changed);
+    free(workers);
+    free(q.slots);
+}
+
+/**
+    This function computes the fractions of a block of table records with the batch fraction
+    functions, one column at a time, and then formats the records. A record whose fractions could
+    not be computed in 64 bits is formatted by emit_row, which handles it as the row path does.
+    @param t Table to format
+    @param b Block holding the indexes of the records, with room for their columns
+    @param n Number of records in the block (at most TABLE_BLOCK)
+    @param format Output row format
+    @param out Buffer the formatted rows are appended to
+ */
+static void process_table_block(const FlareTable *t, TableBlock *b, size_t n, const RowFormat *format,
+                                OutBuffer *out)
+{
+    FlareRow row;
+    RowText text;
+
+    // Decimal output reduces nothing, so the fraction columns are not computed
+    if (format->decimal) {
+        for (size_t k = 0; k < n; k++) {
+            uint64_t start = stats_start();
+            table_row(t, b->records[k], &row, &text);
+            stats_lap(STAGE_PARSE, start);
+            emit_row(&row, format, out);
+        }
+        return;
+    }
+
+    // Gather the columns of the block
+    uint64_t start = stats_start();
+    for (size_t k = 0; k < n; k++) {
+        uint32_t i = b->records[k];
+        b->peak_int[k] = t->peak_int[i];
+        b->peak_dec[k] = t->peak_dec[i];
+        b->avg_int[k] = t->avg_int[i];
+        b->avg_dec[k] = t->avg_dec[i];
+        int d = t->end_sec[i] - t->start_sec[i];
+        b->duration[k] = d < 0 ? d + SECOND_PER_DAY : d;
+        b->one[k] = 1;
+        b->status[k] = FRACTION_OK;
+    }
+
+    // Compute every fraction of the block unreduced, then reduce each column in its own pass
+    decimal_fractions(b->peak_int, b->peak_dec, PEAK_DECIMAL_LENGTH, b->peak_num, b->peak_den, b->status, n);
+    decimal_fractions(b->avg_int, b->avg_dec, AVG_DECIMAL_LENGTH, b->avg_num, b->avg_den, b->status, n);
+    multiply_fractions(b->avg_num, b->avg_den, b->duration, b->one, b->total_num, b->total_den, b->status, n);
+    simplify_fractions(b->peak_num, b->peak_den, b->status, n);
+    simplify_fractions(b->avg_num, b->avg_den, b->status, n);
+    simplify_fractions(b->total_num, b->total_den, b->status, n);
+    stats_lap(STAGE_FRACTION, start);
+
+    for (size_t k = 0; k < n; k++) {
+        start = stats_start();
+        table_row(t, b->records[k], &row, &text);
+        stats_lap(STAGE_PARSE, start);
+        if (b->status[k] != FRACTION_OK) {
+            emit_row(&row, format, out);
+            continue;
+        }
+        Fraction peak_frac = {b->peak_num[k], b->peak_den[k]};
+        Fraction avg_count_rate_frac = {b->avg_num[k], b->avg_den[k]};
+        Fraction total_count_frac = {b->total_num[k], b->total_den[k]};
+        emit_row_fractions(&row, peak_frac, avg_count_rate_frac, total_count_frac, format, out);
+    }
+}
+
+/**
+    This function formats the records of a table, such as one mapped from a snapshot, in table order.
+    Selected records are collected into blocks so their fractions can be computed a column at a time.
+    @param t Table to format
+    @param selected Bitmap with a bit set for each record to format, or NULL to format all of them
+    @param format Output row format
+    @param out Buffer the formatted rows are appended to
+    @param counts Counts to add the rows to
+ */
+void process_table(const FlareTable *t, const uint64_t *selected, const RowFormat *format, OutBuffer *out,
+                   ProcessCounts *counts)
+{
+    process_table_range(t, selected, 0, UINT32_MAX, format, out, counts);
+}
+
+/**
+    This function formats the selected records of a table from a given record on, stopping after a
+    number of rows, so a long output can be produced in pieces.
+    @param t Table to format
+    @param selected Bitmap with a bit set for each record to format, or NULL to format all of them
+    @param first First record to consider
+    @param max_rows Most rows to format
+    @param format Output row format
+    @param out Buffer the formatted rows are appended to
+    @param counts Counts to add the rows to
+    @return The record to continue from, or t->count once every selected record is formatted
+ */
+uint32_t process_table_range(const FlareTable *t, const uint64_t *selected, uint32_t first, uint32_t max_rows,
+                             const RowFormat *format, OutBuffer *out, ProcessCounts *counts)
+{
+    TableBlock block;
+    size_t n = 0;
+    long long rows = counts->rows;
+
+    uint32_t i = first;
+    for (; i < t->count && counts->rows - rows < max_rows; i++) {
+        if (selected != NULL) {
+            // Jump to the next selected record, skipping empty words whole
+            uint64_t bits = selected[i / 64] >> (i % 64);
+            while (bits == 0 && (i = (i / 64 + 1) * 64) < t->count) {
+                bits = selected[i / 64];
+            }
+            if (bits == 0) {
+                i = t->count;
+                break;
+            }
+            i += __builtin_ctzll(bits);
+        }
+        block.records[n++] = i;
+        if (n == TABLE_BLOCK) {
+            process_table_block(t, &block, n, format, out);
+            n = 0;
+        }
+        counts->rows++;
+    }
+    if (n > 0) {
+        process_table_block(t, &block, n, format, out);
+    }
+    stats_add(COUNT_ROWS, counts->rows - rows);
+    return i;
+}
@@ -0,0 +1,39 @@
+/**
+     @file flare_process.h
+     This header file defines the functions that process the data lines of an in-memory flare list,
+     either on the calling thread or split into chunks across worker threads.
+ */
+#ifndef FLARE_PROCESS_H
+#define FLARE_PROCESS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "flare_format.h"
+#include "out_buffer.h"
+
+typedef struct FlareTable FlareTable;
+
+#define CHUNK_BYTES (1 << 20) // Input bytes handed to a worker at a time
+
+typedef struct {
+    long long rows;     // Rows formatted
+    long long warnings; // Malformed lines skipped
+} ProcessCounts;
+
+// Process the data lines in [p, end) into out, reporting malformed lines to warn (or only counting them if NULL)
+void process_lines(const char *p, const char *end, const RowFormat *format, OutBuffer *out, FILE *warn,
+                   ProcessCounts *counts);
+
+// Process [p, end) on threads workers and write the output to sink in input order
+void process_lines_parallel(const char *p, const char *end, const RowFormat *format, int threads, FILE *sink,
+                            ProcessCounts *counts);
+
+// Format the records of a table selected by a row bitmap (NULL for all) into out
+void process_table(const FlareTable *t, const uint64_t *selected, const RowFormat *format, OutBuffer *out,
+                   ProcessCounts *counts);
+
+// Format up to max_rows selected records from record first on into out, returning the record to continue from
+uint32_t process_table_range(const FlareTable *t, const uint64_t *selected, uint32_t first, uint32_t max_rows,
+                             const RowFormat *format, OutBuffer *out, ProcessCounts *counts);
+
+#endif
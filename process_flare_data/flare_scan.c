@@ -0,0 +1,201 @@
+/**
+    @file flare_scan.c
+    This program provides the block classifiers of the flare list scanner. Blanks are the
+    characters isspace() accepts in the C locale other than the newline: ' ' and '\t' through '\r'
+    without '\n'. Each vector kernel tests a whole register of bytes against both classes and packs
+    the results into bit masks with a byte movemask. The kernel is chosen on the first call, from
+    what the CPU reports, and the choice replaces the resolver so later calls go straight to it.
+ */
+#include <stdbool.h>
+#include <string.h>
+#include "flare_scan.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+static void resolve_kernel(const char *p, size_t blocks, uint64_t *newline, uint64_t *blank);
+
+// Kernel in use; starts as the resolver, which replaces itself on the first call
+static ScanKernel active_kernel = resolve_kernel;
+
+/**
+    This function classifies blocks one byte at a time.
+    @param p Blocks to classify
+    @param blocks Number of blocks
+    @param newline Newline mask of each block
+    @param blank Blank mask of each block
+ */
+static void scan_scalar(const char *p, size_t blocks, uint64_t *newline, uint64_t *blank)
+{
+    for (size_t b = 0; b < blocks; b++, p += SCAN_BLOCK) {
+        uint64_t nl = 0, bl = 0;
+        for (int i = 0; i < SCAN_BLOCK; i++) {
+            unsigned char c = (unsigned char)p[i];
+            nl |= (uint64_t)(c == '\n') << i;
+            bl |= (uint64_t)(c == ' ' || (c >= '\t' && c <= '\r' && c != '\n')) << i;
+        }
+        newline[b] = nl;
+        blank[b] = bl;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+    This function classifies blocks sixteen bytes at a time with SSE2. A byte is in '\t' - '\r'
+    when its distance above '\t', taken as unsigned, is at most 4.
+    @param p Blocks to classify
+    @param blocks Number of blocks
+    @param newline Newline mask of each block
+    @param blank Blank mask of each block
+ */
+__attribute__((target("sse2"))) static void scan_sse2(const char *p, size_t blocks, uint64_t *newline,
+                                                      uint64_t *blank)
+{
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i span = _mm_set1_epi8('\r' - '\t');
+    for (size_t b = 0; b < blocks; b++, p += SCAN_BLOCK) {
+        uint64_t nl_bits = 0, blank_bits = 0;
+        for (int i = 0; i < SCAN_BLOCK; i += 16) {
+            __m128i c = _mm_loadu_si128((const __m128i *)(p + i));
+            __m128i is_nl = _mm_cmpeq_epi8(c, nl);
+            __m128i offset = _mm_sub_epi8(c, tab);
+            __m128i in_range = _mm_cmpeq_epi8(_mm_min_epu8(offset, span), offset);
+            __m128i is_blank = _mm_andnot_si128(is_nl, _mm_or_si128(in_range, _mm_cmpeq_epi8(c, space)));
+            nl_bits |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_nl) << i;
+            blank_bits |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_blank) << i;
+        }
+        newline[b] = nl_bits;
+        blank[b] = blank_bits;
+    }
+}
+
+/**
+    This function classifies blocks thirty-two bytes at a time with AVX2, in the same way as the
+    SSE2 kernel.
+    @param p Blocks to classify
+    @param blocks Number of blocks
+    @param newline Newline mask of each block
+    @param blank Blank mask of each block
+ */
+__attribute__((target("avx2"))) static void scan_avx2(const char *p, size_t blocks, uint64_t *newline,
+                                                      uint64_t *blank)
+{
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i span = _mm256_set1_epi8('\r' - '\t');
+    for (size_t b = 0; b < blocks; b++, p += SCAN_BLOCK) {
+        uint64_t nl_bits = 0, blank_bits = 0;
+        for (int i = 0; i < SCAN_BLOCK; i += 32) {
+            __m256i c = _mm256_loadu_si256((const __m256i *)(p + i));
+            __m256i is_nl = _mm256_cmpeq_epi8(c, nl);
+            __m256i offset = _mm256_sub_epi8(c, tab);
+            __m256i in_range = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, span), offset);
+            __m256i is_blank = _mm256_andnot_si256(is_nl, _mm256_or_si256(in_range, _mm256_cmpeq_epi8(c, space)));
+            nl_bits |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_nl) << i;
+            blank_bits |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_blank) << i;
+        }
+        newline[b] = nl_bits;
+        blank[b] = blank_bits;
+    }
+}
+#endif
+
+/**
+    This function returns the kernel with the given name if the CPU can run it.
+    @param name Name of the kernel
+    @return The kernel, or NULL
+ */
+ScanKernel scan_kernel_named(const char *name)
+{
+    if (strcmp(name, "scalar") == 0) {
+        return scan_scalar;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        return scan_sse2;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        return scan_avx2;
+    }
+#endif
+    return NULL;
+}
+
+/**
+    This function picks the widest kernel the CPU supports, installs it, and classifies the blocks.
+    Threads that race here all install the same kernel.
+    @param p Blocks to classify
+    @param blocks Number of blocks
+    @param newline Newline mask of each block
+    @param blank Blank mask of each block
+ */
+static void resolve_kernel(const char *p, size_t blocks, uint64_t *newline, uint64_t *blank)
+{
+    ScanKernel kernel = scan_kernel_named("avx2");
+    if (kernel == NULL) {
+        kernel = scan_kernel_named("sse2");
+    }
+    if (kernel == NULL) {
+        kernel = scan_scalar;
+    }
+    __atomic_store_n(&active_kernel, kernel, __ATOMIC_RELAXED);
+    kernel(p, blocks, newline, blank);
+}
+
+/**
+    This function classifies a range of bytes. The whole blocks are classified in place; the bytes
+    of a last partial block are copied into a zeroed block first, so the kernel never reads past
+    the range, and a NUL is neither a newline nor a blank.
+    @param p Bytes to classify
+    @param n Number of bytes
+    @param newline Newline mask of each block
+    @param blank Blank mask of each block
+ */
+void scan_range(const char *p, size_t n, uint64_t *newline, uint64_t *blank)
+{
+    ScanKernel kernel = __atomic_load_n(&active_kernel, __ATOMIC_RELAXED);
+    size_t blocks = n / SCAN_BLOCK;
+    if (blocks > 0) {
+        kernel(p, blocks, newline, blank);
+    }
+    size_t rest = n % SCAN_BLOCK;
+    if (rest > 0) {
+        char tail[SCAN_BLOCK] = {0};
+        memcpy(tail, p + blocks * SCAN_BLOCK, rest);
+        kernel(tail, 1, newline + blocks, blank + blocks);
+    }
+}
+
+/**
+    This function replaces the kernel in use.
+    @param kernel Kernel to use from now on
+ */
+void scan_use_kernel(ScanKernel kernel)
+{
+    __atomic_store_n(&active_kernel, kernel, __ATOMIC_RELAXED);
+}
+
+/**
+    This function names the kernel in use, choosing one first if none has been chosen yet.
+    @return "scalar", "sse2", or "avx2"
+ */
+const char *scan_kernel_name(void)
+{
+    uint64_t newline, blank;
+    char block[SCAN_BLOCK] = {0};
+    __atomic_load_n(&active_kernel, __ATOMIC_RELAXED)(block, 1, &newline, &blank);
+    ScanKernel kernel = __atomic_load_n(&active_kernel, __ATOMIC_RELAXED);
+#if defined(__x86_64__) || defined(__i386__)
+    if (kernel == scan_avx2) {
+        return "avx2";
+    }
+    if (kernel == scan_sse2) {
+        return "sse2";
+    }
+#endif
+    return "scalar";
+}
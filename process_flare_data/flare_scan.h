@@ -0,0 +1,32 @@
+/**
+     @file flare_scan.h
+     This header file defines the block classifier the flare list scanner is built on. A kernel
+     turns each 64-byte block into one bit per byte for the newlines and one for the blanks that
+     separate fields, so lines and fields are found by counting zero bits rather than by testing
+     characters one at a time. SSE2 and AVX2 kernels are chosen at run time when the CPU has them;
+     the scalar kernel gives the same masks everywhere else.
+ */
+#ifndef FLARE_SCAN_H
+#define FLARE_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCAN_BLOCK 64 // Bytes described by one mask
+
+// Classify blocks * SCAN_BLOCK bytes at p into one newline and one blank mask per block
+typedef void (*ScanKernel)(const char *p, size_t blocks, uint64_t *newline, uint64_t *blank);
+
+// Classify the n bytes at p into (n + SCAN_BLOCK - 1) / SCAN_BLOCK masks of each kind, reading only those bytes
+void scan_range(const char *p, size_t n, uint64_t *newline, uint64_t *blank);
+
+// Return the kernel with the given name ("scalar", "sse2", "avx2"), or NULL if this CPU lacks it
+ScanKernel scan_kernel_named(const char *name);
+
+// Use kernel for every later scan, in place of the one chosen for this CPU
+void scan_use_kernel(ScanKernel kernel);
+
+// Return the name of the kernel in use
+const char *scan_kernel_name(void);
+
+#endif
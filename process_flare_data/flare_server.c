@@ -0,0 +1,1013 @@
+/**
+    @file flare_server.c
+    This program serves flare lists to local clients. Every list is read once into a table with its
+    indexes, so a request only runs an index query and formats the matching rows, with no file
+    access or parsing; an aggregate request sums the records of the tables by period the same way.
+    A single thread multiplexes the listening socket, the clients, and change
+    notifications with poll; clients are non-blocking, and a reply that does not fit the socket is
+    sent as the client drains it, so a slow client does not hold up the others. Rows are formatted
+    SERVER_PIECE_ROWS at a time as the reply drains, so a large reply never sits whole in memory.
+
+    A list is loaded again when inotify reports a write or rename in its directory, or when a
+    periodic check finds its size, modification time, or inode changed. The reload reads and indexes
+    the file on a thread of its own and hands the result back through a pipe; the serving thread then
+    swaps it in between requests, so requests never wait for a reload and never see half of one.
+    Lists are read into memory rather than mapped, so a file rewritten in place cannot fault a request.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "flare_aggregate.h"
+#include "flare_index.h"
+#include "flare_parse.h"
+#include "flare_process.h"
+#include "flare_server.h"
+#include "flare_snapshot.h"
+#include "flare_stats.h"
+#include "flare_table.h"
+#include "input_stream.h"
+#include "out_buffer.h"
+
+#define MAX_DATE_FORMAT 32 // Maximum length for date format string, as on the command line
+#define MAX_WORDS 16       // Most words in a request
+
+typedef struct {
+    dev_t dev;             // Device of the file
+    ino_t ino;             // Inode of the file, which changes when a new file is renamed over it
+    off_t size;            // Size of the file
+    struct timespec mtime; // Last modification of the file
+} FileVersion;
+
+typedef struct {
+    char *data;           // Contents of a snapshot, which its table points into; NULL for text
+    FlareTable table;     // Records of the list
+    FlareIndex index;     // Indexes over the records
+    ProcessCounts counts; // Rows loaded and malformed lines skipped
+    int streams;          // Replies still formatting rows from this version
+    bool retired;         // Set once a newer version is served, to release this one after its last reply
+} LoadedList;
+
+typedef struct {
+    const char *path;         // File name as given
+    LoadedList *current;      // Version being served
+    FileVersion version;      // Version of the file current was loaded from
+    int loads;                // Times the list has been loaded
+    uint64_t *selected;       // Rows matching the current request
+    size_t selected_words;    // Allocated words of selected
+    bool reloading;           // Set while a reload thread runs for the list
+    pthread_t thread;         // Reload thread
+    LoadedList *next;         // Version loaded by the reload thread, or NULL if it failed
+    FileVersion next_version; // Version of the file next was loaded from
+    int index;                // Position of the list, sent back by the reload thread
+    int done_fd;              // Pipe the reload thread writes index to when it finishes
+} ServedList;
+
+typedef struct {
+    int list;             // Index of the only list to use, or -1 for all of them
+    bool use_query;       // Set if any condition is given
+    FlareQuery query;     // Conditions rows must meet
+    RowFormat format;     // Output row format
+    bool has_date_format; // Set if --date-format is given
+} Request;
+
+typedef struct {
+    Request request;     // Request whose rows are sent
+    LoadedList **lists;  // Version of each list the rows come from, held until the reply is done
+    uint64_t **selected; // Rows of each list to send, or NULL entries where every row is sent
+    int count;           // Number of lists
+    int list;            // List being formatted
+    uint32_t next;       // Record of that list to continue from
+} RowStream;
+
+typedef struct {
+    int fd;                       // Connected socket
+    char in[SERVER_MAX_REQUEST];  // Received bytes not yet answered
+    size_t in_len;                // Bytes in in
+    OutBuffer out;                // Reply being sent
+    RowStream *stream;            // Rows of the reply not formatted yet, or NULL
+    size_t sent;                  // Bytes of out already sent
+    bool eof;                     // Set once the client has stopped sending
+    bool closing;                 // Set to close the connection once the reply is sent
+} Client;
+
+typedef struct {
+    char spec[MAX_DATE_FORMAT]; // --date-format argument
+    DateFormat date;            // Its compiled form
+} CachedFormat;
+
+typedef struct {
+    ServedList *lists;                     // Lists in the order given
+    int count;                             // Number of lists
+    Client **clients;                      // Connected clients
+    int client_count;                      // Number of clients
+    int client_cap;                        // Allocated entries of clients
+    CachedFormat formats[SERVER_FORMATS];  // Date formats compiled for earlier requests
+    int format_count;                      // Entries of formats in use
+    int format_next;                       // Entry of formats replaced next once it is full
+} Server;
+
+static volatile sig_atomic_t stop_requested; // Set by SIGINT and SIGTERM
+
+/**
+    This function records that the server has been asked to stop.
+    @param sig Signal received
+ */
+static void request_stop(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+}
+
+/**
+    This function allocates zeroed memory, exiting if it runs out.
+    @param size Number of bytes
+    @return The memory
+ */
+static void *checked_calloc(size_t size)
+{
+    void *p = calloc(1, size > 0 ? size : 1);
+    if (p == NULL) {
+        fprintf(stderr, "Error: out of memory in flare_server.\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/**
+    This function returns a monotonic timestamp.
+    @return Current time in milliseconds
+ */
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/**
+    This function reads the version of a file.
+    @param path File name
+    @param v Version to fill in
+    @return false if the file cannot be found or is not a regular file
+ */
+static bool file_version(const char *path, FileVersion *v)
+{
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    v->dev = st.st_dev;
+    v->ino = st.st_ino;
+    v->size = st.st_size;
+    v->mtime = st.st_mtim;
+    return true;
+}
+
+/**
+    This function compares two versions of a file.
+    @param a First version
+    @param b Second version
+    @return true if they are the same
+ */
+static bool same_version(const FileVersion *a, const FileVersion *b)
+{
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size && a->mtime.tv_sec == b->mtime.tv_sec &&
+           a->mtime.tv_nsec == b->mtime.tv_nsec;
+}
+
+/**
+    This function releases a loaded list.
+    @param l List to release, or NULL
+ */
+static void free_list(LoadedList *l)
+{
+    if (l == NULL) {
+        return;
+    }
+    index_free(&l->index);
+    table_free(&l->table);
+    free(l->data);
+    free(l);
+}
+
+/**
+    This function stops serving a version of a list. It is released at once unless replies are still
+    formatting rows from it, in which case the last of them releases it.
+    @param l Version to retire
+ */
+static void retire_list(LoadedList *l)
+{
+    if (l->streams == 0) {
+        free_list(l);
+    } else {
+        l->retired = true;
+    }
+}
+
+/**
+    This function reads a flare list or snapshot, decompressing it if needed, and indexes it. The
+    version is read before the contents, so a change made during the load is seen by the next check.
+    @param path File name
+    @param version Set to the version of the file loaded
+    @return The list, or NULL if it cannot be read or is a damaged snapshot
+ */
+static LoadedList *load_list(const char *path, FileVersion *version)
+{
+    if (!file_version(path, version)) {
+        return NULL;
+    }
+    InputStream *in = input_open(path);
+    if (in == NULL) {
+        return NULL;
+    }
+    size_t size;
+    char *data = input_read_all(in, &size);
+    input_close(in);
+
+    LoadedList *l = checked_calloc(sizeof(LoadedList));
+    if (snapshot_detect(data, size)) {
+        if (!snapshot_open(data, size, &l->table)) {
+            free(data);
+            free(l);
+            return NULL;
+        }
+        l->data = data;
+        l->counts.rows = l->table.count;
+    } else {
+        const char *end = data + size;
+        table_init(&l->table);
+        table_load_lines(&l->table, flare_skip_lines(data, end, MAX_HEADER_LINES), end, stderr, &l->counts);
+        free(data);
+    }
+    index_build(&l->index, &l->table);
+    return l;
+}
+
+/**
+    This function is the body of a reload thread. It loads the list and tells the serving thread.
+    @param arg The ServedList to load
+    @return NULL
+ */
+static void *reload_thread(void *arg)
+{
+    ServedList *sl = arg;
+    sl->next = load_list(sl->path, &sl->next_version);
+    stats_merge_thread();
+    while (write(sl->done_fd, &sl->index, sizeof(sl->index)) < 0 && errno == EINTR) {
+    }
+    return NULL;
+}
+
+/**
+    This function starts loading a list again in the background, unless a reload is already running.
+    @param sl List to load
+ */
+static void start_reload(ServedList *sl)
+{
+    if (sl->reloading) {
+        return;
+    }
+    sl->reloading = true;
+    if (pthread_create(&sl->thread, NULL, reload_thread, sl) != 0) {
+        fprintf(stderr, "Error: cannot create reload thread.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+    This function swaps in the lists whose reload threads have finished. A list that could not be
+    loaded keeps its previous version.
+    @param s Server
+    @param done_fd Read end of the pipe the reload threads write to
+ */
+static void finish_reloads(Server *s, int done_fd)
+{
+    int index;
+    while (read(done_fd, &index, sizeof(index)) == (ssize_t)sizeof(index)) {
+        ServedList *sl = &s->lists[index];
+        pthread_join(sl->thread, NULL);
+        sl->reloading = false;
+        if (sl->next == NULL) {
+            fprintf(stderr, "Warning: cannot reload %s, still serving the previous version.\n", sl->path);
+            continue;
+        }
+        retire_list(sl->current);
+        sl->current = sl->next;
+        sl->version = sl->next_version;
+        sl->next = NULL;
+        sl->loads++;
+        fprintf(stderr, "Reloaded %s: %lld rows, %lld warnings\n", sl->path, sl->current->counts.rows,
+                sl->current->counts.warnings);
+    }
+}
+
+/**
+    This function starts a reload of every list whose file has changed, or of every list if forced.
+    A file that has gone missing is left alone until it comes back.
+    @param s Server
+    @param force true to reload every list
+ */
+static void check_lists(Server *s, bool force)
+{
+    for (int i = 0; i < s->count; i++) {
+        ServedList *sl = &s->lists[i];
+        FileVersion v;
+        if (file_version(sl->path, &v) && (force || !same_version(&v, &sl->version))) {
+            start_reload(sl);
+        }
+    }
+}
+
+/**
+    This function watches the directory of every list, so a write to a list or a new file renamed
+    over it is noticed at once.
+    @param s Server
+    @return inotify descriptor, or -1 if inotify is unavailable and only the periodic check is used
+ */
+static int watch_lists(Server *s)
+{
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    for (int i = 0; i < s->count; i++) {
+        char dir[4096];
+        const char *slash = strrchr(s->lists[i].path, '/');
+        if (slash == NULL) {
+            strcpy(dir, ".");
+        } else {
+            int len = slash == s->lists[i].path ? 1 : (int)(slash - s->lists[i].path);
+            snprintf(dir, sizeof(dir), "%.*s", len, s->lists[i].path);
+        }
+        inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB);
+    }
+    return fd;
+}
+
+/**
+    This function returns a compiled date format, compiling it only the first time it is used.
+    @param s Server
+    @param spec --date-format argument
+    @return The compiled format, or NULL if it is invalid
+ */
+static const DateFormat *cached_format(Server *s, const char *spec)
+{
+    for (int i = 0; i < s->format_count; i++) {
+        if (strcmp(s->formats[i].spec, spec) == 0) {
+            return &s->formats[i].date;
+        }
+    }
+    DateFormat date;
+    if (strlen(spec) >= MAX_DATE_FORMAT || !date_format_compile(spec, &date)) {
+        return NULL;
+    }
+    int slot = s->format_count < SERVER_FORMATS ? s->format_count++ : s->format_next++ % SERVER_FORMATS;
+    strcpy(s->formats[slot].spec, spec);
+    s->formats[slot].date = date;
+    return &s->formats[slot].date;
+}
+
+/**
+    This function reads the options of a rows, count or aggregate request.
+    @param s Server
+    @param words Options
+    @param count Number of options
+    @param r Request to fill in
+    @param error Set to a description of the first bad option
+    @return false if an option is unknown or invalid
+ */
+static bool parse_options(Server *s, char **words, int count, Request *r, const char **error)
+{
+    memset(r, 0, sizeof(*r));
+    r->list = -1;
+    r->format.date = *cached_format(s, "");
+    for (int i = 0; i < count; i++) {
+        const char *w = words[i];
+        if (strncmp(w, "--list=", 7) == 0) {
+            r->list = -1;
+            for (int j = 0; j < s->count; j++) {
+                if (strcmp(s->lists[j].path, w + 7) == 0) {
+                    r->list = j;
+                }
+            }
+            if (r->list < 0) {
+                *error = "unknown list";
+                return false;
+            }
+        } else if (strncmp(w, "--from=", 7) == 0) {
+            if (!query_parse_time(w + 7, false, &r->query.from)) {
+                *error = "invalid date";
+                return false;
+            }
+            r->query.has_from = r->use_query = true;
+        } else if (strncmp(w, "--to=", 5) == 0) {
+            if (!query_parse_time(w + 5, true, &r->query.to)) {
+                *error = "invalid date";
+                return false;
+            }
+            r->query.has_to = r->use_query = true;
+        } else if (strncmp(w, "--peak-above=", 13) == 0) {
+            if (!query_parse_peak(w + 13, &r->query.min_peak)) {
+                *error = "invalid peak";
+                return false;
+            }
+            r->query.has_min_peak = r->use_query = true;
+        } else if (strncmp(w, "--detector=", 11) == 0) {
+            uint16_t mask = detector_mask(w + 11, (int)strlen(w + 11));
+            if (mask == 0) {
+                *error = "invalid detector list";
+                return false;
+            }
+            r->query.detectors |= mask;
+            r->use_query = true;
+        } else if (strncmp(w, "--active-at=", 12) == 0) {
+            if (!query_parse_time(w + 12, false, &r->query.active_from) ||
+                !query_parse_time(w + 12, true, &r->query.active_to)) {
+                *error = "invalid date";
+                return false;
+            }
+            r->query.has_active = r->use_query = true;
+        } else if (strncmp(w, "--active-during=", 16) == 0) {
+            if (!query_parse_window(w + 16, &r->query.active_from, &r->query.active_to)) {
+                *error = "invalid window";
+                return false;
+            }
+            r->query.has_active = r->use_query = true;
+        } else if (strncmp(w, "--date-format=", 14) == 0) {
+            const DateFormat *date = cached_format(s, w + 14);
+            if (date == NULL) {
+                *error = "invalid date format";
+                return false;
+            }
+            r->format.date = *date;
+            r->has_date_format = true;
+        } else if (strcmp(w, "--decimal") == 0) {
+            r->format.decimal = true;
+        } else {
+            *error = "unknown option";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+    This function selects the rows of a list that match a request.
+    @param sl List to search
+    @param r Request
+    @param matches Set to the number of matching rows
+    @return Bitmap of the matching rows, or NULL if every row matches
+ */
+static const uint64_t *select_rows(ServedList *sl, const Request *r, long long *matches)
+{
+    LoadedList *l = sl->current;
+    if (!r->use_query) {
+        *matches = l->table.count;
+        return NULL;
+    }
+    if (sl->selected_words < l->index.words || sl->selected == NULL) {
+        free(sl->selected);
+        sl->selected_words = l->index.words;
+        sl->selected = checked_calloc(sl->selected_words * sizeof(uint64_t));
+    }
+    *matches = index_query(&l->index, &l->table, &r->query, sl->selected);
+    return sl->selected;
+}
+
+/**
+    This function answers a rows or count request. The rows of every list are selected first, so
+    the reply can start with their number. The rows themselves are formatted a piece at a time as
+    the client drains the reply, from the versions of the lists selected here and a copy of their
+    row bitmaps, so a reload or another request in the meantime does not change them.
+    @param s Server
+    @param r Request
+    @param with_rows true to send the rows, false to send only how many there are
+    @param c Client to reply to
+ */
+static void answer_query(Server *s, const Request *r, bool with_rows, Client *c)
+{
+    const uint64_t *selected[s->count];
+    long long total = 0;
+    int first = r->list < 0 ? 0 : r->list;
+    int last = r->list < 0 ? s->count - 1 : r->list;
+    for (int i = first; i <= last; i++) {
+        long long matches;
+        selected[i] = select_rows(&s->lists[i], r, &matches);
+        total += matches;
+    }
+    if (!with_rows) {
+        out_printf(&c->out, "OK 1\n%lld\n", total);
+        return;
+    }
+    out_printf(&c->out, "OK %lld\n", total);
+    if (total == 0) {
+        return;
+    }
+    RowStream *st = checked_calloc(sizeof(RowStream));
+    st->request = *r;
+    st->count = last - first + 1;
+    st->lists = checked_calloc(st->count * sizeof(LoadedList *));
+    st->selected = checked_calloc(st->count * sizeof(uint64_t *));
+    for (int i = 0; i < st->count; i++) {
+        LoadedList *l = s->lists[first + i].current;
+        st->lists[i] = l;
+        l->streams++;
+        if (selected[first + i] != NULL) {
+            st->selected[i] = checked_calloc(l->index.words * sizeof(uint64_t));
+            memcpy(st->selected[i], selected[first + i], l->index.words * sizeof(uint64_t));
+        }
+    }
+    c->stream = st;
+}
+
+/**
+    This function ends a client's row stream, releasing the list versions no longer served once
+    their last reply is done.
+    @param c Client
+ */
+static void end_stream(Client *c)
+{
+    RowStream *st = c->stream;
+    if (st == NULL) {
+        return;
+    }
+    for (int i = 0; i < st->count; i++) {
+        LoadedList *l = st->lists[i];
+        if (--l->streams == 0 && l->retired) {
+            free_list(l);
+        }
+        free(st->selected[i]);
+    }
+    free(st->lists);
+    free(st->selected);
+    free(st);
+    c->stream = NULL;
+}
+
+/**
+    This function formats the next piece of a client's rows into its reply, ending the stream after
+    the last row.
+    @param c Client with a row stream
+ */
+static void continue_stream(Client *c)
+{
+    RowStream *st = c->stream;
+    ProcessCounts counts = {0, 0};
+    while (st->list < st->count && counts.rows < SERVER_PIECE_ROWS) {
+        const FlareTable *t = &st->lists[st->list]->table;
+        st->next = process_table_range(t, st->selected[st->list], st->next,
+                                       SERVER_PIECE_ROWS - (uint32_t)counts.rows, &st->request.format, &c->out,
+                                       &counts);
+        if (st->next >= t->count) {
+            st->list++;
+            st->next = 0;
+        }
+    }
+    if (st->list == st->count) {
+        end_stream(c);
+    }
+}
+
+/**
+    This function answers an aggregate request over every list, or the one given with --list. The
+    table is built first, so the reply can start with its number of lines; a table larger than
+    SERVER_MAX_REPLY is refused rather than held for the client.
+    @param s Server
+    @param words Period and options
+    @param count Number of words
+    @param out Reply
+ */
+static void answer_aggregate(Server *s, char **words, int count, OutBuffer *out)
+{
+    AggregatePeriod period;
+    if (count > 0 && strcmp(words[0], "day") == 0) {
+        period = AGGREGATE_DAY;
+    } else if (count > 0 && strcmp(words[0], "month") == 0) {
+        period = AGGREGATE_MONTH;
+    } else {
+        out_printf(out, "ERR aggregate needs day or month\n");
+        return;
+    }
+    Request r;
+    const char *error;
+    if (!parse_options(s, words + 1, count - 1, &r, &error)) {
+        out_printf(out, "ERR %s\n", error);
+        return;
+    }
+    if (r.use_query || r.has_date_format) {
+        out_printf(out, "ERR aggregate takes only --list and --decimal\n");
+        return;
+    }
+
+    const FlareTable *tables[s->count];
+    int n = 0;
+    for (int i = 0; i < s->count; i++) {
+        if (r.list < 0 || r.list == i) {
+            tables[n++] = &s->lists[i].current->table;
+        }
+    }
+    OutBuffer table;
+    ProcessCounts counts;
+    out_init(&table, NULL);
+    aggregate_tables(tables, n, period, r.format.decimal, &table, &counts);
+    if (table.len > SERVER_MAX_REPLY) {
+        out_free(&table);
+        out_printf(out, "ERR reply too large\n");
+        return;
+    }
+    long lines = 0;
+    for (size_t k = 0; k < table.len; k++) {
+        lines += table.data[k] == '\n';
+    }
+    out_printf(out, "OK %ld\n", lines);
+    out_write(out, table.data, table.len);
+    out_free(&table);
+}
+
+/**
+    This function answers one request line, appending the reply to the client's output.
+    @param s Server
+    @param c Client that sent the request
+    @param line Request, without its newline
+ */
+static void answer(Server *s, Client *c, char *line)
+{
+    char *words[MAX_WORDS];
+    int count = 0;
+    for (char *p = line; *p != '\0';) {
+        while (*p == ' ' || *p == '\t' || *p == '\r') {
+            *p++ = '\0';
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (count == MAX_WORDS) {
+            out_printf(&c->out, "ERR too many options\n");
+            return;
+        }
+        words[count++] = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r') {
+            p++;
+        }
+    }
+    if (count == 0) {
+        out_printf(&c->out, "ERR empty request\n");
+        return;
+    }
+
+    if (strcmp(words[0], "rows") == 0 || strcmp(words[0], "count") == 0) {
+        Request r;
+        const char *error;
+        if (!parse_options(s, words + 1, count - 1, &r, &error)) {
+            out_printf(&c->out, "ERR %s\n", error);
+            return;
+        }
+        answer_query(s, &r, words[0][0] == 'r', c);
+    } else if (strcmp(words[0], "aggregate") == 0) {
+        answer_aggregate(s, words + 1, count - 1, &c->out);
+    } else if (strcmp(words[0], "lists") == 0 && count == 1) {
+        out_printf(&c->out, "OK %d\n", s->count);
+        for (int i = 0; i < s->count; i++) {
+            const ServedList *sl = &s->lists[i];
+            out_printf(&c->out, "%s %lld %lld %d\n", sl->path, sl->current->counts.rows,
+                       sl->current->counts.warnings, sl->loads);
+        }
+    } else if (strcmp(words[0], "reload") == 0 && count == 1) {
+        check_lists(s, true);
+        out_printf(&c->out, "OK 0\n");
+    } else if (strcmp(words[0], "quit") == 0 && count == 1) {
+        out_printf(&c->out, "OK 0\n");
+        c->closing = true;
+    } else {
+        out_printf(&c->out, "ERR unknown request\n");
+    }
+}
+
+/**
+    This function sends as much of a client's reply as the socket takes without blocking.
+    @param c Client
+    @return false if the connection has failed
+ */
+static bool send_reply(Client *c)
+{
+    while (c->sent < c->out.len) {
+        ssize_t n = send(c->fd, c->out.data + c->sent, c->out.len - c->sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        c->sent += (size_t)n;
+    }
+    // Keep the buffer for the next piece of a row stream; otherwise release the memory of a large
+    // reply rather than keeping it for the next one
+    if (c->stream != NULL) {
+        c->out.len = 0;
+    } else {
+        out_free(&c->out);
+        out_init(&c->out, NULL);
+    }
+    c->sent = 0;
+    return true;
+}
+
+/**
+    This function answers a client's complete request lines in order, one at a time, sending each
+    reply before the next request is answered.
+    @param s Server
+    @param c Client
+    @return false if the connection should be closed
+ */
+static bool serve_client(Server *s, Client *c)
+{
+    for (;;) {
+        if (!send_reply(c)) {
+            return false;
+        }
+        if (c->out.len > 0) {
+            return true; // The rest of the reply goes out when the socket has room
+        }
+        if (c->stream != NULL) {
+            continue_stream(c);
+            continue;
+        }
+        if (c->closing) {
+            return false;
+        }
+        char *nl = memchr(c->in, '\n', c->in_len);
+        if (nl == NULL) {
+            if (c->in_len == sizeof(c->in)) {
+                out_printf(&c->out, "ERR request too long\n");
+                c->closing = true;
+                continue;
+            }
+            return !c->eof;
+        }
+        *nl = '\0';
+        answer(s, c, c->in);
+        size_t used = (size_t)(nl + 1 - c->in);
+        memmove(c->in, nl + 1, c->in_len - used);
+        c->in_len -= used;
+    }
+}
+
+/**
+    This function reads what a client has sent, as far as its request buffer has room.
+    @param c Client
+    @return false if the connection has failed
+ */
+static bool receive_requests(Client *c)
+{
+    while (c->in_len < sizeof(c->in)) {
+        ssize_t n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if (n == 0) {
+            c->eof = true;
+            break;
+        }
+        c->in_len += (size_t)n;
+    }
+    return true;
+}
+
+/**
+    This function accepts every pending connection.
+    @param s Server
+    @param listen_fd Listening socket
+ */
+static void accept_clients(Server *s, int listen_fd)
+{
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        if (s->client_count == s->client_cap) {
+            s->client_cap = s->client_cap ? s->client_cap * 2 : 16;
+            s->clients = realloc(s->clients, s->client_cap * sizeof(Client *));
+            if (s->clients == NULL) {
+                fprintf(stderr, "Error: out of memory in flare_server.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        Client *c = checked_calloc(sizeof(Client));
+        c->fd = fd;
+        out_init(&c->out, NULL);
+        s->clients[s->client_count++] = c;
+    }
+}
+
+/**
+    This function closes a connection and forgets its client.
+    @param s Server
+    @param i Index of the client
+ */
+static void drop_client(Server *s, int i)
+{
+    Client *c = s->clients[i];
+    close(c->fd);
+    end_stream(c);
+    out_free(&c->out);
+    free(c);
+    s->clients[i] = s->clients[--s->client_count];
+}
+
+/**
+    This function creates the listening socket. A socket file left behind by a server that is no
+    longer running is replaced; one that still accepts connections is an error.
+    @param path Path of the socket
+    @return The listening socket, or -1 on failure
+ */
+static int open_socket(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: socket path too long %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool live = !S_ISSOCK(st.st_mode) || connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        close(probe);
+        if (live) {
+            fprintf(stderr, "Error: %s is in use\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Error: cannot listen on %s\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+/**
+    This function loads flare lists and serves requests for them until SIGINT or SIGTERM arrives.
+    @param paths Lists to serve
+    @param count Number of lists
+    @param socket_path Path of the Unix socket to listen on
+    @return EXIT_SUCCESS after an orderly stop, EXIT_FAILURE if a list or the socket cannot be set up
+ */
+int serve_lists(char **paths, int count, const char *socket_path)
+{
+    Server s;
+    memset(&s, 0, sizeof(s));
+    s.count = count;
+    s.lists = checked_calloc(count * sizeof(ServedList));
+
+    int done_pipe[2];
+    if (pipe(done_pipe) != 0) {
+        fprintf(stderr, "Error: cannot create pipe.\n");
+        return EXIT_FAILURE;
+    }
+    fcntl(done_pipe[0], F_SETFL, fcntl(done_pipe[0], F_GETFL) | O_NONBLOCK);
+
+    for (int i = 0; i < count; i++) {
+        ServedList *sl = &s.lists[i];
+        sl->path = paths[i];
+        sl->index = i;
+        sl->done_fd = done_pipe[1];
+        sl->current = load_list(sl->path, &sl->version);
+        if (sl->current == NULL) {
+            fprintf(stderr, "Error: cannot load %s\n", sl->path);
+            return EXIT_FAILURE;
+        }
+        sl->loads = 1;
+    }
+
+    int listen_fd = open_socket(socket_path);
+    if (listen_fd < 0) {
+        return EXIT_FAILURE;
+    }
+    int watch_fd = watch_lists(&s);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "Serving %d list%s on %s\n", count, count == 1 ? "" : "s", socket_path);
+
+    struct pollfd *fds = NULL;
+    int fds_cap = 0;
+    double last_check = now_ms();
+    while (!stop_requested) {
+        // The first three entries are the listening socket, the reload pipe, and inotify
+        if (fds_cap < 3 + s.client_count) {
+            fds_cap = 2 * (3 + s.client_count);
+            fds = realloc(fds, fds_cap * sizeof(struct pollfd));
+            if (fds == NULL) {
+                fprintf(stderr, "Error: out of memory in flare_server.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        fds[0] = (struct pollfd){listen_fd, POLLIN, 0};
+        fds[1] = (struct pollfd){done_pipe[0], POLLIN, 0};
+        fds[2] = (struct pollfd){watch_fd, POLLIN, 0};
+        int client_count = s.client_count;
+        for (int i = 0; i < client_count; i++) {
+            Client *c = s.clients[i];
+            short events = c->out.len > 0 ? POLLOUT : (c->eof ? 0 : POLLIN);
+            fds[3 + i] = (struct pollfd){c->fd, events, 0};
+        }
+
+        int ready = poll(fds, 3 + client_count, SERVER_CHECK_MS);
+        if (ready < 0 && errno != EINTR) {
+            fprintf(stderr, "Error: poll failed.\n");
+            break;
+        }
+        if (ready > 0) {
+            // Swap in finished reloads before answering, so requests see them at once
+            if (fds[1].revents & POLLIN) {
+                finish_reloads(&s, done_pipe[0]);
+            }
+            // Walk the clients backward, since dropping one moves the last into its place
+            for (int i = client_count - 1; i >= 0; i--) {
+                Client *c = s.clients[i];
+                short revents = fds[3 + i].revents;
+                bool ok = true;
+                if (revents & (POLLERR | POLLNVAL)) {
+                    ok = false;
+                } else if (revents & (POLLIN | POLLHUP)) {
+                    ok = receive_requests(c) && serve_client(&s, c);
+                } else if (revents & POLLOUT) {
+                    ok = serve_client(&s, c);
+                }
+                if (!ok) {
+                    drop_client(&s, i);
+                }
+            }
+            if (fds[0].revents & POLLIN) {
+                accept_clients(&s, listen_fd);
+            }
+            if (fds[2].revents & POLLIN) {
+                char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+                while (read(watch_fd, events, sizeof(events)) > 0) {
+                }
+                check_lists(&s, false);
+            }
+        }
+        if (now_ms() - last_check >= SERVER_CHECK_MS) {
+            check_lists(&s, false);
+            last_check = now_ms();
+        }
+    }
+
+    // Drop the clients first, so no reply still holds a version of a list
+    while (s.client_count > 0) {
+        drop_client(&s, s.client_count - 1);
+    }
+    // Let running reloads finish so their memory can be released
+    for (int i = 0; i < count; i++) {
+        if (s.lists[i].reloading) {
+            pthread_join(s.lists[i].thread, NULL);
+            free_list(s.lists[i].next);
+        }
+        free_list(s.lists[i].current);
+        free(s.lists[i].selected);
+    }
+    close(listen_fd);
+    unlink(socket_path);
+    if (watch_fd >= 0) {
+        close(watch_fd);
+    }
+    close(done_pipe[0]);
+    close(done_pipe[1]);
+    free(fds);
+    free(s.clients);
+    free(s.lists);
+    return EXIT_SUCCESS;
+}
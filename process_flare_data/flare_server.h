@@ -0,0 +1,36 @@
+/**
+     @file flare_server.h
+     This header file defines server mode, which keeps flare lists loaded and indexed in memory and
+     answers requests from local clients over a Unix domain socket. Each request is one line, such as
+     "rows --from=2020-01-01 --peak-above=100 --date-format=YYYY-MM-DD" or "count --detector=n1,n5",
+     taking the same options as the command line. A reply starts with "OK <lines>" followed by that
+     many lines, or is a single "ERR <message>" line. The rows are those main prints for the same
+     options. Requests:
+
+         rows [OPTIONS]   Formatted rows matching the options
+         count [OPTIONS]  Number of rows matching the options
+         aggregate day|month [--list=PATH] [--decimal]
+                          Totals per day or month, the table --aggregate prints
+         lists            One line per list: path, rows, malformed lines, and times loaded
+         reload           Load every list again now
+         quit             Close the connection
+
+     OPTIONS are --list=PATH to use only that list (one of the served paths, as given), --from=DATE,
+     --to=DATE, --peak-above=X, --detector=LIST (separated by commas), --active-at=TIME,
+     --active-during=FROM,TO, --date-format=FORMAT, and --decimal. A list that changes on disk is
+     loaded again in the background and swapped in once it is ready; until then, and if it cannot
+     be loaded, requests see the previous version.
+ */
+#ifndef FLARE_SERVER_H
+#define FLARE_SERVER_H
+
+#define SERVER_MAX_REQUEST 4096     // Longest request line, with its newline
+#define SERVER_CHECK_MS 1000        // Interval between checks of the lists for changes
+#define SERVER_FORMATS 8            // Compiled date formats kept between requests
+#define SERVER_PIECE_ROWS 4096      // Rows formatted into a reply at a time
+#define SERVER_MAX_REPLY (64 << 20) // Largest aggregate table sent, in bytes
+
+// Load the count lists and serve requests on the Unix socket at socket_path until interrupted; returns an exit status
+int serve_lists(char **paths, int count, const char *socket_path);
+
+#endif
@@ -0,0 +1,25 @@
+/**
+     @file flare_snapshot.h
+     This header file defines the columnar binary snapshot format for parsed flare lists. A snapshot
+     is the columns of a FlareTable written back to back, so reading one is only a matter of mapping it.
+ */
+#ifndef FLARE_SNAPSHOT_H
+#define FLARE_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "flare_table.h"
+
+#define SNAPSHOT_MAGIC "FLRSNAP1" // First 8 bytes of every snapshot
+#define SNAPSHOT_VERSION 3         // Layout version written by this program
+
+// Return true if the data starts with a snapshot header
+bool snapshot_detect(const char *data, size_t size);
+
+// Write the table to path as a snapshot, returning false on an I/O error
+bool snapshot_write(const FlareTable *t, const char *path);
+
+// Point the columns of t into a mapped snapshot, returning false if it is damaged or incompatible
+bool snapshot_open(const char *data, size_t size, FlareTable *t);
+
+#endif
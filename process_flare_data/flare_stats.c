@@ -0,0 +1,110 @@
+/**
+    @file flare_stats.c
+    This program collects the per-stage counters and timers of a run and prints them as JSON when
+    the run ends. Threads record into their own FlareStats and merge them into the totals under a
+    lock once, when they finish.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include "flare_stats.h"
+#include "fraction.h"
+
+#if FLARE_STATS
+bool stats_enabled;
+#endif
+__thread FlareStats thread_stats;
+
+static FlareStats totals;          // Counts merged from finished threads
+static long long total_gcd_calls;  // gcd() calls merged from finished threads
+static pthread_mutex_t totals_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t start_ns, start_ticks; // Readings taken when recording started
+
+/**
+    This function returns a monotonic timestamp.
+    @return Current time in nanoseconds
+ */
+uint64_t stats_monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+    This function starts recording. It takes the readings used to convert clock ticks to
+    nanoseconds at the end of the run.
+    @return true, or false if instrumentation was compiled out
+ */
+bool stats_enable(void)
+{
+#if FLARE_STATS
+    start_ns = stats_monotonic_ns();
+    start_ticks = stats_clock();
+    thread_stats.gcd_merged = fraction_gcd_calls();
+    stats_enabled = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+    This function adds the counts of the calling thread to the totals and clears them, so calling
+    it again only merges what was recorded since.
+ */
+void stats_merge_thread(void)
+{
+    if (!stats_enabled) {
+        return;
+    }
+    long long gcd_calls = fraction_gcd_calls();
+    pthread_mutex_lock(&totals_lock);
+    for (int i = 0; i < COUNT_KINDS; i++) {
+        totals.counts[i] += thread_stats.counts[i];
+    }
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        totals.ticks[i] += thread_stats.ticks[i];
+    }
+    total_gcd_calls += gcd_calls - thread_stats.gcd_merged;
+    pthread_mutex_unlock(&totals_lock);
+
+    for (int i = 0; i < COUNT_KINDS; i++) {
+        thread_stats.counts[i] = 0;
+    }
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        thread_stats.ticks[i] = 0;
+    }
+    thread_stats.gcd_merged = gcd_calls;
+}
+
+/**
+    This function merges the calling thread and prints the totals to standard error as one JSON
+    object. Stage times are summed over all threads, so with workers they can add up to more
+    than the wall time.
+ */
+void stats_report(void)
+{
+    static const char *stage_names[STAGE_COUNT] = {"parse", "date", "fraction", "format", "write"};
+    if (!stats_enabled) {
+        return;
+    }
+    stats_merge_thread();
+
+    // Ticks are nanoseconds unless the clock is the time stamp counter; scale by the measured rate
+    uint64_t wall_ns = stats_monotonic_ns() - start_ns;
+    uint64_t wall_ticks = stats_clock() - start_ticks;
+    double ns_per_tick = wall_ticks > 0 ? (double)wall_ns / (double)wall_ticks : 1.0;
+
+    pthread_mutex_lock(&totals_lock);
+    fprintf(stderr, "{\"rows\": %lld, \"skipped\": %lld, \"gcd_calls\": %lld, \"bytes_in\": %lld, "
+            "\"bytes_out\": %lld, \"wall_ns\": %llu, \"stage_ns\": {",
+            totals.counts[COUNT_ROWS], totals.counts[COUNT_SKIPPED], total_gcd_calls,
+            totals.counts[COUNT_BYTES_IN], totals.counts[COUNT_BYTES_OUT], (unsigned long long)wall_ns);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        fprintf(stderr, "%s\"%s\": %.0f", i > 0 ? ", " : "", stage_names[i], totals.ticks[i] * ns_per_tick);
+    }
+    fprintf(stderr, "}}\n");
+    pthread_mutex_unlock(&totals_lock);
+}
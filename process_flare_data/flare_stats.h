@@ -0,0 +1,117 @@
+/**
+     @file flare_stats.h
+     This header file defines the per-stage counters and timers printed by --stats. Each thread
+     adds to its own copy, so recording takes no lock, and the copies are merged when a worker
+     finishes. Every recording call first checks stats_enabled, so a run without --stats only pays
+     for a predictable branch; building with -DFLARE_STATS=0 removes the calls altogether. Stages
+     are timed with the time stamp counter where there is one, and converted to nanoseconds once
+     at the end.
+ */
+#ifndef FLARE_STATS_H
+#define FLARE_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifndef FLARE_STATS
+#define FLARE_STATS 1 // Set to 0 to build without instrumentation
+#endif
+
+// Stages of processing a row, each timed separately
+typedef enum {
+    STAGE_PARSE,    // Tokenizing input lines or decoding table records
+    STAGE_DATE,     // Converting start dates
+    STAGE_FRACTION, // Computing the peak, rate, and total count values
+    STAGE_FORMAT,   // Formatting output rows
+    STAGE_WRITE,    // Writing output to its sink
+    STAGE_COUNT
+} FlareStage;
+
+// Quantities counted alongside the timers
+typedef enum {
+    COUNT_ROWS,      // Rows printed
+    COUNT_SKIPPED,   // Lines skipped with a line format error
+    COUNT_BYTES_IN,  // Bytes of input read or mapped
+    COUNT_BYTES_OUT, // Bytes of output written
+    COUNT_KINDS
+} FlareCounter;
+
+typedef struct {
+    long long counts[COUNT_KINDS]; // Indexed by FlareCounter
+    uint64_t ticks[STAGE_COUNT];   // Clock ticks spent in each stage
+    long long gcd_merged;          // gcd() calls of this thread already merged
+} FlareStats;
+
+#if FLARE_STATS
+extern bool stats_enabled; // Set once --stats is given
+#else
+#define stats_enabled false
+#endif
+extern __thread FlareStats thread_stats; // Counts of the calling thread not yet merged
+
+// Start recording, returning false if instrumentation was compiled out
+bool stats_enable(void);
+
+// Add the calling thread's counts to the totals; call before a worker thread exits
+void stats_merge_thread(void);
+
+// Merge the calling thread and print the totals as JSON to standard error
+void stats_report(void);
+
+// Return a monotonic time in nanoseconds
+uint64_t stats_monotonic_ns(void);
+
+/**
+    Reads the stage clock: the time stamp counter on x86, nanoseconds elsewhere.
+    @return current clock value
+ */
+static inline uint64_t stats_clock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return stats_monotonic_ns();
+#endif
+}
+
+/**
+    Starts timing a stage.
+    @return the clock value to pass to stats_lap, or 0 when stats are off
+ */
+static inline uint64_t stats_start(void)
+{
+    return stats_enabled ? stats_clock() : 0;
+}
+
+/**
+    Charges the time since a previous reading to a stage.
+    @param stage stage to charge
+    @param since clock value from stats_start or an earlier stats_lap
+    @return the current clock value, to time the next stage from
+ */
+static inline uint64_t stats_lap(FlareStage stage, uint64_t since)
+{
+    if (!stats_enabled) {
+        return 0;
+    }
+    uint64_t now = stats_clock();
+    thread_stats.ticks[stage] += now - since;
+    return now;
+}
+
+/**
+    Adds to a counter of the calling thread.
+    @param counter counter to add to
+    @param n amount to add
+ */
+static inline void stats_add(FlareCounter counter, long long n)
+{
+    if (stats_enabled) {
+        thread_stats.counts[counter] += n;
+    }
+}
+
+#endif
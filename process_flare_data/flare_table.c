@@ -0,0 +1,256 @@
+/**
+    @file flare_table.c
+    This program builds a column-oriented table of flare records from tokenized rows and turns records
+    back into rows for the formatting code. Times are stored as seconds and rendered again in the layout
+    of the flare list. Start dates and detector strings repeat from row to row, so each distinct one is
+    stored once and records hold its code; a date is parsed into its day number only the first time
+    it is seen, and a record gives back the date text exactly as it appeared. A start date that is not
+    a real date, such as 31-Feb-2012, is kept as text with the day number DATE_DAYS_NONE, so the row
+    prints just as the text path prints it.
+ */
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flare_date.h"
+#include "flare_table.h"
+
+/**
+    This function reallocates a column, exiting if memory runs out.
+    @param p Column to grow
+    @param size New size in bytes
+    @return The reallocated column
+ */
+static void *grow(void *p, size_t size)
+{
+    p = realloc(p, size);
+    if (p == NULL) {
+        fprintf(stderr, "Error: out of memory in flare_table.\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/**
+    This function checks that a 64-bit value fits a 32-bit column.
+    @param v Value to check
+    @return true if v fits in int32_t
+ */
+static bool fits_int32(int64 v)
+{
+    return v >= INT32_MIN && v <= INT32_MAX;
+}
+
+/**
+    This function initializes an empty table with room for a few rows.
+    @param t Table to initialize
+ */
+void table_init(FlareTable *t)
+{
+    memset(t, 0, sizeof(*t));
+    t->owned = true;
+    t->id_offsets = grow(NULL, sizeof(uint32_t));
+    t->id_offsets[0] = 0;
+    dict_init(&t->detector_dict);
+    t->detector_offsets = t->detector_dict.offsets;
+    dict_init(&t->date_dict);
+    t->date_offsets = t->date_dict.offsets;
+}
+
+/**
+    This function finds the code of a start date, adding the date if it is new. Rows come sorted by
+    date, so the date of the previous row is tried before the dictionary.
+    @param t Table to search
+    @param date Start date as it appears in the input
+    @return The code of the date
+ */
+static uint32_t date_code(FlareTable *t, Field date)
+{
+    int len;
+    if (t->date_dict.count > 0) {
+        const char *last = dict_string(&t->date_dict, t->last_date, &len);
+        if (len == date.len && memcmp(last, date.ptr, len) == 0) {
+            return t->last_date;
+        }
+    }
+    uint32_t code = dict_find(&t->date_dict, date.ptr, date.len);
+    if (code == DICT_ABSENT) {
+        int year, month, day;
+        bool real = flare_parse_date(date, &year, &month, &day) && valid_civil(year, month, day);
+        if (t->date_dict.count == t->date_days_cap) {
+            t->date_days_cap = t->date_days_cap ? t->date_days_cap * 2 : 256;
+            t->date_days = grow(t->date_days, t->date_days_cap * sizeof(int32_t));
+        }
+        code = dict_intern(&t->date_dict, date.ptr, date.len);
+        t->date_days[code] = real ? days_from_civil(year, month, day) : DATE_DAYS_NONE;
+        t->date_count = t->date_dict.count;
+        t->date_offsets = t->date_dict.offsets;
+        t->date_chars = t->date_dict.chars;
+    }
+    t->last_date = code;
+    return code;
+}
+
+/**
+    This function appends a tokenized row to the table, doubling the columns when they are full.
+    @param t Table to append to
+    @param row Row to append
+    @return true on success, false if a value does not fit its column
+ */
+bool table_append(FlareTable *t, const FlareRow *row)
+{
+    if (!fits_int32(row->peak[0]) || !fits_int32(row->peak[1]) || !fits_int32(row->avg[0]) ||
+        t->detector_dict.count > UINT16_MAX) {
+        return false;
+    }
+    uint32_t date = date_code(t, row->start_date);
+
+    if (t->count == t->cap) {
+        t->cap = t->cap ? t->cap * 2 : 1024;
+        t->date_codes = grow(t->date_codes, t->cap * sizeof(uint32_t));
+        t->start_sec = grow(t->start_sec, t->cap * sizeof(int32_t));
+        t->peak_sec = grow(t->peak_sec, t->cap * sizeof(int32_t));
+        t->end_sec = grow(t->end_sec, t->cap * sizeof(int32_t));
+        t->peak_int = grow(t->peak_int, t->cap * sizeof(int32_t));
+        t->peak_dec = grow(t->peak_dec, t->cap * sizeof(int32_t));
+        t->avg_int = grow(t->avg_int, t->cap * sizeof(int32_t));
+        t->avg_dec = grow(t->avg_dec, t->cap * sizeof(int64_t));
+        t->detector_codes = grow(t->detector_codes, t->cap * sizeof(uint16_t));
+        t->id_offsets = grow(t->id_offsets, (t->cap + 1) * sizeof(uint32_t));
+    }
+    if (t->id_chars_len + row->flare_id.len > t->id_chars_cap) {
+        t->id_chars_cap = (t->id_chars_len + row->flare_id.len) * 2 + 64;
+        t->id_chars = grow(t->id_chars, t->id_chars_cap);
+    }
+
+    uint32_t i = t->count;
+    t->date_codes[i] = date;
+    t->start_sec[i] = row->start_sec;
+    t->peak_sec[i] = row->peak_sec;
+    t->end_sec[i] = row->end_sec;
+    t->peak_int[i] = (int32_t)row->peak[0];
+    t->peak_dec[i] = (int32_t)row->peak[1];
+    t->avg_int[i] = (int32_t)row->avg[0];
+    t->avg_dec[i] = row->avg[1];
+    memcpy(t->id_chars + t->id_chars_len, row->flare_id.ptr, row->flare_id.len);
+    t->id_chars_len += row->flare_id.len;
+    t->id_offsets[i + 1] = (uint32_t)t->id_chars_len;
+
+    // Detector strings repeat heavily, so each distinct one is stored once
+    t->detector_codes[i] = (uint16_t)dict_intern(&t->detector_dict, row->detectors.ptr, row->detectors.len);
+    t->detector_count = t->detector_dict.count;
+    t->detector_offsets = t->detector_dict.offsets;
+    t->detector_chars = t->detector_dict.chars;
+    t->count++;
+    return true;
+}
+
+/**
+    This function parses a run of data lines into the table. Blank lines are skipped silently, and
+    lines that do not tokenize or do not fit the columns are skipped with a warning.
+    @param t Table to append to
+    @param p Start of the first line
+    @param end End of the last line
+    @param warn Stream for warnings, or NULL to only count them
+    @param counts Counts to add the rows and malformed lines to
+ */
+void table_load_lines(FlareTable *t, const char *p, const char *end, FILE *warn, ProcessCounts *counts)
+{
+    FlareRow row;
+    FlareScanner sc;
+    const char *line, *line_end;
+
+    flare_scanner_init(&sc, p, end);
+    while (flare_scanner_next(&sc, &line, &line_end)) {
+        if (flare_scanner_row(&sc, line, line_end, &row) && table_append(t, &row)) {
+            counts->rows++;
+        } else if (!flare_scanner_blank(&sc, line, line_end)) {
+            if (warn != NULL) {
+                fprintf(warn, "Warning: line format error, skipping line.\n");
+            }
+            counts->warnings++;
+        }
+    }
+}
+
+/**
+    This function renders seconds since midnight as "HH:MM:SS", writing the digits directly for
+    any time below 100 hours.
+    @param seconds Time of day in seconds
+    @param buf Buffer of at least 16 bytes for the text
+    @return The text as a field
+ */
+static Field render_time(int seconds, char *buf)
+{
+    if (seconds < 0 || seconds >= 100 * 3600) {
+        int len = snprintf(buf, 16, "%02d:%02d:%02d", seconds / 3600, seconds / 60 % 60, seconds % 60);
+        return (Field){buf, len};
+    }
+    int parts[3] = {seconds / 3600, seconds / 60 % 60, seconds % 60};
+    for (int k = 0; k < 3; k++) {
+        buf[k * 3] = (char)('0' + parts[k] / 10);
+        buf[k * 3 + 1] = (char)('0' + parts[k] % 10);
+        buf[k * 3 + 2] = ':';
+    }
+    buf[8] = '\0';
+    return (Field){buf, 8};
+}
+
+/**
+    This function rebuilds a record as a row that the formatting code can print. The text fields
+    point into the table or into text, so text must outlive the row.
+    @param t Table holding the record
+    @param i Index of the record
+    @param row Row to fill in
+    @param text Buffers for the rendered times
+ */
+void table_row(const FlareTable *t, uint32_t i, FlareRow *row, RowText *text)
+{
+    uint32_t date = t->date_codes[i];
+    row->start_date = (Field){t->date_chars + t->date_offsets[date],
+                              (int)(t->date_offsets[date + 1] - t->date_offsets[date])};
+
+    row->start_time = render_time(t->start_sec[i], text->start_time);
+    row->peak_time = render_time(t->peak_sec[i], text->peak_time);
+    row->end_time = render_time(t->end_sec[i], text->end_time);
+    row->start_sec = t->start_sec[i];
+    row->peak_sec = t->peak_sec[i];
+    row->end_sec = t->end_sec[i];
+
+    row->flare_id = (Field){t->id_chars + t->id_offsets[i], (int)(t->id_offsets[i + 1] - t->id_offsets[i])};
+    uint16_t code = t->detector_codes[i];
+    row->detectors = (Field){t->detector_chars + t->detector_offsets[code],
+                             (int)(t->detector_offsets[code + 1] - t->detector_offsets[code])};
+
+    row->peak[0] = t->peak_int[i];
+    row->peak[1] = t->peak_dec[i];
+    row->peak[2] = PEAK_DECIMAL_LENGTH;
+    row->avg[0] = t->avg_int[i];
+    row->avg[1] = t->avg_dec[i];
+    row->avg[2] = AVG_DECIMAL_LENGTH;
+}
+
+/**
+    This function releases the columns of a table built in memory. A table mapped from a snapshot
+    does not own its columns and is left alone.
+    @param t Table to release
+ */
+void table_free(FlareTable *t)
+{
+    if (t->owned) {
+        free(t->date_codes);
+        free(t->date_days);
+        free(t->start_sec);
+        free(t->peak_sec);
+        free(t->end_sec);
+        free(t->peak_int);
+        free(t->peak_dec);
+        free(t->avg_int);
+        free(t->avg_dec);
+        free(t->id_offsets);
+        free(t->id_chars);
+        free(t->detector_codes);
+        dict_free(&t->detector_dict);
+        dict_free(&t->date_dict);
+    }
+    memset(t, 0, sizeof(*t));
+}
@@ -0,0 +1,71 @@
+/**
+     @file flare_table.h
+     This header file defines a column-oriented table of parsed flare records. Each column is a plain
+     array, so the table can be built from text, saved as a snapshot, or mapped back from one.
+ */
+#ifndef FLARE_TABLE_H
+#define FLARE_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "flare_parse.h"
+#include "flare_process.h"
+#include "string_dict.h"
+
+#define DATE_DAYS_NONE INT32_MIN // Day number of a start date that is not a real date
+
+struct FlareTable {
+    uint32_t count;             // Number of records
+    int32_t *start_sec;         // Start time of day in seconds
+    int32_t *peak_sec;          // Peak time of day in seconds
+    int32_t *end_sec;           // End time of day in seconds
+    int32_t *peak_int;          // Integer part of the peak
+    int32_t *peak_dec;          // Decimal part of the peak
+    int32_t *avg_int;           // Integer part of the average count rate
+    int64_t *avg_dec;           // Decimal part of the average count rate
+    uint32_t *id_offsets;       // Flare id i is id_chars[id_offsets[i] .. id_offsets[i + 1])
+    char *id_chars;             // Flare ids, back to back
+    uint16_t *detector_codes;   // Index of each record's detector string
+    uint32_t detector_count;    // Number of distinct detector strings
+    uint32_t *detector_offsets; // Detector string c is detector_chars[detector_offsets[c] .. detector_offsets[c + 1])
+    char *detector_chars;       // Distinct detector strings, back to back
+    uint32_t *date_codes;       // Index of each record's start date
+    uint32_t date_count;        // Number of distinct start dates
+    int32_t *date_days;         // Start date c as days since 1970-01-01, or DATE_DAYS_NONE
+    uint32_t *date_offsets;     // Start date c is date_chars[date_offsets[c] .. date_offsets[c + 1])
+    char *date_chars;           // Distinct start dates as they appear in the input, back to back
+
+    // Only used while building a table in memory
+    bool owned;                 // Set if the columns were allocated by table_init
+    uint32_t cap;               // Allocated rows per column
+    size_t id_chars_len;        // Bytes in use in id_chars
+    size_t id_chars_cap;        // Allocated size of id_chars
+    StringDict detector_dict;   // Interned detector strings
+    StringDict date_dict;       // Interned start dates
+    uint32_t date_days_cap;     // Allocated entries of date_days
+    uint32_t last_date;         // Code of the start date appended last
+};
+
+typedef struct {
+    char start_time[16]; // Start time as "HH:MM:SS"
+    char peak_time[16];  // Peak time as "HH:MM:SS"
+    char end_time[16];   // End time as "HH:MM:SS"
+} RowText;
+
+// Initialize an empty table that owns its columns
+void table_init(FlareTable *t);
+
+// Append a tokenized row, returning false if a value does not fit the columns
+bool table_append(FlareTable *t, const FlareRow *row);
+
+// Parse the data lines in [p, end) and append every row, reporting malformed lines to warn
+void table_load_lines(FlareTable *t, const char *p, const char *end, FILE *warn, ProcessCounts *counts);
+
+// Rebuild record i as a row, rendering its times into text
+void table_row(const FlareTable *t, uint32_t i, FlareRow *row, RowText *text);
+
+// Release the columns of a table built by table_init
+void table_free(FlareTable *t);
+
+#endif
@@ -4,12 +4,78 @@
     and performing arithmetic operations on fractions. It also includes functions for converting 
     decimal parts to fractions and printing fractions in a human-readable format.
  */
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "fraction.h"
 
+typedef __int128 int128;          // Wide intermediate for products that overflow 64 bits
+typedef unsigned __int128 uint128;
+
+static __thread long long gcd_calls; // Calls to gcd() made by this thread
+
+/**
+    This function calculates the GCD of two unsigned integers with the binary (Stein) algorithm.
+    Common factors of two are removed with one count-trailing-zeros each, and the loop only
+    subtracts and shifts, so there is no division.
+    @param u First integer
+    @param v Second integer
+    @return The GCD of u and v, or the other value if one of them is zero
+ */
+static unsigned long long binary_gcd(unsigned long long u, unsigned long long v)
+{
+    if (u == 0 || v == 0) {
+        return u | v;
+    }
+    int shift = __builtin_ctzll(u | v);
+    u >>= __builtin_ctzll(u);
+    v >>= __builtin_ctzll(v);
+    while (u != v) {
+        // Both are odd here, so their difference is even; keep the smaller and the odd part of the difference
+        unsigned long long diff = u > v ? u - v : v - u;
+        v = u < v ? u : v;
+        u = diff >> __builtin_ctzll(diff);
+    }
+    return u << shift;
+}
+
 /**
-    This function is used to calculate the GCD of two integers using the Euclidean algorithm. 
+    This function counts the trailing zero bits of a nonzero 128-bit value.
+    @param x Value to check
+    @return Number of trailing zero bits
+ */
+static int ctz128(uint128 x)
+{
+    unsigned long long low = (unsigned long long)x;
+    return low != 0 ? __builtin_ctzll(low) : 64 + __builtin_ctzll((unsigned long long)(x >> 64));
+}
+
+/**
+    This function is the 128-bit version of binary_gcd, used when an intermediate does not fit in 64 bits.
+    @param u First integer
+    @param v Second integer
+    @return The GCD of u and v, or the other value if one of them is zero
+ */
+static uint128 binary_gcd128(uint128 u, uint128 v)
+{
+    if (u == 0 || v == 0) {
+        return u | v;
+    }
+    int shift = ctz128(u | v);
+    u >>= ctz128(u);
+    v >>= ctz128(v);
+    while (u != v) {
+        uint128 diff = u > v ? u - v : v - u;
+        v = u < v ? u : v;
+        u = diff >> ctz128(diff);
+    }
+    return u << shift;
+}
+
+/**
+    This function is used to calculate the GCD of two integers.
     If either a or b is negative, it is treated as its absolute value.
     @param a First integer
     @param b Second integer
@@ -17,22 +83,86 @@
  */
 int64 gcd(int64 a, int64 b) 
 {
-    // Handle negative values by converting them to positive
-    if (a < 0) a = -a;
-    if (b < 0) b = -b;
+    // Handle negative values by converting them to positive, without overflowing on INT64_MIN
+    unsigned long long u = a < 0 ? 0ULL - (unsigned long long)a : (unsigned long long)a;
+    unsigned long long v = b < 0 ? 0ULL - (unsigned long long)b : (unsigned long long)b;
 
-    // If b is zero, gcd(a, b) is either a (if a != 0) or undefined if a is also zero
-    if (b == 0) {
-        if (a != 0) {
-            return a;
-        } else {
-            fprintf(stderr, "Error: gcd(0, 0) is undefined.\n");
-            exit(EXIT_FAILURE);
-        }
+    // gcd(0, 0) is undefined
+    if (u == 0 && v == 0) {
+        fprintf(stderr, "Error: gcd(0, 0) is undefined.\n");
+        exit(EXIT_FAILURE);
+    }
+    gcd_calls++;
+    return (int64)binary_gcd(u, v);
+}
+
+/**
+    This function returns how many times the calling thread has called gcd(), directly or through
+    the other fraction functions, so the cost of reducing fractions can be measured.
+    @return Number of gcd() calls made by this thread
+ */
+long long fraction_gcd_calls(void)
+{
+    return gcd_calls;
+}
+
+/**
+    This function stores a fraction whose numerator and denominator were computed in 128 bits.
+    It reduces the fraction there and reports an error if the reduced value still does not fit
+    in 64 bits, instead of letting it wrap around.
+    @param num Numerator
+    @param den Denominator (nonzero)
+    @param caller Name of the arithmetic function, for the error message
+    @param result Fraction to store the result
+ */
+static void store_wide(int128 num, int128 den, const char *caller, Fraction result)
+{
+    if (den < 0) {
+        num = -num;
+        den = -den;
+    }
+    uint128 g = binary_gcd128(num < 0 ? -(uint128)num : (uint128)num, (uint128)den);
+    num /= (int128)g;
+    den /= (int128)g;
+    if (num < INT64_MIN || num > INT64_MAX || den > INT64_MAX) {
+        fprintf(stderr, "Error: result does not fit in 64 bits in %s.\n", caller);
+        exit(EXIT_FAILURE);
+    }
+    result[0] = (int64)num;
+    result[1] = (int64)den;
+}
+
+/**
+    This function adds or subtracts two fractions over the least common multiple of their
+    denominators. Every step is checked for overflow; if any overflows, the sum is redone in 128 bits.
+    @param a First fraction
+    @param b Second fraction
+    @param negate_b true to compute a - b rather than a + b
+    @param caller Name of the arithmetic function, for the error message
+    @param result Fraction to store the result
+ */
+static void sum_fraction(const Fraction a, const Fraction b, bool negate_b, const char *caller, Fraction result)
+{
+    // Calculate the lcm of the denominators of a and b
+    int64 g = gcd(a[1], b[1]);
+    int64 a_scale = b[1] / g;
+    int64 b_scale = a[1] / g;
+    int64 lcm_den, a_num, b_num, sum;
+    // Scale the numerators to the common denominator and combine them
+    bool overflow = __builtin_mul_overflow(b_scale, b[1], &lcm_den) |
+                    __builtin_mul_overflow(a[0], a_scale, &a_num) |
+                    __builtin_mul_overflow(b[0], b_scale, &b_num);
+    overflow |= negate_b ? __builtin_sub_overflow(a_num, b_num, &sum) : __builtin_add_overflow(a_num, b_num, &sum);
+    if (overflow) {
+        int128 wide_b = (int128)b[0] * b_scale;
+        store_wide((int128)a[0] * a_scale + (negate_b ? -wide_b : wide_b), (int128)b_scale * b[1], caller, result);
+        return;
     }
 
-    // Use the Euclidean algorithm to find the GCD
-    return gcd(b, a % b);
+    // Store the resulting fraction
+    result[0] = sum;
+    result[1] = lcm_den;
+    simplify(result);
 }
 
 /**
@@ -114,11 +244,17 @@ void from_decimal_parts(const DecimalParts input, Fraction output)
         numerator = integer_part;
         denominator = 1;
     } else {
-        numerator = integer_part * denominator;
+        bool overflow = __builtin_mul_overflow(integer_part, denominator, &numerator);
         if (integer_part >= 0) {
-            numerator += decimal_part;
+            overflow |= __builtin_add_overflow(numerator, decimal_part, &numerator);
         } else {
-            numerator -= decimal_part;
+            overflow |= __builtin_sub_overflow(numerator, decimal_part, &numerator);
+        }
+        if (overflow) {
+            int128 wide = (int128)integer_part * denominator;
+            store_wide(integer_part >= 0 ? wide + decimal_part : wide - decimal_part, denominator,
+                       "from_decimal_parts", output);
+            return;
         }
     }
     // Store the result in the output fraction
@@ -141,17 +277,7 @@ void add_fraction(const Fraction a, const Fraction b, Fraction result)
         exit(EXIT_FAILURE);
     }
 
-    // Calculate the lcm of the denominators of a and b
-    int64 g = gcd(a[1], b[1]);
-    int64 lcm_den = (a[1] / g) * b[1];
-    // Scale the numerators to the common denominator
-    int64 a_num = a[0] * (lcm_den / a[1]);
-    int64 b_num = b[0] * (lcm_den / b[1]);
-
-    // Store the resulting fraction
-    result[0] = a_num + b_num;
-    result[1] = lcm_den;
-    simplify(result);
+    sum_fraction(a, b, false, "add_fraction", result);
 }
 
 /**
@@ -168,17 +294,7 @@ void subtract_fraction(const Fraction a, const Fraction b, Fraction result)
         exit(EXIT_FAILURE);
     }
 
-    // Calculate the lcm of the denominators of a and b
-    int64 g = gcd(a[1], b[1]);
-    int64 lcm_den = (a[1] / g) * b[1];
-    // Scale the numerators to the common denominator
-    int64 a_num = a[0] * (lcm_den / a[1]);
-    int64 b_num = b[0] * (lcm_den / b[1]);
-
-    // Store the result in the output fraction
-    result[0] = a_num - b_num;
-    result[1] = lcm_den;
-    simplify(result);
+    sum_fraction(a, b, true, "subtract_fraction", result);
 }
 
 /**
@@ -195,8 +311,14 @@ void multiply_fraction(const Fraction a, const Fraction b, Fraction result)
         exit(EXIT_FAILURE);
     }
     // Calculate the numerator and denominator for the product of two fractions.
-    result[0] = a[0] * b[0];
-    result[1] = a[1] * b[1];
+    // If either overflows, multiply in 128 bits and reduce there
+    int64 num, den;
+    if (__builtin_mul_overflow(a[0], b[0], &num) | __builtin_mul_overflow(a[1], b[1], &den)) {
+        store_wide((int128)a[0] * b[0], (int128)a[1] * b[1], "multiply_fraction", result);
+        return;
+    }
+    result[0] = num;
+    result[1] = den;
     simplify(result);
 }
 
@@ -215,15 +337,21 @@ void divide_fraction(const Fraction a, const Fraction b, Fraction result)
         exit(EXIT_FAILURE);
     }
 
-    // Claculate the numerator and denominator for the division of two fractions.
-    result[0] = a[0] * b[1];
-    result[1] = a[1] * b[0];
-
     // Check for division by zero in the denominator
-    if (result[1] == 0) {
+    if (b[0] == 0) {
         fprintf(stderr, "Error: Division by zero in divide_fraction.\n");
         exit(EXIT_FAILURE);
     }
+
+    // Claculate the numerator and denominator for the division of two fractions.
+    // If either overflows, multiply in 128 bits and reduce there
+    int64 num, den;
+    if (__builtin_mul_overflow(a[0], b[1], &num) | __builtin_mul_overflow(a[1], b[0], &den)) {
+        store_wide((int128)a[0] * b[1], (int128)a[1] * b[0], "divide_fraction", result);
+        return;
+    }
+    result[0] = num;
+    result[1] = den;
     simplify(result);
 }
 
@@ -236,3 +364,271 @@ void print_fraction(const Fraction f)
 {
     printf("%lld/%lld\n", f[0], f[1]);
 }
+
+/**
+    This function converts DecimalParts into a fraction over 10^decimal_length without reducing it.
+    If the numerator would overflow, it falls back to from_decimal_parts, which reduces.
+    @param input DecimalParts to convert
+    @param output Fraction to store the result
+ */
+void from_decimal_parts_unreduced(const DecimalParts input, Fraction output)
+{
+    int64 integer_part = input[0];
+    int64 decimal_part = input[1];
+    int64 decimal_length = input[2];
+    if (decimal_length <= 0 || decimal_length > 15) {
+        from_decimal_parts(input, output);
+        return;
+    }
+
+    int64 denominator = 1;
+    for (int i = 0; i < decimal_length; ++i) {
+        denominator *= 10;
+    }
+    int64 numerator;
+    bool overflow = __builtin_mul_overflow(integer_part, denominator, &numerator);
+    if (integer_part >= 0) {
+        overflow |= __builtin_add_overflow(numerator, decimal_part, &numerator);
+    } else {
+        overflow |= __builtin_sub_overflow(numerator, decimal_part, &numerator);
+    }
+    if (overflow) {
+        from_decimal_parts(input, output);
+        return;
+    }
+    output[0] = numerator;
+    output[1] = denominator;
+}
+
+/**
+    This function adds or subtracts two fractions without reducing the result. Fractions with the
+    same denominator only need their numerators combined; others are cross multiplied. If that
+    would overflow, the operands are reduced and the reducing version is used instead.
+    @param a First fraction
+    @param b Second fraction
+    @param negate_b true to compute a - b rather than a + b
+    @param result Fraction to store the result
+ */
+static void sum_fraction_unreduced(const Fraction a, const Fraction b, bool negate_b, Fraction result)
+{
+    int64 num, den, a_num = a[0], b_num = b[0];
+    bool overflow = false;
+    den = a[1];
+    if (a[1] != b[1]) {
+        overflow = __builtin_mul_overflow(a[0], b[1], &a_num) | __builtin_mul_overflow(b[0], a[1], &b_num) |
+                   __builtin_mul_overflow(a[1], b[1], &den);
+    }
+    overflow |= negate_b ? __builtin_sub_overflow(a_num, b_num, &num) : __builtin_add_overflow(a_num, b_num, &num);
+    if (overflow) {
+        Fraction x, y;
+        make_fraction(a, x);
+        make_fraction(b, y);
+        sum_fraction(x, y, negate_b, negate_b ? "subtract_fraction" : "add_fraction", result);
+        return;
+    }
+    result[0] = num;
+    result[1] = den;
+}
+
+/**
+    This function adds two fractions without reducing the result. Call simplify() once the result
+    is final.
+    @param a First fraction
+    @param b Second fraction
+    @param result Fraction to store the result
+ */
+void add_fraction_unreduced(const Fraction a, const Fraction b, Fraction result)
+{
+    // Check if the denominator of either fraction is zero
+    if (a[1] == 0 || b[1] == 0) {
+        fprintf(stderr, "Error: invalid input (zero denominator) in add_fraction.\n");
+        exit(EXIT_FAILURE);
+    }
+    sum_fraction_unreduced(a, b, false, result);
+}
+
+/**
+    This function subtracts one fraction from another without reducing the result. Call simplify()
+    once the result is final.
+    @param a First fraction
+    @param b Second fraction
+    @param result Fraction to store the result
+ */
+void subtract_fraction_unreduced(const Fraction a, const Fraction b, Fraction result)
+{
+    // Check if the denominator of either fraction is zero
+    if (a[1] == 0 || b[1] == 0) {
+        fprintf(stderr, "Error: invalid input (zero denominator) in subtract_fraction.\n");
+        exit(EXIT_FAILURE);
+    }
+    sum_fraction_unreduced(a, b, true, result);
+}
+
+/**
+    This function multiplies two fractions without reducing the result. If a product would
+    overflow, it uses multiply_fraction, which reduces. Call simplify() once the result is final.
+    @param a First fraction
+    @param b Second fraction
+    @param result Fraction to store the result
+ */
+void multiply_fraction_unreduced(const Fraction a, const Fraction b, Fraction result)
+{
+    int64 num, den;
+    if (a[1] == 0 || b[1] == 0 ||
+        __builtin_mul_overflow(a[0], b[0], &num) | __builtin_mul_overflow(a[1], b[1], &den)) {
+        multiply_fraction(a, b, result);
+        return;
+    }
+    result[0] = num;
+    result[1] = den;
+}
+
+/**
+    This function divides one fraction by another without reducing the result. The denominator
+    of the result may be negative. If a product would overflow, it uses divide_fraction, which
+    reduces. Call simplify() once the result is final.
+    @param a First fraction
+    @param b Second fraction
+    @param result Fraction to store the result
+ */
+void divide_fraction_unreduced(const Fraction a, const Fraction b, Fraction result)
+{
+    int64 num, den;
+    if (a[1] == 0 || b[1] == 0 || b[0] == 0 ||
+        __builtin_mul_overflow(a[0], b[1], &num) | __builtin_mul_overflow(a[1], b[0], &den)) {
+        divide_fraction(a, b, result);
+        return;
+    }
+    result[0] = num;
+    result[1] = den;
+}
+
+/**
+    This function finds the fraction closest to f whose denominator is at most max_denominator.
+    It walks the continued fraction expansion of f until the next convergent's denominator would
+    exceed the bound, then picks between the last convergent and the largest semiconvergent that
+    fits. The distances of the two candidates from f are the remainders of the expansion, so they
+    are compared exactly without calling gcd(). The result is in lowest terms; a tie goes to the
+    convergent, which has the smaller denominator.
+    @param f Fraction to approximate (the denominator may be negative)
+    @param max_denominator Largest allowed denominator (at least 1)
+    @param result Fraction to store the result
+ */
+void best_approximation(const Fraction f, int64 max_denominator, Fraction result)
+{
+    // Check the denominator and the bound
+    if (f[1] == 0) {
+        fprintf(stderr, "Error: invalid input (zero denominator) in best_approximation.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (max_denominator < 1) {
+        fprintf(stderr, "Error: invalid denominator bound %lld in best_approximation.\n", max_denominator);
+        exit(EXIT_FAILURE);
+    }
+
+    bool negative = (f[0] < 0) != (f[1] < 0);
+    unsigned long long n = f[0] < 0 ? 0ULL - (unsigned long long)f[0] : (unsigned long long)f[0];
+    unsigned long long d = f[1] < 0 ? 0ULL - (unsigned long long)f[1] : (unsigned long long)f[1];
+    unsigned long long max = (unsigned long long)max_denominator;
+
+    // p0/q0 and p1/q1 are the last two convergents. Their distances from f are n and d over q * |f[1]|
+    unsigned long long p0 = 0, q0 = 1, p1 = 1, q1 = 0;
+    while (d != 0) {
+        unsigned long long a = n / d;
+        unsigned long long q2;
+        if (__builtin_mul_overflow(a, q1, &q2) || __builtin_add_overflow(q2, q0, &q2) || q2 > max) {
+            break;
+        }
+        unsigned long long p2 = p0 + a * p1;
+        p0 = p1;
+        q0 = q1;
+        p1 = p2;
+        q1 = q2;
+        unsigned long long r = n - a * d;
+        n = d;
+        d = r;
+    }
+
+    // If the expansion did not end, the largest semiconvergent under the bound may be closer
+    unsigned long long p = p1, q = q1;
+    if (d != 0) {
+        unsigned long long k = (max - q0) / q1;
+        unsigned long long semi_q = q0 + k * q1;
+        if ((uint128)(n - k * d) * q1 < (uint128)d * semi_q) {
+            p = p0 + k * p1;
+            q = semi_q;
+        }
+    }
+    if (p > (unsigned long long)INT64_MAX) {
+        fprintf(stderr, "Error: integer overflow in best_approximation.\n");
+        exit(EXIT_FAILURE);
+    }
+    result[0] = negative ? -(int64)p : (int64)p;
+    result[1] = (int64)q;
+}
+
+/**
+    This function converts a double into the closest fraction whose denominator is at most
+    max_denominator. A finite double is exactly an integer times a power of two, so that value is
+    used as is when its denominator fits in 62 bits; a value with more binary places than that is
+    first rounded to a multiple of 2^-62. The result is then bounded with best_approximation.
+    @param x Value to convert
+    @param max_denominator Largest allowed denominator (at least 1)
+    @param result Fraction to store the result
+ */
+void double_to_fraction(double x, int64 max_denominator, Fraction result)
+{
+    // Split the double into its sign, exponent, and 53-bit significand
+    unsigned long long bits;
+    memcpy(&bits, &x, sizeof(bits));
+    bool negative = bits >> 63;
+    int exponent = (int)((bits >> 52) & 0x7ff);
+    unsigned long long significand = bits & ((1ULL << 52) - 1);
+    if (exponent == 0x7ff) {
+        fprintf(stderr, "Error: value is not finite in double_to_fraction.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (exponent != 0) {
+        significand |= 1ULL << 52;
+    } else {
+        exponent = 1;
+    }
+
+    // x = significand * 2^power
+    int power = exponent - 1075;
+    Fraction exact = {0, 1};
+    if (significand != 0 && power >= 0) {
+        if (power > 63 - 53 || (significand << power) > (unsigned long long)INT64_MAX) {
+            fprintf(stderr, "Error: value out of range in double_to_fraction.\n");
+            exit(EXIT_FAILURE);
+        }
+        exact[0] = (int64)(significand << power);
+    } else if (significand != 0) {
+        int shift = -power;
+        int zeros = __builtin_ctzll(significand);
+        if (zeros > shift) {
+            zeros = shift;
+        }
+        significand >>= zeros;
+        shift -= zeros;
+        if (shift > 62) {
+            // Round to the nearest multiple of 2^-62, ties to even
+            int drop = shift - 62;
+            if (drop > 53) {
+                significand = 0;
+            } else {
+                unsigned long long kept = significand >> drop;
+                unsigned long long half = 1ULL << (drop - 1);
+                unsigned long long rest = significand & ((half << 1) - 1);
+                significand = kept + (rest > half || (rest == half && (kept & 1)));
+            }
+            shift = 62;
+        }
+        exact[0] = (int64)significand;
+        exact[1] = 1LL << shift;
+    }
+    if (negative) {
+        exact[0] = -exact[0];
+    }
+    best_approximation(exact, max_denominator, result);
+}
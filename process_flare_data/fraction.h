@@ -2,6 +2,8 @@
      @file fraction.h
      This header file define functions for handling fractions, including conversion from decimal parts, arithmetic operations, and simplifications.
  */
+#ifndef FRACTION_H
+#define FRACTION_H
 
 typedef long long int64;
 typedef int64 Fraction[2];   // [numerator, denominator]
@@ -33,3 +35,32 @@ void simplify(Fraction f);
 
 // Greatest common divisor (still raw int64s)
 int64 gcd(int64 a, int64 b);
+
+// Number of gcd() calls made so far by the calling thread
+long long fraction_gcd_calls(void);
+
+// The _unreduced functions skip simplify(), so a chain of operations can reduce once at the end.
+// They only reduce early when a result would otherwise overflow
+
+// Convert a decimal number to a fraction over 10^decimal_length, without reducing it
+void from_decimal_parts_unreduced(const DecimalParts input, Fraction output);
+
+// Add two fractions without reducing: a + b → result
+void add_fraction_unreduced(const Fraction a, const Fraction b, Fraction result);
+
+// Subtract two fractions without reducing: a - b → result
+void subtract_fraction_unreduced(const Fraction a, const Fraction b, Fraction result);
+
+// Multiply two fractions without reducing: a * b → result
+void multiply_fraction_unreduced(const Fraction a, const Fraction b, Fraction result);
+
+// Divide two fractions without reducing: a / b → result
+void divide_fraction_unreduced(const Fraction a, const Fraction b, Fraction result);
+
+// Find the closest fraction to f with a denominator of at most max_denominator → result
+void best_approximation(const Fraction f, int64 max_denominator, Fraction result);
+
+// Convert a double to the closest fraction with a denominator of at most max_denominator → result
+void double_to_fraction(double x, int64 max_denominator, Fraction result);
+
+#endif
@@ -0,0 +1,345 @@
+/**
+     @file fraction.hpp
+     This header file defines Rational<T>, a header-only C++ version of the fraction functions in
+     fraction.c. Every function is constexpr, so calls inline and constant values fold at compile
+     time. The results are the same as the C functions: values are kept in lowest terms with a
+     positive denominator, and sums use the least common multiple of the denominators. A step that
+     overflows T is redone in a wider type (int64 for int32, __int128 for int64); only a reduced
+     result that still does not fit is an error. Where the C functions print an error and exit,
+     these throw std::domain_error or std::overflow_error. Requires C++14.
+ */
+#ifndef FRACTION_HPP
+#define FRACTION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+extern "C" {
+#include "fraction.h"
+}
+
+namespace flare {
+
+// Wider type used when a step overflows T, chosen by the size of T. __int128 has none
+template <typename T, std::size_t Size = sizeof(T)>
+struct RationalTraits;
+
+template <typename T>
+struct RationalTraits<T, 4> {
+    using Unsigned = std::uint32_t;
+    using Wide = std::int64_t;
+    static constexpr bool has_wide = true;
+};
+
+template <typename T>
+struct RationalTraits<T, 8> {
+    using Unsigned = unsigned long long;
+    using Wide = __int128;
+    static constexpr bool has_wide = true;
+};
+
+template <typename T>
+struct RationalTraits<T, 16> {
+    using Unsigned = unsigned __int128;
+    using Wide = __int128;
+    static constexpr bool has_wide = false;
+};
+
+namespace detail {
+
+/**
+    These functions count the trailing zero bits of a nonzero unsigned value.
+    @param x Value to check
+    @return Number of trailing zero bits
+ */
+constexpr int trailing_zeros(std::uint32_t x) { return __builtin_ctz(x); }
+constexpr int trailing_zeros(unsigned long long x) { return __builtin_ctzll(x); }
+constexpr int trailing_zeros(unsigned __int128 x)
+{
+    unsigned long long low = static_cast<unsigned long long>(x);
+    return low != 0 ? __builtin_ctzll(low) : 64 + __builtin_ctzll(static_cast<unsigned long long>(x >> 64));
+}
+
+/**
+    This function returns the magnitude of a signed value as an unsigned one, exact for the most
+    negative value.
+    @param x Value
+    @return |x|
+ */
+template <typename T, typename U = typename RationalTraits<T>::Unsigned>
+constexpr U magnitude(T x)
+{
+    return x < 0 ? U(0) - static_cast<U>(x) : static_cast<U>(x);
+}
+
+/**
+    This function calculates a GCD with the binary (Stein) algorithm, as gcd() in fraction.c does.
+    @param u First magnitude
+    @param v Second magnitude
+    @return The GCD of u and v, or the other value if one of them is zero
+ */
+template <typename U>
+constexpr U binary_gcd(U u, U v)
+{
+    if (u == 0 || v == 0) {
+        return u | v;
+    }
+    int shift = trailing_zeros(u | v);
+    u >>= trailing_zeros(u);
+    v >>= trailing_zeros(v);
+    while (u != v) {
+        U diff = u > v ? u - v : v - u;
+        v = u < v ? u : v;
+        u = diff >> trailing_zeros(diff);
+    }
+    return u << shift;
+}
+
+/**
+    This function narrows a reduced value computed in a wider type.
+    @param v Value
+    @return v as T
+    @throw std::overflow_error if v does not fit in T
+ */
+template <typename T, typename W>
+constexpr T narrow(W v)
+{
+    T t = static_cast<T>(v);
+    if (static_cast<W>(t) != v) {
+        throw std::overflow_error("result does not fit in the rational type");
+    }
+    return t;
+}
+
+} // namespace detail
+
+/**
+    This function calculates the GCD of two integers, treating negative values as their magnitude.
+    @param a First integer
+    @param b Second integer
+    @return The greatest common divisor (GCD) of a and b
+    @throw std::domain_error if both are zero
+ */
+template <typename T>
+constexpr T gcd(T a, T b)
+{
+    using U = typename RationalTraits<T>::Unsigned;
+    if (a == 0 && b == 0) {
+        throw std::domain_error("gcd(0, 0) is undefined");
+    }
+    return static_cast<T>(detail::binary_gcd<U>(detail::magnitude(a), detail::magnitude(b)));
+}
+
+template <typename T>
+class Rational {
+public:
+    using Wide = typename RationalTraits<T>::Wide;
+
+    /**
+        This constructor makes a fraction and simplifies it, like make_fraction.
+        @param num Numerator
+        @param den Denominator
+        @throw std::domain_error if den is zero
+     */
+    constexpr Rational(T num = 0, T den = 1) : num_(num), den_(den)
+    {
+        if (den == 0) {
+            throw std::domain_error("invalid input (zero denominator) in make_fraction");
+        }
+        simplify();
+    }
+
+    /**
+        This function converts an integer part and a decimal part into a fraction, like from_decimal_parts.
+        @param integer_part Integer part
+        @param decimal_part Digits after the point, as an integer
+        @param decimal_length Number of digits after the point (0 - 15)
+        @return The simplified fraction
+        @throw std::domain_error if the decimal length is invalid
+     */
+    static constexpr Rational from_decimal(T integer_part, T decimal_part, int decimal_length)
+    {
+        if (decimal_length < 0 || decimal_length > 15) {
+            throw std::domain_error("invalid decimal length in from_decimal_parts");
+        }
+        if (decimal_length == 0) {
+            return Rational(integer_part, 1);
+        }
+        Wide denominator = 1;
+        for (int i = 0; i < decimal_length; ++i) {
+            denominator *= 10;
+        }
+        // The decimal part moves the value away from zero. Only __int128, which has no wider type, can overflow here
+        Wide numerator = 0;
+        Wide decimal = integer_part >= 0 ? static_cast<Wide>(decimal_part) : -static_cast<Wide>(decimal_part);
+        if (__builtin_mul_overflow(static_cast<Wide>(integer_part), denominator, &numerator) |
+            __builtin_add_overflow(numerator, decimal, &numerator)) {
+            throw std::overflow_error("result does not fit in the rational type");
+        }
+        return reduce_wide(numerator, denominator);
+    }
+
+    // Numerator, with the sign of the value
+    constexpr T num() const { return num_; }
+
+    // Denominator, always positive
+    constexpr T den() const { return den_; }
+
+    /**
+        This function adds two fractions over the least common multiple of their denominators, like add_fraction.
+        @param b Second fraction
+        @return The simplified sum
+     */
+    constexpr Rational operator+(const Rational &b) const { return sum(b, false); }
+
+    /**
+        This function subtracts a fraction, like subtract_fraction.
+        @param b Second fraction
+        @return The simplified difference
+     */
+    constexpr Rational operator-(const Rational &b) const { return sum(b, true); }
+
+    /**
+        This function multiplies two fractions, like multiply_fraction.
+        @param b Second fraction
+        @return The simplified product
+     */
+    constexpr Rational operator*(const Rational &b) const
+    {
+        T num = 0, den = 0;
+        if (__builtin_mul_overflow(num_, b.num_, &num) | __builtin_mul_overflow(den_, b.den_, &den)) {
+            require_wide();
+            return reduce_wide(static_cast<Wide>(num_) * b.num_, static_cast<Wide>(den_) * b.den_);
+        }
+        return Rational(num, den);
+    }
+
+    /**
+        This function divides by a fraction, like divide_fraction.
+        @param b Divisor
+        @return The simplified quotient
+        @throw std::domain_error if b is zero
+     */
+    constexpr Rational operator/(const Rational &b) const
+    {
+        if (b.num_ == 0) {
+            throw std::domain_error("Division by zero in divide_fraction");
+        }
+        T num = 0, den = 0;
+        if (__builtin_mul_overflow(num_, b.den_, &num) | __builtin_mul_overflow(den_, b.num_, &den)) {
+            require_wide();
+            return reduce_wide(static_cast<Wide>(num_) * b.den_, static_cast<Wide>(den_) * b.num_);
+        }
+        return Rational(num, den);
+    }
+
+    constexpr Rational &operator+=(const Rational &b) { return *this = *this + b; }
+    constexpr Rational &operator-=(const Rational &b) { return *this = *this - b; }
+    constexpr Rational &operator*=(const Rational &b) { return *this = *this * b; }
+    constexpr Rational &operator/=(const Rational &b) { return *this = *this / b; }
+
+    // Fractions in lowest terms are equal exactly when their parts are
+    constexpr bool operator==(const Rational &b) const { return num_ == b.num_ && den_ == b.den_; }
+    constexpr bool operator!=(const Rational &b) const { return !(*this == b); }
+
+private:
+    T num_, den_;
+
+    /**
+        This function simplifies the fraction in place, like simplify.
+        @throw std::overflow_error if the sign cannot be moved to the numerator
+     */
+    constexpr void simplify()
+    {
+        if (den_ < 0) {
+            if (__builtin_sub_overflow(T(0), num_, &num_) | __builtin_sub_overflow(T(0), den_, &den_)) {
+                throw std::overflow_error("result does not fit in the rational type");
+            }
+        }
+        T g = gcd(num_, den_);
+        if (g > 1) {
+            num_ /= g;
+            den_ /= g;
+        }
+    }
+
+    /**
+        This function checks that a step that overflowed T can be redone in the wide type.
+        @throw std::overflow_error if T has no wider type
+     */
+    static constexpr void require_wide()
+    {
+        if (!RationalTraits<T>::has_wide) {
+            throw std::overflow_error("result does not fit in the rational type");
+        }
+    }
+
+    /**
+        This function reduces a fraction computed in the wide type and narrows it to T.
+        @param num Numerator
+        @param den Denominator (nonzero)
+        @return The simplified fraction
+        @throw std::overflow_error if the reduced value does not fit
+     */
+    static constexpr Rational reduce_wide(Wide num, Wide den)
+    {
+        if (den < 0) {
+            num = -num;
+            den = -den;
+        }
+        Wide g = gcd(num, den);
+        return Rational(detail::narrow<T>(num / g), detail::narrow<T>(den / g));
+    }
+
+    /**
+        This function adds or subtracts over the least common multiple of the denominators, redoing
+        the sum in the wide type if any step overflows.
+        @param b Second fraction
+        @param negate_b true to subtract b
+        @return The simplified result
+     */
+    constexpr Rational sum(const Rational &b, bool negate_b) const
+    {
+        T g = gcd(den_, b.den_);
+        T a_scale = b.den_ / g;
+        T b_scale = den_ / g;
+        T den = 0, a_num = 0, b_num = 0, num = 0;
+        bool overflow = __builtin_mul_overflow(b_scale, b.den_, &den) |
+                        __builtin_mul_overflow(num_, a_scale, &a_num) |
+                        __builtin_mul_overflow(b.num_, b_scale, &b_num);
+        overflow |= negate_b ? __builtin_sub_overflow(a_num, b_num, &num) : __builtin_add_overflow(a_num, b_num, &num);
+        if (overflow) {
+            require_wide();
+            Wide wide_b = static_cast<Wide>(b.num_) * b_scale;
+            return reduce_wide(static_cast<Wide>(num_) * a_scale + (negate_b ? -wide_b : wide_b),
+                               static_cast<Wide>(b_scale) * b.den_);
+        }
+        return Rational(num, den);
+    }
+};
+
+/**
+    This function converts a C Fraction into a Rational<int64>.
+    @param f Fraction to convert
+    @return The simplified rational
+ */
+constexpr Rational<int64> from_fraction(const Fraction f)
+{
+    return Rational<int64>(f[0], f[1]);
+}
+
+/**
+    This function stores a Rational<int64> into a C Fraction.
+    @param r Rational to store
+    @param f Fraction to store it in
+ */
+constexpr void to_fraction(const Rational<int64> &r, Fraction f)
+{
+    f[0] = r.num();
+    f[1] = r.den();
+}
+
+} // namespace flare
+
+#endif
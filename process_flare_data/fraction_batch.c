@@ -0,0 +1,274 @@
+/**
+    @file fraction_batch.c
+    This program provides batch versions of the fraction functions for columns of fractions held as
+    separate numerator and denominator arrays. The element loops have no branches and no calls: signs
+    are handled with masks, overflow is found by splitting products into 32-bit halves, and problems
+    are recorded as status flags rather than by exiting, so the compiler can vectorize them. Results
+    are left unreduced; simplify_fractions reduces them afterwards in its own pass.
+ */
+#include "fraction_batch.h"
+
+// Build the element loops twice, for AVX2 and for the baseline instruction set, and pick one at
+// load time. 64-bit compares need SSE4.2 or later, so the baseline build stays scalar
+#define VECTOR_LOOP __attribute__((target_clones("avx2", "default")))
+
+/**
+    This function returns the magnitude of an integer as an unsigned value, without a branch.
+    @param x Integer
+    @return |x|, which is exact even for the most negative value
+ */
+static inline unsigned long long magnitude(int64 x)
+{
+    unsigned long long mask = (unsigned long long)(x >> 63);
+    return ((unsigned long long)x ^ mask) - mask;
+}
+
+/**
+    This function multiplies two magnitudes and checks whether the product is below 2^63, using
+    only operations that exist on vector registers.
+    @param u First magnitude
+    @param v Second magnitude
+    @param fits Set to 1 if the product is below 2^63, 0 otherwise
+    @return The product, modulo 2^64
+ */
+static inline unsigned long long multiply_magnitudes(unsigned long long u, unsigned long long v,
+                                                     unsigned long long *fits)
+{
+    unsigned long long u_high = u >> 32, u_low = u & 0xFFFFFFFFULL;
+    unsigned long long v_high = v >> 32, v_low = v & 0xFFFFFFFFULL;
+
+    // If both high halves are nonzero the product is at least 2^64. Otherwise one cross term is zero
+    unsigned long long cross = u_high * v_low + u_low * v_high;
+    unsigned long long low = u_low * v_low;
+    unsigned long long product = low + (cross << 32);
+    *fits = (unsigned long long)((u_high == 0) | (v_high == 0)) & ((cross >> 31) == 0) &
+            (product >= low) & ((product >> 63) == 0);
+    return u * v;
+}
+
+/**
+    This function multiplies two signed integers with an overflow check.
+    @param x First integer
+    @param y Second integer
+    @param fits Set to 1 if the product fits in 64 bits, 0 otherwise
+    @return The product when it fits
+ */
+static inline int64 checked_product(int64 x, int64 y, unsigned long long *fits)
+{
+    unsigned long long product = multiply_magnitudes(magnitude(x), magnitude(y), fits);
+    unsigned long long negative = (unsigned long long)((x ^ y) >> 63);
+    return (int64)((product ^ negative) - negative);
+}
+
+/**
+    This function stores one result with a positive denominator and records its status.
+    @param n_value Numerator
+    @param d_value Denominator
+    @param fits 1 if every step fit in 64 bits
+    @param num Where to store the numerator
+    @param den Where to store the denominator
+    @param status Status flags to update
+ */
+static inline void store_result(int64 n_value, int64 d_value, unsigned long long fits,
+                                int64 *num, int64 *den, unsigned char *status)
+{
+    // If the denominator is negative, negate both numerator and denominator
+    unsigned long long negative = (unsigned long long)(d_value >> 63);
+    *num = (int64)(((unsigned long long)n_value ^ negative) - negative);
+    *den = (int64)(((unsigned long long)d_value ^ negative) - negative);
+    *status |= (unsigned char)((d_value == 0) * FRACTION_ZERO_DENOMINATOR | (fits ^ 1) * FRACTION_OVERFLOW);
+}
+
+/**
+    This function converts columns of decimal parts into fractions over 10^decimal_length, the same
+    way from_decimal_parts does for one value, but without reducing them.
+    @param integer_part Integer parts
+    @param decimal_part Decimal parts
+    @param decimal_length Number of decimal digits, shared by every element
+    @param num Numerators of the results
+    @param den Denominators of the results
+    @param status Status flags of each element
+    @param n Number of elements
+ */
+VECTOR_LOOP void decimal_fractions(const int64 *restrict integer_part, const int64 *restrict decimal_part,
+                                   int64 decimal_length, int64 *restrict num, int64 *restrict den,
+                                   unsigned char *restrict status, size_t n)
+{
+    // A length outside 0 - 15 makes every element invalid
+    if (decimal_length < 0 || decimal_length > 15) {
+        for (size_t i = 0; i < n; i++) {
+            status[i] |= FRACTION_INVALID;
+        }
+        return;
+    }
+    int64 denominator = 1;
+    for (int i = 0; i < decimal_length; ++i) {
+        denominator *= 10;
+    }
+    // With no decimal digits the decimal part is ignored
+    unsigned long long keep_decimal = decimal_length != 0 ? ~0ULL : 0;
+
+    for (size_t i = 0; i < n; i++) {
+        unsigned long long fits;
+        int64 scaled = checked_product(integer_part[i], denominator, &fits);
+
+        // The decimal part moves the value away from zero, so it is subtracted from a negative integer part
+        unsigned long long negative = (unsigned long long)(integer_part[i] >> 63);
+        unsigned long long term = ((((unsigned long long)decimal_part[i] ^ negative) - negative)) & keep_decimal;
+        unsigned long long sum = (unsigned long long)scaled + term;
+        fits &= ((((unsigned long long)scaled ^ sum) & (term ^ sum)) >> 63) ^ 1;
+        store_result((int64)sum, denominator, fits, &num[i], &den[i], &status[i]);
+    }
+}
+
+/**
+    This function adds or subtracts columns of fractions by cross multiplication.
+    @param a_num Numerators of the first operands
+    @param a_den Denominators of the first operands
+    @param b_num Numerators of the second operands
+    @param b_den Denominators of the second operands
+    @param negate_b ~0 to subtract the second operands, 0 to add them
+    @param num Numerators of the results
+    @param den Denominators of the results
+    @param status Status flags of each element
+    @param n Number of elements
+ */
+VECTOR_LOOP static void sum_columns(const int64 *restrict a_num, const int64 *restrict a_den,
+                                    const int64 *restrict b_num, const int64 *restrict b_den,
+                                    unsigned long long negate_b, int64 *restrict num, int64 *restrict den,
+                                    unsigned char *restrict status, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        unsigned long long fits_a, fits_b, fits_den;
+        unsigned long long a_term = (unsigned long long)checked_product(a_num[i], b_den[i], &fits_a);
+        unsigned long long b_term = (unsigned long long)checked_product(b_num[i], a_den[i], &fits_b);
+        int64 d_value = checked_product(a_den[i], b_den[i], &fits_den);
+
+        // Negate the second term to subtract, then detect a sum whose sign differs from both terms
+        b_term = (b_term ^ negate_b) - negate_b;
+        unsigned long long sum = a_term + b_term;
+        unsigned long long fits = fits_a & fits_b & fits_den & ((((a_term ^ sum) & (b_term ^ sum)) >> 63) ^ 1);
+        store_result((int64)sum, d_value, fits, &num[i], &den[i], &status[i]);
+    }
+}
+
+/**
+    This function adds two columns of fractions element by element. Results are over the product of
+    the denominators and are not reduced.
+    @param a_num Numerators of the first operands
+    @param a_den Denominators of the first operands
+    @param b_num Numerators of the second operands
+    @param b_den Denominators of the second operands
+    @param num Numerators of the results
+    @param den Denominators of the results
+    @param status Status flags of each element
+    @param n Number of elements
+ */
+void add_fractions(const int64 *a_num, const int64 *a_den, const int64 *b_num, const int64 *b_den,
+                   int64 *num, int64 *den, unsigned char *status, size_t n)
+{
+    sum_columns(a_num, a_den, b_num, b_den, 0, num, den, status, n);
+}
+
+/**
+    This function subtracts one column of fractions from another element by element. Results are
+    over the product of the denominators and are not reduced.
+    @param a_num Numerators of the first operands
+    @param a_den Denominators of the first operands
+    @param b_num Numerators of the second operands
+    @param b_den Denominators of the second operands
+    @param num Numerators of the results
+    @param den Denominators of the results
+    @param status Status flags of each element
+    @param n Number of elements
+ */
+void subtract_fractions(const int64 *a_num, const int64 *a_den, const int64 *b_num, const int64 *b_den,
+                        int64 *num, int64 *den, unsigned char *status, size_t n)
+{
+    sum_columns(a_num, a_den, b_num, b_den, ~0ULL, num, den, status, n);
+}
+
+/**
+    This function multiplies the numerators and the denominators of two columns of fractions.
+    @param a_num Numerators of the first operands
+    @param a_den Denominators of the first operands
+    @param b_num Numerators of the second operands
+    @param b_den Denominators of the second operands
+    @param num Numerators of the results
+    @param den Denominators of the results
+    @param status Status flags of each element
+    @param n Number of elements
+ */
+VECTOR_LOOP static void product_columns(const int64 *restrict a_num, const int64 *restrict a_den,
+                                        const int64 *restrict b_num, const int64 *restrict b_den,
+                                        int64 *restrict num, int64 *restrict den, unsigned char *restrict status,
+                                        size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        unsigned long long fits_num, fits_den;
+        int64 n_value = checked_product(a_num[i], b_num[i], &fits_num);
+        int64 d_value = checked_product(a_den[i], b_den[i], &fits_den);
+        store_result(n_value, d_value, fits_num & fits_den, &num[i], &den[i], &status[i]);
+    }
+}
+
+/**
+    This function multiplies two columns of fractions element by element, without reducing the results.
+    @param a_num Numerators of the first operands
+    @param a_den Denominators of the first operands
+    @param b_num Numerators of the second operands
+    @param b_den Denominators of the second operands
+    @param num Numerators of the results
+    @param den Denominators of the results
+    @param status Status flags of each element
+    @param n Number of elements
+ */
+void multiply_fractions(const int64 *a_num, const int64 *a_den, const int64 *b_num, const int64 *b_den,
+                        int64 *num, int64 *den, unsigned char *status, size_t n)
+{
+    product_columns(a_num, a_den, b_num, b_den, num, den, status, n);
+}
+
+/**
+    This function divides one column of fractions by another element by element, without reducing
+    the results. Dividing by zero is reported as a zero denominator.
+    @param a_num Numerators of the first operands
+    @param a_den Denominators of the first operands
+    @param b_num Numerators of the second operands
+    @param b_den Denominators of the second operands
+    @param num Numerators of the results
+    @param den Denominators of the results
+    @param status Status flags of each element
+    @param n Number of elements
+ */
+void divide_fractions(const int64 *a_num, const int64 *a_den, const int64 *b_num, const int64 *b_den,
+                      int64 *num, int64 *den, unsigned char *status, size_t n)
+{
+    product_columns(a_num, a_den, b_den, b_num, num, den, status, n);
+}
+
+/**
+    This function reduces a column of fractions to lowest terms. Elements with any status flag set
+    are left as they are.
+    @param num Numerators
+    @param den Denominators (positive for valid elements)
+    @param status Status flags of each element
+    @param n Number of elements
+    @return Number of valid elements
+ */
+size_t simplify_fractions(int64 *num, int64 *den, const unsigned char *status, size_t n)
+{
+    size_t valid = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (status[i] != FRACTION_OK) {
+            continue;
+        }
+        int64 g = gcd(num[i], den[i]);
+        if (g > 1) {
+            num[i] /= g;
+            den[i] /= g;
+        }
+        valid++;
+    }
+    return valid;
+}
@@ -0,0 +1,44 @@
+/**
+     @file fraction_batch.h
+     This header file defines batch versions of the fraction functions. They work on columns of
+     fractions stored as separate numerator and denominator arrays, report problems per element
+     instead of exiting, and leave reduction to lowest terms to a separate pass. Output arrays must
+     not overlap the input arrays.
+ */
+#ifndef FRACTION_BATCH_H
+#define FRACTION_BATCH_H
+
+#include <stddef.h>
+#include "fraction.h"
+
+// Status flags of one element. Each batch function ORs its flags into the status array, so a chain
+// of calls only needs to be checked once at the end; clear the array before the first call
+#define FRACTION_OK 0               // The element holds a valid result
+#define FRACTION_ZERO_DENOMINATOR 1 // An input or result denominator was zero
+#define FRACTION_OVERFLOW 2         // A product or sum did not fit in 64 bits
+#define FRACTION_INVALID 4          // The decimal length was outside 0 - 15
+
+// Convert columns of decimal parts with one decimal length into unreduced fractions
+void decimal_fractions(const int64 *integer_part, const int64 *decimal_part, int64 decimal_length,
+                       int64 *num, int64 *den, unsigned char *status, size_t n);
+
+// Add two columns of fractions element by element, without reducing: a + b → result
+void add_fractions(const int64 *a_num, const int64 *a_den, const int64 *b_num, const int64 *b_den,
+                   int64 *num, int64 *den, unsigned char *status, size_t n);
+
+// Subtract two columns of fractions element by element, without reducing: a - b → result
+void subtract_fractions(const int64 *a_num, const int64 *a_den, const int64 *b_num, const int64 *b_den,
+                        int64 *num, int64 *den, unsigned char *status, size_t n);
+
+// Multiply two columns of fractions element by element, without reducing: a * b → result
+void multiply_fractions(const int64 *a_num, const int64 *a_den, const int64 *b_num, const int64 *b_den,
+                        int64 *num, int64 *den, unsigned char *status, size_t n);
+
+// Divide two columns of fractions element by element, without reducing: a / b → result
+void divide_fractions(const int64 *a_num, const int64 *a_den, const int64 *b_num, const int64 *b_den,
+                      int64 *num, int64 *den, unsigned char *status, size_t n);
+
+// Reduce every valid element to lowest terms, returning the number of valid elements
+size_t simplify_fractions(int64 *num, int64 *den, const unsigned char *status, size_t n);
+
+#endif
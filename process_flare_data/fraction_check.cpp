@@ -0,0 +1,189 @@
+/**
+    @file fraction_check.cpp
+    This program compares fraction.hpp with fraction.c on random operands. Each case runs an
+    operation through Rational<int64> and through the matching C function and checks that both give
+    the same fraction. Where Rational<int64> throws, the C function is run in a child process, which
+    must exit with a failure instead. It is built and run by "make check".
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "fraction.hpp"
+
+using flare::Rational;
+using R64 = Rational<int64>;
+
+#define CASES_PER_OP 5000 // Cases of each operation at each operand range
+#define DECIMAL_CASES 2000 // Cases of from_decimal_parts
+
+// Arithmetic operation of fraction.c
+typedef void (*FractionOp)(const Fraction a, const Fraction b, Fraction result);
+
+// Operation of fraction.hpp matching a FractionOp
+typedef R64 (*RationalOp)(const R64 &a, const R64 &b);
+
+static R64 add(const R64 &a, const R64 &b) { return a + b; }
+static R64 subtract(const R64 &a, const R64 &b) { return a - b; }
+static R64 multiply(const R64 &a, const R64 &b) { return a * b; }
+static R64 divide(const R64 &a, const R64 &b) { return a / b; }
+
+/**
+    This function returns the next value of a xorshift64 generator, so every run uses the same operands.
+    @param state Generator state
+    @return The next pseudo-random value
+ */
+static unsigned long long next_random(unsigned long long *state)
+{
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/**
+    This function fills a fraction with a random nonzero numerator in [-range, range] and a random
+    denominator in [1, range].
+    @param state Generator state
+    @param range Bound on the magnitude of both parts
+    @param f Fraction to fill in
+ */
+static void random_fraction(unsigned long long *state, unsigned long long range, Fraction f)
+{
+    f[0] = (int64)(next_random(state) % range) + 1;
+    if (next_random(state) & 1) {
+        f[0] = -f[0];
+    }
+    f[1] = (int64)(next_random(state) % range) + 1;
+}
+
+/**
+    This function runs a C operation in a child process, whose error message is discarded.
+    @param op Operation to run
+    @param a First operand
+    @param b Second operand
+    @return true if the child exited with a failure, as fraction.c does on an error
+ */
+static bool c_op_fails(FractionOp op, const Fraction a, const Fraction b)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        if (freopen("/dev/null", "w", stderr) == NULL) {
+            _exit(EXIT_SUCCESS);
+        }
+        Fraction result;
+        op(a, b, result);
+        _exit(EXIT_SUCCESS);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) != EXIT_SUCCESS;
+}
+
+/**
+    This function compares one operation of both versions on random operands of a given range.
+    @param name Name of the operation, for messages
+    @param c_op Operation of fraction.c
+    @param op Operation of fraction.hpp
+    @param range Bound on the magnitude of the operands' parts
+    @param state Generator state
+    @param errors Number of cases of both versions that failed together, updated
+    @return Number of cases that differ
+ */
+static int check_op(const char *name, FractionOp c_op, RationalOp op, unsigned long long range,
+                    unsigned long long *state, int *errors)
+{
+    int mismatches = 0;
+    for (int i = 0; i < CASES_PER_OP; i++) {
+        Fraction a, b, ca, cb, want;
+        random_fraction(state, range, a);
+        random_fraction(state, range, b);
+        make_fraction(a, ca);
+        make_fraction(b, cb);
+        bool thrown = false;
+        R64 got;
+        try {
+            got = op(R64(a[0], a[1]), R64(b[0], b[1]));
+        } catch (const std::exception &) {
+            thrown = true;
+        }
+        if (thrown) {
+            if (c_op_fails(c_op, ca, cb)) {
+                (*errors)++;
+                continue;
+            }
+        } else {
+            c_op(ca, cb, want);
+            if (got.num() == want[0] && got.den() == want[1]) {
+                continue;
+            }
+        }
+        if (mismatches++ < 10) {
+            printf("%s of %lld/%lld and %lld/%lld differs\n", name, a[0], a[1], b[0], b[1]);
+        }
+    }
+    return mismatches;
+}
+
+/**
+    This function compares from_decimal with from_decimal_parts on random decimal numbers of every
+    valid length.
+    @param state Generator state
+    @return Number of cases that differ
+ */
+static int check_decimal(unsigned long long *state)
+{
+    int mismatches = 0;
+    for (int i = 0; i < DECIMAL_CASES; i++) {
+        int length = (int)(next_random(state) % 16);
+        int64 limit = 1;
+        for (int k = 0; k < length; k++) {
+            limit *= 10;
+        }
+        // An integer part below 9000 in magnitude keeps the numerator within int64 at any length
+        DecimalParts parts = {(int64)(next_random(state) % 17999) - 8999,
+                              (int64)(next_random(state) % (unsigned long long)limit), length};
+        Fraction want;
+        from_decimal_parts(parts, want);
+        R64 got = R64::from_decimal(parts[0], parts[1], length);
+        if (got.num() != want[0] || got.den() != want[1]) {
+            if (mismatches++ < 10) {
+                printf("from_decimal of %lld, %lld, %d differs\n", parts[0], parts[1], length);
+            }
+        }
+    }
+    return mismatches;
+}
+
+/**
+    Program starting point. Runs every operation at several operand ranges, from values whose
+    results always fit to values whose products regularly overflow int64.
+    @return EXIT_SUCCESS if every case agrees
+ */
+int main()
+{
+    static const unsigned long long ranges[] = {1000, 1ULL << 20, 1ULL << 31, 1ULL << 40};
+    static const FractionOp c_ops[] = {add_fraction, subtract_fraction, multiply_fraction, divide_fraction};
+    static const RationalOp ops[] = {add, subtract, multiply, divide};
+    static const char *names[] = {"add", "subtract", "multiply", "divide"};
+
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    int cases = 0, mismatches = 0, errors = 0;
+    for (unsigned long long range : ranges) {
+        for (int k = 0; k < 4; k++) {
+            mismatches += check_op(names[k], c_ops[k], ops[k], range, &state, &errors);
+            cases += CASES_PER_OP;
+        }
+    }
+    mismatches += check_decimal(&state);
+    cases += DECIMAL_CASES;
+
+    printf("%d cases, %d out of range in both versions, %d differences\n", cases, errors, mismatches);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,64 @@
+/**
+    @file fraction_hpp_check.cpp
+    This file checks fraction.hpp at compile time. Each static_assert folds a Rational<T> operation
+    to a constant and compares it with the result the matching fraction.c function gives, including
+    steps that overflow T and are redone in the wider type, and round trips through the C Fraction
+    type. It is built by "make check-hpp" with -fsyntax-only, so nothing is linked or run.
+ */
+#include <cstdint>
+#include "fraction.hpp"
+
+using flare::Rational;
+using R32 = Rational<std::int32_t>;
+using R64 = Rational<int64>;
+
+/**
+    This function converts a C Fraction to a Rational<int64> and back.
+    @param num Numerator of the C fraction
+    @param den Denominator of the C fraction
+    @param want_num Numerator expected after the round trip
+    @param want_den Denominator expected after the round trip
+    @return true if the round trip gives want_num / want_den
+ */
+constexpr bool round_trip(int64 num, int64 den, int64 want_num, int64 want_den)
+{
+    Fraction in = {num, den};
+    Fraction out = {0, 0};
+    flare::to_fraction(flare::from_fraction(in), out);
+    return out[0] == want_num && out[1] == want_den;
+}
+
+// Construction simplifies and moves the sign to the numerator, like make_fraction
+static_assert(R64(6, -4) == R64(-3, 2), "make_fraction sign and reduction");
+static_assert(R64(0, -7) == R64(0, 1), "make_fraction zero");
+static_assert(R64(-8, -12).num() == 2 && R64(-8, -12).den() == 3, "make_fraction parts");
+
+// gcd treats negative values as their magnitude
+static_assert(flare::gcd<int64>(-48, 18) == 6, "gcd of a negative value");
+static_assert(flare::gcd<int64>(0, 5) == 5, "gcd with zero");
+static_assert(flare::gcd<std::int32_t>(1 << 20, 3 << 12) == 1 << 12, "gcd of powers of two");
+
+// Arithmetic, like add_fraction, subtract_fraction, multiply_fraction and divide_fraction
+static_assert(R64(1, 6) + R64(1, 10) == R64(4, 15), "add over the lcm");
+static_assert(R64(1, 6) - R64(1, 10) == R64(1, 15), "subtract over the lcm");
+static_assert(R64(-3, 4) * R64(8, 9) == R64(-2, 3), "multiply");
+static_assert(R64(3, 4) / R64(-9, 8) == R64(-2, 3), "divide by a negative");
+
+// from_decimal splits like from_decimal_parts, the decimal part taking the sign of the integer part
+static_assert(R64::from_decimal(28, 137, 3) == R64(28137, 1000), "positive decimal");
+static_assert(R64::from_decimal(-1, 946, 3) == R64(-973, 500), "negative decimal");
+static_assert(R64::from_decimal(4754, 9472693032, 10) == R64(5943684086629, 1250000000), "flare list average");
+static_assert(R64::from_decimal(7, 0, 0) == R64(7, 1), "no decimals");
+
+// Steps that overflow T are redone in the wider type; only the reduced result has to fit
+static_assert(R32(INT32_MAX, 2) + R32(INT32_MAX, 2) == R32(INT32_MAX, 1), "int32 sum widened to int64");
+static_assert(R32(INT32_MAX, 3) * R32(3, INT32_MAX) == R32(1, 1), "int32 product widened to int64");
+static_assert(R64(INT64_MAX, 3) * R64(3, INT64_MAX) == R64(1, 1), "int64 product widened to __int128");
+static_assert(R64(1, INT64_MAX) - R64(1, INT64_MAX) == R64(0, 1), "int64 difference widened to __int128");
+static_assert(R64(INT64_MAX, 2) / R64(INT64_MAX, 4) == R64(2, 1), "int64 quotient widened to __int128");
+
+// Round trips through the C Fraction type
+static_assert(round_trip(3, 4, 3, 4), "reduced fraction");
+static_assert(round_trip(10, -4, -5, 2), "fraction simplified on the way in");
+static_assert(round_trip(INT64_MAX, 1, INT64_MAX, 1), "largest numerator");
+static_assert(round_trip(0, 9, 0, 1), "zero");
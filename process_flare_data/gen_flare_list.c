@@ -0,0 +1,260 @@
+/**
+    @file gen_flare_list.c
+    This program writes a synthetic flare list in the exact layout of the Fermi GBM lists, with any
+    number of rows, for benchmarking. Values follow the distributions of the bundled lists: log-
+    normal durations, peaks, and rate-to-peak ratios, a peak early in the flare, and four sunward
+    detectors. Start times only move forward, with gaps shortened when needed so that a very long
+    list still ends before the year 10000. A chosen fraction of lines can be made malformed in ways
+    that both readers skip with a line format warning. The same seed always gives the same file.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define START_DAY 14105        // Days from 1970-01-01 to 14-Aug-2008, the first GBM flare list day
+#define LAST_DAY 2932896       // Days from 1970-01-01 to 31-Dec-9999
+#define MEAN_GAP_SEC 10800.0   // Usual mean time between flare starts
+#define MAX_DURATION_SEC 7200  // Longest flare generated
+#define MAX_TOTAL_COUNT 9e8    // Largest average rate times duration generated
+#define OUT_BUFFER_SIZE (1 << 20) // Bytes of output collected before a write
+
+typedef struct {
+    uint64_t state; // splitmix64 state
+} Rng;
+
+/**
+    Returns the next 64 random bits (splitmix64).
+    @param rng the generator
+    @return random bits
+ */
+static uint64_t rng_next(Rng *rng) {
+    uint64_t z = (rng->state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+    Returns a uniform random number in (0, 1).
+    @param rng the generator
+    @return random number
+ */
+static double rng_uniform(Rng *rng) {
+    return ((rng_next(rng) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/**
+    Returns a normally distributed random number (Box-Muller).
+    @param rng the generator
+    @param mean mean of the distribution
+    @param sd standard deviation of the distribution
+    @return random number
+ */
+static double rng_normal(Rng *rng, double mean, double sd) {
+    double u = rng_uniform(rng), v = rng_uniform(rng);
+    return mean + sd * sqrt(-2.0 * log(u)) * cos(6.283185307179586 * v);
+}
+
+/**
+    Returns the gap to the next flare start, exponentially distributed.
+    @param rng the generator
+    @param mean_gap mean gap in seconds
+    @return gap in whole seconds, at least one
+ */
+static int64_t next_gap(Rng *rng, double mean_gap) {
+    return 1 + (int64_t)(-log(rng_uniform(rng)) * mean_gap);
+}
+
+/**
+    Converts a count of days since 1970-01-01 to a civil date.
+    @param days days since the epoch
+    @param year set to the year
+    @param month set to the month (1 - 12)
+    @param day set to the day of the month
+ */
+static void civil_from_days(int64_t days, int *year, int *month, int *day) {
+    days += 719468;
+    int64_t era = days / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    *day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *year = (int)(yoe + era * 400 + (*month <= 2));
+}
+
+/**
+    Writes a date and time in the header form "06-Jul-2012 00:00:00.000".
+    @param out the stream
+    @param sec seconds since the epoch
+ */
+static void print_header_time(FILE *out, int64_t sec) {
+    static const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    int year, month, day;
+    civil_from_days(sec / 86400, &year, &month, &day);
+    fprintf(out, "%02d-%s-%04d 00:00:00.000", day, months[month - 1], year);
+}
+
+/**
+    Writes one flare row, or a malformed version of it.
+    @param buf output position with room for a row
+    @param start start of the flare in seconds since the epoch
+    @param rng generator for the values of the row
+    @param malformed kind of damage (0 for a valid row)
+    @return the length of the row
+ */
+static int format_row(char *buf, int64_t start, Rng *rng, int malformed) {
+    static const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    static const char *detectors[] = {"n0", "n1", "n2", "n3", "n4", "n5", "n6", "n7", "n8", "n9", "na", "nb"};
+    // Sunward detectors come in groups facing one side of the spacecraft
+    static const int groups[][6] = {{0, 1, 3, 5, 4, 2}, {5, 1, 3, 4, 0, 2}, {0, 3, 1, 6, 4, 7}, {4, 5, 1, 3, 0, 8}};
+
+    int year, month, day;
+    civil_from_days(start / 86400, &year, &month, &day);
+    int start_sec = (int)(start % 86400);
+
+    double d = exp(rng_normal(rng, 5.74, 1.15));
+    int duration = d < 4 ? 4 : d > MAX_DURATION_SEC ? MAX_DURATION_SEC : (int)d;
+    int peak_sec = (start_sec + (int)(duration * pow(rng_uniform(rng), 1.7))) % 86400;
+    int end_sec = (start_sec + duration) % 86400;
+
+    // Peak in c/ms to 3 places, and the average rate as a multiple of it to 10 places
+    double peak = exp(rng_normal(rng, 1.41, 1.45));
+    int64_t peak_milli = peak < 0.001 ? 1 : peak > 9999.999 ? 9999999 : (int64_t)(peak * 1000);
+    double rate = peak_milli / 1000.0 * exp(rng_normal(rng, 4.87, 0.545));
+    // Keep the total count near the largest in the bundled lists, which the 64-bit --stdio path can hold
+    if (rate * duration > MAX_TOTAL_COUNT) {
+        rate = MAX_TOTAL_COUNT / duration;
+    }
+    int64_t rate_int = (int64_t)rate;
+    int64_t rate_frac = (int64_t)((rate - rate_int) * 1e10);
+
+    const int *group = groups[rng_next(rng) % 4];
+    int first = (int)(rng_next(rng) % 2);
+
+    char peak_text[32], rate_text[32];
+    switch (malformed) {
+    case 1: // Placeholder in place of the peak
+        strcpy(peak_text, "-.---");
+        break;
+    case 2: // Peak without its decimal part
+        snprintf(peak_text, sizeof(peak_text), "%lld", (long long)(peak_milli / 1000));
+        break;
+    default:
+        snprintf(peak_text, sizeof(peak_text), "%lld.%03lld", (long long)(peak_milli / 1000), (long long)(peak_milli % 1000));
+    }
+    if (malformed == 3) { // Rate that is not a number
+        strcpy(rate_text, "NaN");
+    } else {
+        snprintf(rate_text, sizeof(rate_text), "%lld.%010lld", (long long)rate_int, (long long)rate_frac);
+    }
+
+    return sprintf(buf, " %02d%02d%02d_%02d%02d %2d-%s-%04d %02d:%02d:%02d %02d:%02d:%02d %02d:%02d:%02d %8s %18s  %s %s %s %s\n",
+                   year % 100, month, day, start_sec / 3600, start_sec / 60 % 60, day, months[month - 1], year,
+                   start_sec / 3600, start_sec / 60 % 60, start_sec % 60, peak_sec / 3600, peak_sec / 60 % 60,
+                   peak_sec % 60, end_sec / 3600, end_sec / 60 % 60, end_sec % 60, peak_text, rate_text,
+                   detectors[group[first]], detectors[group[1 - first]], detectors[group[2]],
+                   detectors[group[3 + rng_next(rng) % 3]]);
+}
+
+/**
+    Program starting point. Writes the header and the rows of a synthetic flare list.
+    @param argc number of command-line arguments
+    @param argv ROWS, then --seed=N, --malformed=FRACTION, and --output=FILE
+    @return program exit status
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <rows> [--seed=N] [--malformed=FRACTION] [--output=FILE]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    long long rows = atoll(argv[1]);
+    uint64_t seed = 1;
+    double malformed_rate = 0.0;
+    const char *path = NULL;
+    for (int i = 2; i < argc; i++) {
+        if (strncmp(argv[i], "--seed=", 7) == 0) {
+            seed = strtoull(argv[i] + 7, NULL, 10);
+        } else if (strncmp(argv[i], "--malformed=", 12) == 0) {
+            malformed_rate = atof(argv[i] + 12);
+        } else if (strncmp(argv[i], "--output=", 9) == 0) {
+            path = argv[i] + 9;
+        } else {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (rows < 1 || malformed_rate < 0.0 || malformed_rate > 1.0) {
+        fprintf(stderr, "Error: Invalid row count or malformed fraction. \n");
+        return EXIT_FAILURE;
+    }
+    FILE *out = path != NULL ? fopen(path, "w") : stdout;
+    if (out == NULL) {
+        fprintf(stderr, "Error: cannot write %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    // Shorten the gaps if the usual ones would run past the last representable year
+    double span = (double)(LAST_DAY - START_DAY) * 86400.0 - MAX_DURATION_SEC;
+    double mean_gap = span / rows < MEAN_GAP_SEC ? span / rows * 0.9 : MEAN_GAP_SEC;
+
+    // The header gives the time range, so walk the gaps once before writing any row
+    Rng gaps = {seed};
+    int64_t last = (int64_t)START_DAY * 86400;
+    for (long long i = 0; i < rows; i++) {
+        last += next_gap(&gaps, mean_gap);
+    }
+
+    Rng values = {seed ^ 0x5deece66dULL};
+    Rng damage = {seed * 31 + 7};
+    long long valid = 0;
+    char *buf = malloc(OUT_BUFFER_SIZE + 256);
+    if (buf == NULL) {
+        fprintf(stderr, "Error: out of memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Count the malformed lines up front as well, so the header has the number of valid rows
+    for (long long i = 0; i < rows; i++) {
+        valid += !(malformed_rate > 0.0 && rng_uniform(&damage) < malformed_rate);
+    }
+    damage.state = seed * 31 + 7;
+
+    fprintf(out, "Fermi GBM Flare List  (synthetic, seed %llu)\n%100s\nTotal # flares: %lld   Time range: ",
+            (unsigned long long)seed, "", valid);
+    print_header_time(out, (int64_t)START_DAY * 86400);
+    fprintf(out, " - ");
+    print_header_time(out, last + 86400);
+    fprintf(out, "\n%100s\n", "");
+    fprintf(out, "   Flare         Start time         Peak     End       Peak        Avg. Count      Sunward\n");
+    fprintf(out, "                                                       c/ms           Rate        Detectors\n\n");
+
+    gaps.state = seed;
+    int64_t start = (int64_t)START_DAY * 86400;
+    size_t len = 0;
+    for (long long i = 0; i < rows; i++) {
+        start += next_gap(&gaps, mean_gap);
+        // One draw decides both whether the line is damaged and how, so it matches the count above
+        int malformed = 0;
+        double u = malformed_rate > 0.0 ? rng_uniform(&damage) : 1.0;
+        if (u < malformed_rate) {
+            malformed = 1 + (int)(u / malformed_rate * 3);
+        }
+        len += (size_t)format_row(buf + len, start, &values, malformed);
+        if (len >= OUT_BUFFER_SIZE) {
+            fwrite(buf, 1, len, out);
+            len = 0;
+        }
+    }
+    fwrite(buf, 1, len, out);
+    free(buf);
+    if (ferror(out) || (out != stdout && fclose(out) != 0)) {
+        fprintf(stderr, "Error: cannot write output.\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
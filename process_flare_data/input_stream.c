@@ -0,0 +1,462 @@
+/**
+    @file input_stream.c
+    This program reads an input file that may be gzip or zstd compressed. The first bytes of the
+    file decide how it is read: a compressed file gets a decompressor thread that fills a ring of
+    INPUT_BLOCKS blocks, and input_read drains the blocks in order. When every block is full the
+    decompressor waits for the reader, which bounds the memory in use however large the file is.
+    The threads hand over whole blocks, so a mutex and a condition variable are cheap enough here.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "input_stream.h"
+
+#define MAGIC_LEN 4 // Bytes read before deciding how the file is read
+#define RAW_BLOCK (1 << 17) // Compressed bytes read from the file at a time
+
+typedef struct {
+    char *data;  // Decompressed bytes
+    size_t len;  // Bytes in use in data
+} InputBlock;
+
+struct InputStream {
+    int fd;                           // File being read
+    const char *name;                 // Name of the file, for error messages
+    Compression compression;          // How the file is compressed
+    unsigned char magic[MAGIC_LEN];   // First bytes of the file, read before anything else
+    size_t magic_len;                 // Bytes in magic
+    size_t magic_pos;                 // Bytes of magic already handed out
+
+    // Only used for a compressed file
+    pthread_t thread;                 // Decompressor thread
+    pthread_mutex_t lock;             // Guards head, tail, finished, and closing
+    pthread_cond_t changed;           // Signaled when a block is filled or drained
+    InputBlock blocks[INPUT_BLOCKS];  // Block i is in slot i % INPUT_BLOCKS
+    size_t head;                      // Blocks filled by the decompressor
+    size_t tail;                      // Blocks drained by the reader
+    size_t block_pos;                 // Bytes of the oldest filled block already read
+    bool finished;                    // Set once the decompressor has filled its last block
+    bool closing;                     // Set when the reader stops early
+};
+
+/**
+    This function allocates memory, exiting if it runs out.
+    @param size Number of bytes
+    @return The memory
+ */
+static void *checked_malloc(size_t size)
+{
+    void *p = malloc(size);
+    if (p == NULL) {
+        fprintf(stderr, "Error: out of memory in input_stream.\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/**
+    This function recognizes a compressed file by its magic number.
+    @param data First bytes of the file
+    @param size Number of bytes at data
+    @return The compression, or COMPRESSION_NONE
+ */
+Compression detect_compression(const void *data, size_t size)
+{
+    const unsigned char *p = data;
+    if (size >= 2 && p[0] == 0x1f && p[1] == 0x8b) {
+        return COMPRESSION_GZIP;
+    }
+    if (size >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd) {
+        return COMPRESSION_ZSTD;
+    }
+    return COMPRESSION_NONE;
+}
+
+/**
+    This function peeks at the magic number of a file. It reads at an offset, so it leaves a pipe
+    alone: a pipe cannot be read at an offset and is reported as not compressed.
+    @param filename Name of the file
+    @return The compression of the file, or COMPRESSION_NONE if it cannot be read
+ */
+Compression file_compression(const char *filename)
+{
+    unsigned char magic[MAGIC_LEN];
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return COMPRESSION_NONE;
+    }
+    ssize_t got = pread(fd, magic, MAGIC_LEN, 0);
+    close(fd);
+    return got > 0 ? detect_compression(magic, (size_t)got) : COMPRESSION_NONE;
+}
+
+/**
+    This function reads from the file, handing out the bytes read to detect the compression first.
+    @param in Input to read
+    @param buf Buffer for the bytes
+    @param n Size of buf
+    @return Number of bytes read, 0 at the end of the file
+ */
+static ssize_t read_raw(InputStream *in, void *buf, size_t n)
+{
+    if (in->magic_pos < in->magic_len) {
+        size_t len = in->magic_len - in->magic_pos;
+        len = len < n ? len : n;
+        memcpy(buf, in->magic + in->magic_pos, len);
+        in->magic_pos += len;
+        return (ssize_t)len;
+    }
+    for (;;) {
+        ssize_t got = read(in->fd, buf, n);
+        if (got >= 0) {
+            return got;
+        }
+        if (errno != EINTR) {
+            fprintf(stderr, "Error: cannot read %s.\n", in->name);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/**
+    This function stops the program on damaged compressed input.
+    @param in Input being decompressed
+    @param reason What went wrong
+ */
+static void corrupt_input(const InputStream *in, const char *reason)
+{
+    fprintf(stderr, "Error: cannot decompress %s: %s.\n", in->name, reason);
+    exit(EXIT_FAILURE);
+}
+
+/**
+    This function waits for a free block and returns it emptied.
+    @param in Input being decompressed
+    @return The block, or NULL if the reader has stopped
+ */
+static InputBlock *claim_block(InputStream *in)
+{
+    pthread_mutex_lock(&in->lock);
+    while (in->head - in->tail == INPUT_BLOCKS && !in->closing) {
+        pthread_cond_wait(&in->changed, &in->lock);
+    }
+    bool closing = in->closing;
+    pthread_mutex_unlock(&in->lock);
+    if (closing) {
+        return NULL;
+    }
+    InputBlock *b = &in->blocks[in->head % INPUT_BLOCKS];
+    b->len = 0;
+    return b;
+}
+
+/**
+    This function hands a filled block to the reader, or marks the end of the input.
+    @param in Input being decompressed
+    @param filled true if a block was filled, false if the input has ended
+ */
+static void publish_block(InputStream *in, bool filled)
+{
+    pthread_mutex_lock(&in->lock);
+    if (filled) {
+        in->head++;
+    } else {
+        in->finished = true;
+    }
+    pthread_cond_broadcast(&in->changed);
+    pthread_mutex_unlock(&in->lock);
+}
+
+/**
+    This function decompresses a gzip file into blocks. Members written back to back, as by
+    concatenating .gz files, are decompressed one after the other.
+    @param in Input to decompress
+ */
+static void inflate_gzip(InputStream *in)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // 16 + MAX_WBITS accepts a gzip header and checks the trailer
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+        corrupt_input(in, "zlib cannot start");
+    }
+    unsigned char *raw = checked_malloc(RAW_BLOCK);
+    bool in_member = false;
+    bool need_input = true; // Clear while inflate may still hold output that did not fit the block
+    InputBlock *b = claim_block(in);
+
+    while (b != NULL) {
+        if (zs.avail_in == 0 && need_input) {
+            ssize_t got = read_raw(in, raw, RAW_BLOCK);
+            if (got == 0) {
+                if (in_member) {
+                    corrupt_input(in, "unexpected end of file");
+                }
+                break;
+            }
+            zs.next_in = raw;
+            zs.avail_in = (uInt)got;
+        }
+        if (zs.avail_in > 0) {
+            in_member = true;
+        }
+        zs.next_out = (Bytef *)b->data + b->len;
+        zs.avail_out = (uInt)(INPUT_BLOCK - b->len);
+        int rc = inflate(&zs, Z_NO_FLUSH);
+        b->len = INPUT_BLOCK - zs.avail_out;
+        need_input = zs.avail_out > 0;
+        if (rc == Z_STREAM_END) {
+            in_member = false;
+            inflateReset(&zs);
+        } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+            corrupt_input(in, zs.msg != NULL ? zs.msg : "damaged data");
+        }
+        if (b->len == INPUT_BLOCK) {
+            publish_block(in, true);
+            b = claim_block(in);
+        }
+    }
+    if (b != NULL && b->len > 0) {
+        publish_block(in, true);
+    }
+    inflateEnd(&zs);
+    free(raw);
+}
+
+#ifdef HAVE_ZSTD
+/**
+    This function decompresses a zstd file into blocks. Any number of frames may follow each other.
+    @param in Input to decompress
+ */
+static void inflate_zstd(InputStream *in)
+{
+    ZSTD_DStream *zs = ZSTD_createDStream();
+    if (zs == NULL) {
+        corrupt_input(in, "zstd cannot start");
+    }
+    unsigned char *raw = checked_malloc(RAW_BLOCK);
+    ZSTD_inBuffer src = {raw, 0, 0};
+    size_t frame_left = 0; // Nonzero while a frame is unfinished
+    bool need_input = true; // Clear while the decoder may still hold output that did not fit the block
+    InputBlock *b = claim_block(in);
+
+    while (b != NULL) {
+        if (src.pos == src.size && need_input) {
+            ssize_t got = read_raw(in, raw, RAW_BLOCK);
+            if (got == 0) {
+                if (frame_left != 0) {
+                    corrupt_input(in, "unexpected end of file");
+                }
+                break;
+            }
+            src.size = (size_t)got;
+            src.pos = 0;
+        }
+        ZSTD_outBuffer dst = {b->data, INPUT_BLOCK, b->len};
+        frame_left = ZSTD_decompressStream(zs, &dst, &src);
+        if (ZSTD_isError(frame_left)) {
+            corrupt_input(in, ZSTD_getErrorName(frame_left));
+        }
+        b->len = dst.pos;
+        need_input = dst.pos < dst.size;
+        if (b->len == INPUT_BLOCK) {
+            publish_block(in, true);
+            b = claim_block(in);
+        }
+    }
+    if (b != NULL && b->len > 0) {
+        publish_block(in, true);
+    }
+    ZSTD_freeDStream(zs);
+    free(raw);
+}
+#endif
+
+/**
+    This function is the body of the decompressor thread.
+    @param arg The InputStream
+    @return NULL
+ */
+static void *decompressor(void *arg)
+{
+    InputStream *in = arg;
+    if (in->compression == COMPRESSION_GZIP) {
+        inflate_gzip(in);
+    }
+#ifdef HAVE_ZSTD
+    if (in->compression == COMPRESSION_ZSTD) {
+        inflate_zstd(in);
+    }
+#endif
+    publish_block(in, false);
+    return NULL;
+}
+
+/**
+    This function opens an input and reads its first bytes to learn how it is compressed. A
+    compressed input starts its decompressor thread right away, so the first blocks are ready
+    by the time the reader asks for them.
+    @param filename Name of the file
+    @return The input, or NULL if the file cannot be opened
+ */
+InputStream *input_open(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    InputStream *in = checked_malloc(sizeof(InputStream));
+    memset(in, 0, sizeof(*in));
+    in->fd = fd;
+    in->name = filename;
+
+    // A pipe may return the magic number in pieces
+    while (in->magic_len < MAGIC_LEN) {
+        ssize_t got = read(fd, in->magic + in->magic_len, MAGIC_LEN - in->magic_len);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        in->magic_len += (size_t)got;
+    }
+    in->compression = detect_compression(in->magic, in->magic_len);
+    if (in->compression == COMPRESSION_NONE) {
+        return in;
+    }
+#ifndef HAVE_ZSTD
+    if (in->compression == COMPRESSION_ZSTD) {
+        fprintf(stderr, "Error: %s is zstd compressed, and this program was built without zstd support.\n",
+                filename);
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    for (int i = 0; i < INPUT_BLOCKS; i++) {
+        in->blocks[i].data = checked_malloc(INPUT_BLOCK);
+    }
+    pthread_mutex_init(&in->lock, NULL);
+    pthread_cond_init(&in->changed, NULL);
+    if (pthread_create(&in->thread, NULL, decompressor, in) != 0) {
+        fprintf(stderr, "Error: cannot start the decompressor thread.\n");
+        exit(EXIT_FAILURE);
+    }
+    return in;
+}
+
+/**
+    This function returns how an open input is compressed.
+    @param in Input
+    @return The compression of the file
+ */
+Compression input_compression(const InputStream *in)
+{
+    return in->compression;
+}
+
+/**
+    This function reads decompressed input, waiting for the decompressor when no block is ready.
+    @param in Input to read
+    @param buf Buffer for the bytes
+    @param n Size of buf
+    @return Number of bytes read, 0 at the end of the input
+ */
+ssize_t input_read(InputStream *in, char *buf, size_t n)
+{
+    if (in->compression == COMPRESSION_NONE) {
+        return read_raw(in, buf, n);
+    }
+
+    pthread_mutex_lock(&in->lock);
+    while (in->head == in->tail && !in->finished) {
+        pthread_cond_wait(&in->changed, &in->lock);
+    }
+    bool empty = in->head == in->tail;
+    pthread_mutex_unlock(&in->lock);
+    if (empty) {
+        return 0;
+    }
+
+    // Only the reader touches the oldest filled block until it is handed back
+    InputBlock *b = &in->blocks[in->tail % INPUT_BLOCKS];
+    size_t len = b->len - in->block_pos;
+    len = len < n ? len : n;
+    memcpy(buf, b->data + in->block_pos, len);
+    in->block_pos += len;
+    if (in->block_pos == b->len) {
+        in->block_pos = 0;
+        pthread_mutex_lock(&in->lock);
+        in->tail++;
+        pthread_cond_broadcast(&in->changed);
+        pthread_mutex_unlock(&in->lock);
+    }
+    return (ssize_t)len;
+}
+
+/**
+    This function reads the rest of an input into memory, doubling the buffer as it fills.
+    @param in Input to read
+    @param size Set to the number of bytes read
+    @return The bytes, to be released with free (NULL if there are none)
+ */
+char *input_read_all(InputStream *in, size_t *size)
+{
+    char *data = NULL;
+    size_t len = 0, cap = 0;
+    for (;;) {
+        if (cap - len < INPUT_BLOCK) {
+            cap = cap ? cap * 2 : 4 * (size_t)INPUT_BLOCK;
+            char *grown = realloc(data, cap);
+            if (grown == NULL) {
+                fprintf(stderr, "Error: out of memory in input_read_all.\n");
+                exit(EXIT_FAILURE);
+            }
+            data = grown;
+        }
+        ssize_t got = input_read(in, data + len, cap - len);
+        if (got == 0) {
+            break;
+        }
+        len += (size_t)got;
+    }
+    if (len == 0) {
+        free(data);
+        data = NULL;
+    }
+    *size = len;
+    return data;
+}
+
+/**
+    This function closes an input. A decompressor still running, because the reader stopped before
+    the end, is told to stop and joined first.
+    @param in Input to close
+ */
+void input_close(InputStream *in)
+{
+    if (in->compression != COMPRESSION_NONE) {
+        pthread_mutex_lock(&in->lock);
+        in->closing = true;
+        pthread_cond_broadcast(&in->changed);
+        pthread_mutex_unlock(&in->lock);
+        pthread_join(in->thread, NULL);
+        for (int i = 0; i < INPUT_BLOCKS; i++) {
+            free(in->blocks[i].data);
+        }
+        pthread_mutex_destroy(&in->lock);
+        pthread_cond_destroy(&in->changed);
+    }
+    close(in->fd);
+    free(in);
+}
@@ -0,0 +1,47 @@
+/**
+     @file input_stream.h
+     This header file defines a sequential input that may be compressed. A gzip or zstd file is
+     recognized by its first bytes, whatever its name, and decompressed on a thread of its own into
+     a bounded set of blocks that the reader drains, so decompression overlaps the work done on the
+     text and never goes through a temporary file. A plain file is read directly.
+ */
+#ifndef INPUT_STREAM_H
+#define INPUT_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define INPUT_BLOCK (1 << 18) // Decompressed bytes handed from the decompressor to the reader at a time
+#define INPUT_BLOCKS 8        // Blocks the decompressor may fill ahead of the reader
+
+typedef enum {
+    COMPRESSION_NONE, // Plain text or a snapshot
+    COMPRESSION_GZIP, // gzip (RFC 1952), possibly several members back to back
+    COMPRESSION_ZSTD  // Zstandard frames, supported when built with HAVE_ZSTD
+} Compression;
+
+typedef struct InputStream InputStream;
+
+// Return the compression whose magic number starts the size bytes at data
+Compression detect_compression(const void *data, size_t size);
+
+// Return the compression of a regular file without consuming any of it (COMPRESSION_NONE for a pipe)
+Compression file_compression(const char *filename);
+
+// Open filename, starting a decompressor thread if it is compressed; NULL if it cannot be opened
+InputStream *input_open(const char *filename);
+
+// Return the compression of an open input
+Compression input_compression(const InputStream *in);
+
+// Read up to n bytes of decompressed input into buf, returning 0 at its end
+ssize_t input_read(InputStream *in, char *buf, size_t n);
+
+// Read the rest of the input into a malloc'd buffer, returning its length in size
+char *input_read_all(InputStream *in, size_t *size);
+
+// Stop the decompressor thread, close the file, and release the input
+void input_close(InputStream *in);
+
+#endif
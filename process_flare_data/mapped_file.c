@@ -0,0 +1,80 @@
+/**
+    @file mapped_file.c
+    This program maps an input file read-only into memory so it can be tokenized in place. Compressed
+    text cannot be tokenized in place, so a compressed file is decompressed into the heap instead.
+ */
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "flare_stats.h"
+#include "input_stream.h"
+#include "mapped_file.h"
+
+/**
+    This function maps a whole regular file into memory. The file descriptor is closed right away,
+    as the mapping stays valid without it. A file that starts with a gzip or zstd magic number is
+    unmapped again and read through an InputStream into memory.
+    @param filename Name of the file to map
+    @param mf Mapping to fill in
+    @return true on success, false if the file cannot be opened, is not a regular file, or cannot be mapped
+ */
+bool map_file(const char *filename, MappedFile *mf)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return false;
+    }
+
+    mf->data = NULL;
+    mf->size = (size_t)st.st_size;
+    mf->decompressed = false;
+    // mmap rejects a zero length, and an empty file has nothing to map anyway
+    if (mf->size > 0) {
+        void *addr = mmap(NULL, mf->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        // The file is read front to back once
+        madvise(addr, mf->size, MADV_SEQUENTIAL);
+        mf->data = addr;
+    }
+    close(fd);
+
+    if (detect_compression(mf->data, mf->size) != COMPRESSION_NONE) {
+        munmap((void *)mf->data, mf->size);
+        InputStream *in = input_open(filename);
+        if (in == NULL) {
+            return false;
+        }
+        mf->data = input_read_all(in, &mf->size);
+        mf->decompressed = true;
+        input_close(in);
+    }
+    stats_add(COUNT_BYTES_IN, (long long)mf->size);
+    return true;
+}
+
+/**
+    This function releases a mapping created by map_file.
+    @param mf Mapping to release
+ */
+void unmap_file(MappedFile *mf)
+{
+    if (mf->decompressed) {
+        free((void *)mf->data);
+    } else if (mf->data != NULL) {
+        munmap((void *)mf->data, mf->size);
+    }
+    mf->data = NULL;
+    mf->size = 0;
+}
@@ -0,0 +1,24 @@
+/**
+     @file mapped_file.h
+     This header file defines a read-only memory mapping of a whole input file. A gzip or zstd
+     compressed file is decompressed into memory instead, so callers see its text either way.
+ */
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    const char *data;  // Start of the mapping (NULL for an empty file)
+    size_t size;       // Length of the file in bytes, after decompression
+    bool decompressed; // Set if data was decompressed into the heap rather than mapped
+} MappedFile;
+
+// Map filename read-only into memory, decompressing it if it is compressed; false if it cannot be opened or mapped
+bool map_file(const char *filename, MappedFile *mf);
+
+// Release a mapping created by map_file
+void unmap_file(MappedFile *mf);
+
+#endif
@@ -0,0 +1,196 @@
+/**
+    @file out_buffer.c
+    This program provides a growable output buffer used to collect formatted rows before they are
+    written, either in large blocks to a stream or in order once a parallel worker has finished.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "flare_stats.h"
+#include "out_buffer.h"
+
+/**
+    This function makes sure the buffer has room for extra more bytes.
+    @param out Buffer to grow
+    @param extra Number of bytes that are about to be appended
+ */
+static void out_reserve(OutBuffer *out, size_t extra)
+{
+    if (out->len + extra <= out->cap) {
+        return;
+    }
+    size_t cap = out->cap ? out->cap : 4096;
+    while (cap < out->len + extra) {
+        cap *= 2;
+    }
+    char *data = realloc(out->data, cap);
+    if (data == NULL) {
+        fprintf(stderr, "Error: out of memory in out_reserve.\n");
+        exit(EXIT_FAILURE);
+    }
+    out->data = data;
+    out->cap = cap;
+}
+
+/**
+    This function initializes an empty buffer.
+    @param out Buffer to initialize
+    @param sink Stream the buffer is flushed to, or NULL to keep all output in memory
+ */
+void out_init(OutBuffer *out, FILE *sink)
+{
+    out->data = NULL;
+    out->len = 0;
+    out->cap = 0;
+    out->sink = sink;
+    out->limit = 0;
+    out->on_limit = NULL;
+    out->limit_ctx = NULL;
+}
+
+/**
+    This function gives a buffer without a sink a limit. Once it is about to hold more than limit
+    bytes, on_limit is called; if it sets a sink, the buffer is flushed to it from then on, and
+    otherwise on_limit is called again at the next append.
+    @param out Buffer to limit
+    @param limit Bytes the buffer may hold without a sink
+    @param on_limit Function to call at the limit
+    @param ctx Passed to on_limit
+ */
+void out_set_limit(OutBuffer *out, size_t limit, void (*on_limit)(OutBuffer *out, void *ctx), void *ctx)
+{
+    out->limit = limit;
+    out->on_limit = on_limit;
+    out->limit_ctx = ctx;
+}
+
+/**
+    This function makes room for n more bytes in a buffer that has grown past its flush size,
+    calling the limit callback if there is no sink and then flushing if there is one.
+    @param out Buffer about to be appended to
+    @param n Number of bytes about to be appended
+ */
+static void out_make_room(OutBuffer *out, size_t n)
+{
+    if (out->sink == NULL && out->on_limit != NULL && out->len + n > out->limit) {
+        out->on_limit(out, out->limit_ctx);
+    }
+    if (out->sink != NULL) {
+        out_flush(out);
+    }
+}
+
+/**
+    This function appends raw bytes, flushing first if a sink is set and the buffer is full.
+    @param out Buffer to append to
+    @param s Bytes to append
+    @param n Number of bytes
+ */
+void out_write(OutBuffer *out, const char *s, size_t n)
+{
+    if (out->len + n > OUT_FLUSH_SIZE) {
+        out_make_room(out, n);
+    }
+    out_reserve(out, n);
+    memcpy(out->data + out->len, s, n);
+    out->len += n;
+}
+
+/**
+    This function reserves room for n more bytes, flushing first if a sink is set and the buffer is
+    full. The caller writes at the returned position and then adds the bytes it wrote to out->len.
+    @param out Buffer to append to
+    @param n Most bytes the caller will write
+    @return Position to write at
+ */
+char *out_claim(OutBuffer *out, size_t n)
+{
+    if (out->len + n > OUT_FLUSH_SIZE) {
+        out_make_room(out, n);
+    }
+    out_reserve(out, n);
+    return out->data + out->len;
+}
+
+/**
+    This function appends formatted text in the same way as printf.
+    @param out Buffer to append to
+    @param format printf-style format string
+ */
+void out_printf(OutBuffer *out, const char *format, ...)
+{
+    if (out->len >= OUT_FLUSH_SIZE) {
+        out_make_room(out, 0);
+    }
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(out->data + out->len, out->cap - out->len, format, args);
+    va_end(args);
+
+    // Grow and format again if the text did not fit in the space left
+    if (n >= 0 && (size_t)n >= out->cap - out->len) {
+        out_reserve(out, (size_t)n + 1);
+        va_start(args, format);
+        vsnprintf(out->data + out->len, out->cap - out->len, format, args);
+        va_end(args);
+    }
+    if (n > 0) {
+        out->len += (size_t)n;
+    }
+}
+
+/**
+    This function writes everything buffered to the sink and empties the buffer.
+    @param out Buffer to flush
+ */
+void out_flush(OutBuffer *out)
+{
+    if (out->sink != NULL && out->len > 0) {
+        write_all(out->sink, out->data, out->len);
+    }
+    out->len = 0;
+}
+
+/**
+    This function writes a block straight to the file descriptor of a stream. Anything already in the
+    stream's own buffer is flushed first so the order of the output is kept; the block itself then
+    normally goes out in a single write call.
+    @param sink Stream to write to
+    @param data Bytes to write
+    @param len Number of bytes
+ */
+void write_all(FILE *sink, const char *data, size_t len)
+{
+    uint64_t start = stats_start();
+    stats_add(COUNT_BYTES_OUT, (long long)len);
+    fflush(sink);
+    int fd = fileno(sink);
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            fprintf(stderr, "Error: cannot write output.\n");
+            exit(EXIT_FAILURE);
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    stats_lap(STAGE_WRITE, start);
+}
+
+/**
+    This function releases the memory held by the buffer.
+    @param out Buffer to release
+ */
+void out_free(OutBuffer *out)
+{
+    free(out->data);
+    out->data = NULL;
+    out->len = 0;
+    out->cap = 0;
+}
@@ -0,0 +1,50 @@
+/**
+     @file out_buffer.h
+     This header file defines a growable output buffer. Formatted rows are appended to it and either
+     kept in memory or written to a sink once enough output has accumulated. A buffer without a sink
+     may also be given a limit, at which a callback decides what to do with the output, such as
+     waiting for its turn to write it and then setting a sink.
+ */
+#ifndef OUT_BUFFER_H
+#define OUT_BUFFER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define OUT_FLUSH_SIZE (1 << 20) // Bytes collected before a buffer with a sink is written out
+
+typedef struct OutBuffer {
+    char *data;                                          // Buffered output
+    size_t len;                                          // Number of bytes in use
+    size_t cap;                                          // Allocated size of data
+    FILE *sink;                                          // Stream to flush to, or NULL to keep everything in memory
+    size_t limit;                                        // Bytes kept without a sink before on_limit is called
+    void (*on_limit)(struct OutBuffer *out, void *ctx);  // Called at the limit, or NULL for no limit
+    void *limit_ctx;                                     // Passed to on_limit
+} OutBuffer;
+
+// Initialize an empty buffer that flushes to sink (NULL to only accumulate)
+void out_init(OutBuffer *out, FILE *sink);
+
+// Call on_limit(out, ctx) whenever a buffer without a sink is about to hold more than limit bytes
+void out_set_limit(OutBuffer *out, size_t limit, void (*on_limit)(OutBuffer *out, void *ctx), void *ctx);
+
+// Append n bytes to the buffer
+void out_write(OutBuffer *out, const char *s, size_t n);
+
+// Make room for up to n bytes and return where to write them; the caller then adds what it wrote to len
+char *out_claim(OutBuffer *out, size_t n);
+
+// Append printf-style formatted text to the buffer
+void out_printf(OutBuffer *out, const char *format, ...);
+
+// Write the buffered bytes to the sink (if any) and empty the buffer
+void out_flush(OutBuffer *out);
+
+// Write len bytes to a stream with as few write calls as possible, bypassing its stdio buffer
+void write_all(FILE *sink, const char *data, size_t len);
+
+// Release the memory held by the buffer
+void out_free(OutBuffer *out);
+
+#endif
@@ -3,16 +3,31 @@
     This program processes solar flare data from input file, formats dates and fractions, 
     and prints the results to output file.
  */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
+#include <unistd.h>
 #include "fraction.h"
+#include "flare_aggregate.h"
+#include "flare_batch.h"
+#include "flare_follow.h"
+#include "flare_format.h"
+#include "flare_index.h"
+#include "flare_parse.h"
+#include "flare_pipeline.h"
+#include "flare_process.h"
+#include "flare_server.h"
+#include "flare_snapshot.h"
+#include "flare_stats.h"
+#include "flare_table.h"
+#include "input_stream.h"
+#include "mapped_file.h"
 
 #define MAX_LINE 512 // Maximum line length for reading
-#define WIDTH 39 // Output width for formatted fractions
-#define SECOND_PER_DAY 86400 // Seconds in a day
 #define MAX_DATE_FORMAT 32 // Maximum length for date format string
-#define MAX_HEADER_LINES 7 // Number of header lines to skip
 /**
     Converts a time string (HH:MM:SS) to total seconds.
     @param time_str The time string to convert.
@@ -28,9 +43,10 @@ int convert_time_to_seconds(const char *time_str) {
     Converts a date string into a specified format.
     @param input the input date string
     @param output the output buffer for the formatted date
-    @param format the desired output format
+    @param format the compiled date format
+    @param seconds the start time of the row in seconds, for formats that print it
  */
-void convert_date_format(const char *input, char *output, const char *format) {
+void convert_date_format(const char *input, char *output, const DateFormat *format, int seconds) {
     // Buffer to store the 3-letter month abbreviation
     char mon_str[4];
     int day, year, month = 0; 
@@ -51,92 +67,36 @@ void convert_date_format(const char *input, char *output, const char *format) {
         }
     }
     // Format the output string based on the specified format
-    if (strcmp(format, "YYYY-MM-DD") == 0)
-        sprintf(output, "%04d-%02d-%02d", year, month, day);
-    else if (strcmp(format, "MM-DD-YYYY") == 0)
-        sprintf(output, "%02d-%02d-%04d", month, day, year);
-    else if (strcmp(format, "MM/DD/YYYY") == 0)
-        sprintf(output, "%02d/%02d/%04d", month, day, year);
+    if (format->mode == DATE_COMPILED)
+        date_format_render(format, year, month, day, seconds, output);
     else
         strcpy(output, input);
 }
- 
-/**
-    Formats a fraction into a centered string representation.
-    @param f the fraction array
-    @param buf buffer to hold the formatted output 
- */
-void center_format_fraction(const Fraction f, char *buf) {
-    // Buffers to store the string representations of the numerator(f[0]) and denominator(f[1])
-    char str_f0[21], str_f1[21];
-    
-    // Convert f[0] and f[1] to strings
-    sprintf(str_f0, "%lld", f[0]);
-    sprintf(str_f1, "%lld", f[1]);
-
-    // Calculate the lengths of f[0] and f[1] strings
-    int len_f0 = strlen(str_f0);
-    int len_f1 = strlen(str_f1);
-
-    // Determine the position of slash '/' and calculate spaces on its left and right sides
-    int slash_pos = WIDTH / 2;
-    int left_spaces = slash_pos - len_f0;
-    int right_spaces = WIDTH - slash_pos - 1 - len_f1;
-    
-    // Format the centered fraction into the output buffer
-    sprintf(buf, "%*s%s/%s%*s", left_spaces, "", str_f0, str_f1, right_spaces, "");
-}
 
 /**
-    Program starting point. Reads solar flare data from input file, processes it, and prints formatted output.
-    @param argc number of command-line arguments
-    @param argv list of command-line arguments
-    @return program exit status
+    Processes the rows of an open flare list with fscanf. This is the original reader, kept so the
+    output of the memory-mapped reader can be compared against it byte for byte.
+    @param fp the input file, positioned at the start
+    @param format the output row format
  */
-int main(int argc, char *argv[]) {
-    // Check for correct number of command-line arguments
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <input_file> [--date-format=FORMAT]\n", argv[0]);
-        return EXIT_FAILURE;
-    }
-
-    // Get the input filename
-    const char *filename = argv[1];
-    // Default date format is empty
-    char date_format[MAX_DATE_FORMAT] = "";
-    // Check for date format argument
-    if (argc == 3 && strncmp(argv[2], "--date-format=", 14) == 0) {
-        if (strlen(argv[2] + 14) == 10) { // Valid date format length
-            strcpy(date_format, argv[2] + 14); // Copy the date format
-        } else {
-            fprintf(stderr, "Error: Invalid date format. \n");
-            return EXIT_FAILURE;
-        }
-    }
-
-    // Open the input file for reading
-    FILE *fp = fopen(filename, "r");
-    // Check if file opened successfully
-    if (fp == NULL) {
-        printf("Error opening file");
-        return EXIT_FAILURE;
-    }
-
+void process_stdio(FILE *fp, const RowFormat *format) {
     // Declare a buffer to read lines from the file
     char line[MAX_LINE];
     // Loop to skip the header lines
-    for (int i = 0; i < 7; i++) {
+    for (int i = 0; i < MAX_HEADER_LINES; i++) {
         fgets(line, sizeof(line), fp);
     }
 
     // Declare variables to hold the data fields
-    char flare_id[32], start_date[32], finalFormatted_date[32], start_time[16], peak_time[16], end_time[16];
+    char flare_id[32], start_date[32], finalFormatted_date[DATE_TEXT_MAX], start_time[16], peak_time[16], end_time[16];
     long long peak_int = 0, peak_decimal = 0, avg_int = 0, avg_decimal = 0;
     char detectors[32];
 
     // Loop to read and process each line of the file
     while (1) {
         // Read a line from the file
+        uint64_t t = stats_start();
+        errno = 0;
         int num_fields = fscanf(fp, "%31s %31s %15s %15s %15s %lld.%lld %lld.%lld %31[^\n]",
             flare_id, start_date, start_time, peak_time, end_time,
             &peak_int, &peak_decimal, &avg_int, &avg_decimal, detectors);
@@ -145,59 +105,502 @@ int main(int argc, char *argv[]) {
         if (num_fields == EOF) {
             break;
         }
-        // Check for line format error
-        if (num_fields != 10) {
+        // Check for line format error, including a number too large for 64 bits as the mapped reader does
+        if (num_fields != 10 || errno == ERANGE) {
             fprintf(stderr, "Warning: line format error, skipping line.\n");
             fgets(line, sizeof(line), fp); // Skip the invalid line
+            stats_add(COUNT_SKIPPED, 1);
             continue;
         }
-        // Convert the date format
-        convert_date_format(start_date, finalFormatted_date, date_format);
-
-        // Declare DecimalParts structure to hold integer parts, decimals parts and lengths
-        DecimalParts peak_parts = {peak_int, peak_decimal, 3};
-        DecimalParts avg_parts = {avg_int, avg_decimal, 10};
-        // Declare Fraction structure to hold the fractions
-        Fraction peak_frac, avg_count_rate_frac, duration_frac, total_count_frac;
-
-        // Convert peak and average decimal parts to fractions
-        from_decimal_parts(peak_parts, peak_frac);
-        from_decimal_parts(avg_parts, avg_count_rate_frac);
-
         // Convert time strings to seconds and calculate the total duration
         int start_in_sec = convert_time_to_seconds(start_time);
         int end_in_sec = convert_time_to_seconds(end_time);
+        t = stats_lap(STAGE_PARSE, t);
+
+        // Convert the date format
+        convert_date_format(start_date, finalFormatted_date, &format->date, start_in_sec);
+        t = stats_lap(STAGE_DATE, t);
+        stats_add(COUNT_ROWS, 1);
+
+        // Declare DecimalParts structure to hold integer parts, decimals parts and lengths
+        DecimalParts peak_parts = {peak_int, peak_decimal, PEAK_DECIMAL_LENGTH};
+        DecimalParts avg_parts = {avg_int, avg_decimal, AVG_DECIMAL_LENGTH};
         int duration = end_in_sec - start_in_sec;
         if (duration < 0) {
             duration += SECOND_PER_DAY; // Handle overnight
         }
+
+        // Decimal output prints the exact total count, and no fraction is computed
+        if (format->decimal) {
+            FixedDecimal avg_count_rate, total_count;
+            char total_count_text[FIXED_TEXT_MAX];
+            if (!fixed_from_decimal(avg_parts, &avg_count_rate) ||
+                !fixed_multiply_int(&avg_count_rate, duration, &total_count)) {
+                fprintf(stderr, "Error: total count of flare %s is out of range.\n", flare_id);
+                exit(EXIT_FAILURE);
+            }
+            fixed_format(&total_count, total_count_text);
+            t = stats_lap(STAGE_FRACTION, t);
+            int written = printf("%12s%*s%9s%9s%9s%6d %4lld.%03lld %7lld.%010lld %*s %12s\n",
+            flare_id, format->date.mode != DATE_AS_IS ? 11 : 12, finalFormatted_date, start_time, peak_time, end_time,
+            duration, peak_int, peak_decimal, avg_int, avg_decimal, DECIMAL_WIDTH, total_count_text, detectors);
+            stats_add(COUNT_BYTES_OUT, written);
+            stats_lap(STAGE_FORMAT, t);
+            continue;
+        }
+
+        // Declare Rationals to hold the fractions. They are exact even past int64, as on the mapped path
+        Rational peak_frac = RATIONAL_ZERO, avg_count_rate_frac = RATIONAL_ZERO, total_count_frac = RATIONAL_ZERO;
+
+        // Convert peak and average decimal parts to fractions
+        rational_from_decimal(peak_parts, &peak_frac);
+        rational_from_decimal(avg_parts, &avg_count_rate_frac);
+
         // Convert duration to fraction
-        duration_frac[0] = duration;
-        duration_frac[1] = 1;
+        Rational duration_frac = {duration, 1, NULL};
 
         // Calculate total count in fraction
-        multiply_fraction(avg_count_rate_frac, duration_frac, total_count_frac);
+        rational_multiply(&avg_count_rate_frac, &duration_frac, &total_count_frac);
+
+        t = stats_lap(STAGE_FRACTION, t);
 
         // Declare buffers for formatted output
-        char peak_fmt[WIDTH + 1], avg_count_rate_fmt[WIDTH + 1], total_count_fmt[WIDTH + 1];
+        char peak_buf[CENTERED_MAX], avg_count_rate_buf[CENTERED_MAX], total_count_buf[CENTERED_MAX];
         
-        // Call the center_format_fraction function to format the fractions
-        center_format_fraction(peak_frac, peak_fmt);
-        center_format_fraction(avg_count_rate_frac, avg_count_rate_fmt);
-        center_format_fraction(total_count_frac, total_count_fmt);
+        // Call the center_format_rational function to format the fractions
+        char *peak_fmt = center_format_rational(&peak_frac, peak_buf);
+        char *avg_count_rate_fmt = center_format_rational(&avg_count_rate_frac, avg_count_rate_buf);
+        char *total_count_fmt = center_format_rational(&total_count_frac, total_count_buf);
  
         // If date format is not empty, print the formatted output with date. Otherwise, print with start date
-        if (date_format[0] != '\0') {        
-            printf("%12s%11s%9s%9s%9s%6d %4lld.%03lld (%39s) %7lld.%010lld (%39s) (%39s) %12s\n",
+        int written;
+        if (format->date.mode != DATE_AS_IS) {
+            written = printf("%12s%11s%9s%9s%9s%6d %4lld.%03lld (%39s) %7lld.%010lld (%39s) (%39s) %12s\n",
             flare_id, finalFormatted_date, start_time, peak_time, end_time, duration,
             peak_int, peak_decimal, peak_fmt, avg_int, avg_decimal, avg_count_rate_fmt, total_count_fmt, detectors);
         } else {
-            printf("%12s%12s%9s%9s%9s%6d %4lld.%03lld (%39s) %7lld.%010lld (%39s) (%39s) %12s\n",
+            written = printf("%12s%12s%9s%9s%9s%6d %4lld.%03lld (%39s) %7lld.%010lld (%39s) (%39s) %12s\n",
             flare_id, start_date, start_time, peak_time, end_time, duration,
             peak_int, peak_decimal, peak_fmt, avg_int, avg_decimal, avg_count_rate_fmt, total_count_fmt, detectors);
-        }        
+        }
+        stats_add(COUNT_BYTES_OUT, written);
+        stats_lap(STAGE_FORMAT, t);
+
+        // Release the text and values of fractions that spilled past int64
+        if (peak_fmt != peak_buf) {
+            free(peak_fmt);
+        }
+        if (avg_count_rate_fmt != avg_count_rate_buf) {
+            free(avg_count_rate_fmt);
+        }
+        if (total_count_fmt != total_count_buf) {
+            free(total_count_fmt);
+        }
+        rational_free(&peak_frac);
+        rational_free(&avg_count_rate_frac);
+        rational_free(&total_count_frac);
+    }
+    stats_add(COUNT_BYTES_IN, ftell(fp));
+}
+
+/**
+    Processes the rows of a memory-mapped flare list. Each line is tokenized in place, so no field
+    is copied and no scanf call is made. A snapshot is detected by its header and formatted straight
+    from its columns.
+    @param data the contents of the file
+    @param size the length of the file in bytes
+    @param format the output row format
+    @param threads the number of worker threads, or 1 to process on the calling thread
+    @return true on success, false if the file is a damaged or incompatible snapshot
+ */
+bool process_mapped(const char *data, size_t size, const RowFormat *format, int threads) {
+    const char *end = data + size;
+    ProcessCounts counts = {0, 0};
+    OutBuffer out;
+    out_init(&out, stdout);
+
+    if (snapshot_detect(data, size)) {
+        FlareTable table;
+        if (!snapshot_open(data, size, &table)) {
+            return false;
+        }
+        process_table(&table, NULL, format, &out, &counts);
+    } else if (threads > 1) {
+        process_lines_parallel(flare_skip_lines(data, end, MAX_HEADER_LINES), end, format, threads, stdout, &counts);
+    } else {
+        process_lines(flare_skip_lines(data, end, MAX_HEADER_LINES), end, format, &out, stderr, &counts);
+    }
+    out_flush(&out);
+    out_free(&out);
+    return true;
+}
+
+/**
+    Parses a memory-mapped flare list into a table and saves it as a snapshot.
+    @param data the contents of the file
+    @param size the length of the file in bytes
+    @param path the name of the snapshot to write
+    @return true on success, false if the snapshot cannot be written
+ */
+bool write_snapshot(const char *data, size_t size, const char *path) {
+    const char *end = data + size;
+    ProcessCounts counts = {0, 0};
+    FlareTable table;
+    table_init(&table);
+    table_load_lines(&table, flare_skip_lines(data, end, MAX_HEADER_LINES), end, stderr, &counts);
+    bool ok = snapshot_write(&table, path);
+    table_free(&table);
+    return ok;
+}
+
+/**
+    Answers a query over a flare list or snapshot. The records are loaded into a table, indexed, and
+    only the matching rows are formatted.
+    @param data the contents of the file
+    @param size the length of the file in bytes
+    @param format the output row format
+    @param query the conditions the printed rows must meet
+    @return true on success, false if the file is a damaged or incompatible snapshot
+ */
+bool run_query(const char *data, size_t size, const RowFormat *format, const FlareQuery *query) {
+    const char *end = data + size;
+    ProcessCounts counts = {0, 0};
+    FlareTable table;
+    if (snapshot_detect(data, size)) {
+        if (!snapshot_open(data, size, &table)) {
+            return false;
+        }
+    } else {
+        table_init(&table);
+        table_load_lines(&table, flare_skip_lines(data, end, MAX_HEADER_LINES), end, stderr, &counts);
+    }
+
+    FlareIndex index;
+    index_build(&index, &table);
+    uint64_t *selected = calloc(index.words ? index.words : 1, sizeof(uint64_t));
+    if (selected == NULL) {
+        fprintf(stderr, "Error: out of memory in run_query.\n");
+        exit(EXIT_FAILURE);
+    }
+    index_query(&index, &table, query, selected);
+
+    OutBuffer out;
+    out_init(&out, stdout);
+    process_table(&table, selected, format, &out, &counts);
+    out_flush(&out);
+    out_free(&out);
+    free(selected);
+    index_free(&index);
+    table_free(&table);
+    return true;
+}
+
+/**
+    Program starting point. Reads solar flare data from input file, processes it, and prints formatted output.
+    @param argc number of command-line arguments
+    @param argv list of command-line arguments
+    @return program exit status
+ */
+int main(int argc, char *argv[]) {
+    // Check for correct number of command-line arguments
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <input_file>... [--date-format=FORMAT] [--decimal] [--stats] [--stdio] [--pipeline] [--threads=N] [--batch] [--io=uring|pread|mmap] [--output-dir=DIR] [--write-snapshot=FILE] [--from=DATE] [--to=DATE] [--peak-above=X] [--detector=LIST] [--active-at=TIME] [--active-during=FROM,TO] [--follow] [--serve=SOCKET] [--aggregate=day|month]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Input files and glob patterns, in the order given
+    char **inputs = argv + 1;
+    int input_count = 0;
+    // Default date format is empty, and the fraction columns are printed
+    RowFormat format;
+    date_format_compile("", &format.date);
+    format.decimal = false;
+    // Read through mmap unless the original stdio reader is requested
+    bool use_stdio = false;
+    // Read, compute, and write on separate threads
+    bool use_pipeline = false;
+    // Number of worker threads, 0 until given on the command line
+    int threads = 0;
+    // Process the inputs as a batch even if only one file is given
+    bool batch = false;
+    // Directory for per-file batch output, or NULL for standard output
+    const char *output_dir = NULL;
+    // How batch workers read their files, through io_uring by default
+    BatchIo batch_io = BATCH_IO_URING;
+    bool io_given = false;
+    // Snapshot to convert the input into, or NULL to print the input
+    const char *snapshot_path = NULL;
+    // Conditions of a query, used if any of them is given
+    FlareQuery query = {false, 0, false, 0, false, 0, 0, false, 0, 0};
+    bool use_query = false;
+    // Keep processing rows appended to the input
+    bool follow = false;
+    // Unix socket to serve the inputs on, or NULL to process them once
+    const char *serve_path = NULL;
+    // Print per-period totals instead of the rows
+    bool aggregate = false;
+    AggregatePeriod period = AGGREGATE_DAY;
+
+    // Separate the options from the input files
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            inputs[input_count++] = argv[i];
+        } else if (strncmp(argv[i], "--date-format=", 14) == 0) {
+            // Compile the format once, rejecting lengths and patterns it cannot print
+            if (strlen(argv[i] + 14) >= MAX_DATE_FORMAT || !date_format_compile(argv[i] + 14, &format.date)) {
+                fprintf(stderr, "Error: Invalid date format. \n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--decimal") == 0) {
+            format.decimal = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            // Print the counters and stage times to standard error however the program ends
+            if (!stats_enable()) {
+                fprintf(stderr, "Error: built without stats support. \n");
+                return EXIT_FAILURE;
+            }
+            atexit(stats_report);
+        } else if (strcmp(argv[i], "--stdio") == 0) {
+            use_stdio = true;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            use_pipeline = true;
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            threads = atoi(argv[i] + 10);
+            if (threads < 1) {
+                fprintf(stderr, "Error: Invalid thread count. \n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+        } else if (strncmp(argv[i], "--io=", 5) == 0) {
+            if (strcmp(argv[i] + 5, "uring") == 0) {
+                batch_io = BATCH_IO_URING;
+            } else if (strcmp(argv[i] + 5, "pread") == 0) {
+                batch_io = BATCH_IO_PREAD;
+            } else if (strcmp(argv[i] + 5, "mmap") == 0) {
+                batch_io = BATCH_IO_MMAP;
+            } else {
+                fprintf(stderr, "Error: Invalid I/O method %s\n", argv[i] + 5);
+                return EXIT_FAILURE;
+            }
+            io_given = true;
+        } else if (strncmp(argv[i], "--output-dir=", 13) == 0) {
+            output_dir = argv[i] + 13;
+        } else if (strncmp(argv[i], "--write-snapshot=", 17) == 0) {
+            snapshot_path = argv[i] + 17;
+        } else if (strcmp(argv[i], "--follow") == 0) {
+            follow = true;
+        } else if (strncmp(argv[i], "--serve=", 8) == 0) {
+            serve_path = argv[i] + 8;
+        } else if (strcmp(argv[i], "--aggregate=day") == 0) {
+            aggregate = true;
+            period = AGGREGATE_DAY;
+        } else if (strcmp(argv[i], "--aggregate=month") == 0) {
+            aggregate = true;
+            period = AGGREGATE_MONTH;
+        } else if (strncmp(argv[i], "--from=", 7) == 0) {
+            if (!query_parse_time(argv[i] + 7, false, &query.from)) {
+                fprintf(stderr, "Error: Invalid date %s\n", argv[i] + 7);
+                return EXIT_FAILURE;
+            }
+            query.has_from = use_query = true;
+        } else if (strncmp(argv[i], "--to=", 5) == 0) {
+            if (!query_parse_time(argv[i] + 5, true, &query.to)) {
+                fprintf(stderr, "Error: Invalid date %s\n", argv[i] + 5);
+                return EXIT_FAILURE;
+            }
+            query.has_to = use_query = true;
+        } else if (strncmp(argv[i], "--peak-above=", 13) == 0) {
+            if (!query_parse_peak(argv[i] + 13, &query.min_peak)) {
+                fprintf(stderr, "Error: Invalid peak %s\n", argv[i] + 13);
+                return EXIT_FAILURE;
+            }
+            query.has_min_peak = use_query = true;
+        } else if (strncmp(argv[i], "--detector=", 11) == 0) {
+            uint16_t mask = detector_mask(argv[i] + 11, (int)strlen(argv[i] + 11));
+            if (mask == 0) {
+                fprintf(stderr, "Error: Invalid detector list %s\n", argv[i] + 11);
+                return EXIT_FAILURE;
+            }
+            query.detectors |= mask;
+            use_query = true;
+        } else if (strncmp(argv[i], "--active-at=", 12) == 0) {
+            // A bare date is the whole day; a date and time is a single instant
+            if (!query_parse_time(argv[i] + 12, false, &query.active_from) ||
+                !query_parse_time(argv[i] + 12, true, &query.active_to)) {
+                fprintf(stderr, "Error: Invalid date %s\n", argv[i] + 12);
+                return EXIT_FAILURE;
+            }
+            query.has_active = use_query = true;
+        } else if (strncmp(argv[i], "--active-during=", 16) == 0) {
+            if (!query_parse_window(argv[i] + 16, &query.active_from, &query.active_to)) {
+                fprintf(stderr, "Error: Invalid window %s\n", argv[i] + 16);
+                return EXIT_FAILURE;
+            }
+            query.has_active = use_query = true;
+        } else {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (input_count == 0) {
+        fprintf(stderr, "Error: No input file. \n");
+        return EXIT_FAILURE;
+    }
+
+    // Each client request carries its own query and output options, so the command line gives none
+    if (serve_path != NULL && (use_query || format.date.mode != DATE_AS_IS || format.decimal || aggregate ||
+                               follow || threads > 0 || use_stdio || use_pipeline || batch || io_given ||
+                               output_dir != NULL || snapshot_path != NULL)) {
+        fprintf(stderr, "Error: --serve takes input files only; give query and output options in each request. \n");
+        return EXIT_FAILURE;
+    }
+
+    // Several inputs or a glob pattern run as a batch on a pool sized to the machine by default
+    bool as_batch = batch || input_count > 1 || output_dir != NULL || is_glob_pattern(inputs[0]);
+    // Aggregation summarizes one list or snapshot in a single pass and prints nothing else
+    if (aggregate && (as_batch || follow || snapshot_path != NULL)) {
+        fprintf(stderr, "Error: --aggregate takes a single input file and no --follow or --write-snapshot. \n");
+        return EXIT_FAILURE;
+    }
+    // Following streams every appended row of one file as it is on its own reader, so it takes no
+    // query, other output, or choice of reader
+    if (follow && (as_batch || use_query || snapshot_path != NULL || threads > 0 || use_stdio || use_pipeline)) {
+        fprintf(stderr, "Error: --follow takes a single input file and no query, --write-snapshot, --threads, "
+                        "--stdio or --pipeline. \n");
+        return EXIT_FAILURE;
+    }
+    if (as_batch && snapshot_path != NULL) {
+        fprintf(stderr, "Error: --write-snapshot takes a single input file. \n");
+        return EXIT_FAILURE;
+    }
+
+    // Keep the inputs loaded and answer requests for them until interrupted
+    if (serve_path != NULL) {
+        return serve_lists(inputs, input_count, serve_path);
+    }
+    if (as_batch) {
+        if (threads == 0) {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            threads = cpus > 0 ? (int)cpus : 1;
+        }
+        return run_batch(inputs, input_count, &format, use_query ? &query : NULL, threads, output_dir, batch_io);
+    }
+
+    // Get the input filename
+    const char *filename = inputs[0];
+
+    if (follow) {
+        // Appended rows are read as they reach the file, which a compressed stream cannot provide
+        if (file_compression(filename) != COMPRESSION_NONE) {
+            fprintf(stderr, "Error: --follow cannot read compressed input. \n");
+            return EXIT_FAILURE;
+        }
+        return follow_file(filename, &format);
     }
 
+    // Map the input file, falling back to stdio for inputs that cannot be mapped such as pipes
+    MappedFile mf;
+    if (snapshot_path != NULL) {
+        if (!map_file(filename, &mf)) {
+            printf("Error opening file");
+            return EXIT_FAILURE;
+        }
+        bool ok = write_snapshot(mf.data, mf.size, snapshot_path);
+        unmap_file(&mf);
+        if (!ok) {
+            fprintf(stderr, "Error: cannot write snapshot %s\n", snapshot_path);
+            return EXIT_FAILURE;
+        }
+        return 0;
+    }
+    if (aggregate) {
+        if (use_query) {
+            fprintf(stderr, "Error: --aggregate cannot be combined with a query. \n");
+            return EXIT_FAILURE;
+        }
+        if (!map_file(filename, &mf)) {
+            printf("Error opening file");
+            return EXIT_FAILURE;
+        }
+        // Aggregate on a pool sized to the machine unless a thread count is given
+        if (threads == 0) {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            threads = cpus > 0 ? (int)cpus : 1;
+        }
+        ProcessCounts counts;
+        bool ok = aggregate_mapped(mf.data, mf.size, period, format.decimal, threads, stdout, &counts);
+        unmap_file(&mf);
+        if (!ok) {
+            fprintf(stderr, "Error: damaged or incompatible snapshot %s\n", filename);
+            return EXIT_FAILURE;
+        }
+        return 0;
+    }
+    if (use_query) {
+        if (!map_file(filename, &mf)) {
+            printf("Error opening file");
+            return EXIT_FAILURE;
+        }
+        bool ok = run_query(mf.data, mf.size, &format, &query);
+        unmap_file(&mf);
+        if (!ok) {
+            fprintf(stderr, "Error: damaged or incompatible snapshot %s\n", filename);
+            return EXIT_FAILURE;
+        }
+        return 0;
+    }
+    // Only the mapped reader splits its input among threads
+    if (threads > 0 && (use_pipeline || use_stdio)) {
+        fprintf(stderr, "Error: --threads cannot be combined with --pipeline or --stdio. \n");
+        return EXIT_FAILURE;
+    }
+    if (use_pipeline && use_stdio) {
+        fprintf(stderr, "Error: --pipeline cannot be combined with --stdio. \n");
+        return EXIT_FAILURE;
+    }
+    // Compressed text cannot be tokenized in place, so it is decompressed on a thread of its own
+    // and streamed through the pipeline unless the stdio reader is requested
+    bool compressed = file_compression(filename) != COMPRESSION_NONE;
+    if (use_pipeline || (compressed && !use_stdio)) {
+        // The pipeline reads the file itself, so it also takes inputs that cannot be mapped
+        InputStream *in = input_open(filename);
+        if (in == NULL) {
+            printf("Error opening file");
+            return EXIT_FAILURE;
+        }
+        ProcessCounts counts = {0, 0};
+        process_pipelined(in, &format, stdout, &counts);
+        input_close(in);
+        return 0;
+    }
+    if (!use_stdio && map_file(filename, &mf)) {
+        bool ok = process_mapped(mf.data, mf.size, &format, threads > 0 ? threads : 1);
+        unmap_file(&mf);
+        if (!ok) {
+            fprintf(stderr, "Error: damaged or incompatible snapshot %s\n", filename);
+            return EXIT_FAILURE;
+        }
+        return 0;
+    }
+
+    // Open the input file for reading, reading a compressed one from its text decompressed in memory
+    bool mapped = compressed && map_file(filename, &mf);
+    FILE *fp = NULL;
+    if (!compressed) {
+        fp = fopen(filename, "r");
+    } else if (mapped) {
+        fp = fmemopen((void *)mf.data, mf.size, "r");
+    }
+    // Check if file opened successfully
+    if (fp == NULL) {
+        printf("Error opening file");
+        return EXIT_FAILURE;
+    }
+    process_stdio(fp, &format);
     fclose(fp);
+    if (mapped) {
+        unmap_file(&mf);
+    }
     return 0;
 }
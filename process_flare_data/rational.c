@@ -0,0 +1,764 @@
+/**
+    @file rational.c
+    This program provides a rational number type with a small-value fast path. While a value fits,
+    it is two int64 values and every operation is the same checked 64-bit arithmetic as fraction.c.
+    When a product or sum would overflow, the operation is redone with arbitrary precision integers
+    on the heap, and the reduced result moves back inline as soon as it fits again. The big integers
+    are sign and magnitude with 32-bit limbs; they are only used on this rare path, so they favour
+    short code over speed.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rational.h"
+
+typedef struct {
+    uint32_t *limbs; // Magnitude, least significant limb first
+    int len;         // Number of limbs in use; zero has none
+    int cap;         // Number of limbs allocated
+    bool negative;   // Sign, false for zero
+} BigInt;
+
+struct BigRational {
+    BigInt num, den; // Numerator and positive denominator in lowest terms
+};
+
+/**
+    This function makes room for a number of limbs.
+    @param a Big integer to grow
+    @param n Number of limbs needed
+ */
+static void big_reserve(BigInt *a, int n)
+{
+    if (n <= a->cap) {
+        return;
+    }
+    uint32_t *limbs = realloc(a->limbs, (size_t)n * sizeof(uint32_t));
+    if (limbs == NULL) {
+        fprintf(stderr, "Error: out of memory in rational.\n");
+        exit(EXIT_FAILURE);
+    }
+    a->limbs = limbs;
+    a->cap = n;
+}
+
+/**
+    This function drops leading zero limbs, so that len is the true length and zero is not negative.
+    @param a Big integer to trim
+ */
+static void big_trim(BigInt *a)
+{
+    while (a->len > 0 && a->limbs[a->len - 1] == 0) {
+        a->len--;
+    }
+    if (a->len == 0) {
+        a->negative = false;
+    }
+}
+
+/**
+    This function releases the limbs of a big integer.
+    @param a Big integer to free
+ */
+static void big_free(BigInt *a)
+{
+    free(a->limbs);
+    a->limbs = NULL;
+    a->len = a->cap = 0;
+    a->negative = false;
+}
+
+/**
+    This function sets a big integer from an int64.
+    @param a Big integer to set
+    @param v Value
+ */
+static void big_set_int64(BigInt *a, int64 v)
+{
+    unsigned long long m = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    big_reserve(a, 2);
+    a->limbs[0] = (uint32_t)m;
+    a->limbs[1] = (uint32_t)(m >> 32);
+    a->len = 2;
+    a->negative = v < 0;
+    big_trim(a);
+}
+
+/**
+    This function copies a big integer.
+    @param dst Big integer to set
+    @param src Value to copy
+ */
+static void big_copy(BigInt *dst, const BigInt *src)
+{
+    big_reserve(dst, src->len);
+    if (src->len > 0) {
+        memcpy(dst->limbs, src->limbs, (size_t)src->len * sizeof(uint32_t));
+    }
+    dst->len = src->len;
+    dst->negative = src->negative;
+}
+
+/**
+    This function converts a big integer to an int64 if it fits.
+    @param a Big integer
+    @param v Value, set if it fits
+    @return true if a fits in an int64 (the most negative value is treated as not fitting)
+ */
+static bool big_to_int64(const BigInt *a, int64 *v)
+{
+    if (a->len > 2) {
+        return false;
+    }
+    unsigned long long m = 0;
+    for (int i = a->len - 1; i >= 0; i--) {
+        m = (m << 32) | a->limbs[i];
+    }
+    if (m > (unsigned long long)INT64_MAX) {
+        return false;
+    }
+    *v = a->negative ? -(int64)m : (int64)m;
+    return true;
+}
+
+/**
+    This function compares the magnitudes of two big integers.
+    @param a First big integer
+    @param b Second big integer
+    @return Negative, zero or positive as |a| is less than, equal to or greater than |b|
+ */
+static int big_compare_magnitude(const BigInt *a, const BigInt *b)
+{
+    if (a->len != b->len) {
+        return a->len < b->len ? -1 : 1;
+    }
+    for (int i = a->len - 1; i >= 0; i--) {
+        if (a->limbs[i] != b->limbs[i]) {
+            return a->limbs[i] < b->limbs[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/**
+    This function adds two signed big integers: r = a + b, or a - b when negate_b is set.
+    @param r Result, which must not be a or b
+    @param a First big integer
+    @param b Second big integer
+    @param negate_b true to subtract b
+ */
+static void big_add(BigInt *r, const BigInt *a, const BigInt *b, bool negate_b)
+{
+    bool b_negative = b->negative != negate_b && b->len > 0;
+    int n = (a->len > b->len ? a->len : b->len) + 1;
+    big_reserve(r, n);
+
+    if (a->negative == b_negative) {
+        // Same signs: add the magnitudes
+        unsigned long long carry = 0;
+        for (int i = 0; i < n; i++) {
+            unsigned long long sum = carry + (i < a->len ? a->limbs[i] : 0) + (i < b->len ? b->limbs[i] : 0);
+            r->limbs[i] = (uint32_t)sum;
+            carry = sum >> 32;
+        }
+        r->negative = a->negative;
+    } else {
+        // Different signs: subtract the smaller magnitude from the larger
+        const BigInt *big = a, *small = b;
+        r->negative = a->negative;
+        if (big_compare_magnitude(a, b) < 0) {
+            big = b;
+            small = a;
+            r->negative = b_negative;
+        }
+        long long borrow = 0;
+        for (int i = 0; i < n; i++) {
+            long long diff = (long long)(i < big->len ? big->limbs[i] : 0) -
+                             (i < small->len ? small->limbs[i] : 0) - borrow;
+            borrow = diff < 0;
+            r->limbs[i] = (uint32_t)(diff + (borrow << 32));
+        }
+    }
+    r->len = n;
+    big_trim(r);
+}
+
+/**
+    This function multiplies two big integers with the schoolbook method.
+    @param r Result, which must not be a or b
+    @param a First big integer
+    @param b Second big integer
+ */
+static void big_multiply(BigInt *r, const BigInt *a, const BigInt *b)
+{
+    int n = a->len + b->len;
+    big_reserve(r, n > 0 ? n : 1);
+    memset(r->limbs, 0, (size_t)n * sizeof(uint32_t));
+    for (int i = 0; i < a->len; i++) {
+        unsigned long long carry = 0;
+        for (int j = 0; j < b->len; j++) {
+            unsigned long long t = (unsigned long long)a->limbs[i] * b->limbs[j] + r->limbs[i + j] + carry;
+            r->limbs[i + j] = (uint32_t)t;
+            carry = t >> 32;
+        }
+        r->limbs[i + b->len] = (uint32_t)carry;
+    }
+    r->len = n;
+    r->negative = a->negative != b->negative;
+    big_trim(r);
+}
+
+/**
+    This function counts the trailing zero bits of a nonzero big integer.
+    @param a Big integer
+    @return Number of trailing zero bits
+ */
+static int big_trailing_zeros(const BigInt *a)
+{
+    int i = 0;
+    while (a->limbs[i] == 0) {
+        i++;
+    }
+    return i * 32 + __builtin_ctz(a->limbs[i]);
+}
+
+/**
+    This function shifts the magnitude of a big integer right.
+    @param a Big integer to shift in place
+    @param bits Number of bits
+ */
+static void big_shift_right(BigInt *a, int bits)
+{
+    int limbs = bits / 32, shift = bits % 32;
+    for (int i = 0; i + limbs < a->len; i++) {
+        unsigned long long pair = a->limbs[i + limbs];
+        if (i + limbs + 1 < a->len) {
+            pair |= (unsigned long long)a->limbs[i + limbs + 1] << 32;
+        }
+        a->limbs[i] = (uint32_t)(pair >> shift);
+    }
+    a->len = a->len > limbs ? a->len - limbs : 0;
+    big_trim(a);
+}
+
+/**
+    This function shifts the magnitude of a big integer left.
+    @param a Big integer to shift in place
+    @param bits Number of bits
+ */
+static void big_shift_left(BigInt *a, int bits)
+{
+    if (a->len == 0) {
+        return;
+    }
+    int limbs = bits / 32, shift = bits % 32;
+    int n = a->len + limbs + 1;
+    big_reserve(a, n);
+    for (int i = n - 1; i >= 0; i--) {
+        int src = i - limbs;
+        unsigned long long high = (src >= 0 && src < a->len) ? a->limbs[src] : 0;
+        unsigned long long low = (src >= 1 && src - 1 < a->len) ? a->limbs[src - 1] : 0;
+        a->limbs[i] = (uint32_t)(((high << 32 | low) << shift) >> 32);
+    }
+    a->len = n;
+    big_trim(a);
+}
+
+/**
+    This function calculates the GCD of the magnitudes of two big integers with the binary algorithm.
+    @param r Result, which must not be a or b
+    @param a First big integer
+    @param b Second big integer (nonzero)
+ */
+static void big_gcd(BigInt *r, const BigInt *a, const BigInt *b)
+{
+    BigInt u = {NULL, 0, 0, false}, v = {NULL, 0, 0, false};
+    big_copy(r, b);
+    r->negative = false;
+    if (a->len == 0) {
+        return;
+    }
+    big_copy(&u, a);
+    big_copy(&v, b);
+    u.negative = v.negative = false;
+
+    int u_zeros = big_trailing_zeros(&u), v_zeros = big_trailing_zeros(&v);
+    int shift = u_zeros < v_zeros ? u_zeros : v_zeros;
+    big_shift_right(&u, u_zeros);
+    big_shift_right(&v, v_zeros);
+    while (big_compare_magnitude(&u, &v) != 0) {
+        // Both are odd; replace the larger with the odd part of their difference
+        if (big_compare_magnitude(&u, &v) > 0) {
+            BigInt t = u;
+            u = v;
+            v = t;
+        }
+        big_add(r, &v, &u, true);
+        big_shift_right(r, big_trailing_zeros(r));
+        BigInt t = v;
+        v = *r;
+        *r = t;
+    }
+    big_copy(r, &u);
+    big_shift_left(r, shift);
+    big_free(&u);
+    big_free(&v);
+}
+
+/**
+    This function divides a big integer by another that divides it exactly, one bit at a time.
+    @param q Quotient, which must not be a or d
+    @param a Dividend
+    @param d Divisor (nonzero)
+ */
+static void big_divide_exact(BigInt *q, const BigInt *a, const BigInt *d)
+{
+    BigInt rem = {NULL, 0, 0, false}, next = {NULL, 0, 0, false}, divisor = {NULL, 0, 0, false};
+    big_copy(&divisor, d);
+    divisor.negative = false;
+    big_reserve(q, a->len > 0 ? a->len : 1);
+    memset(q->limbs, 0, (size_t)a->len * sizeof(uint32_t));
+    q->len = a->len;
+
+    for (int bit = a->len * 32 - 1; bit >= 0; bit--) {
+        // Bring the next bit of the dividend into the remainder
+        big_shift_left(&rem, 1);
+        if ((a->limbs[bit / 32] >> (bit % 32)) & 1) {
+            if (rem.len == 0) {
+                big_set_int64(&rem, 1);
+            } else {
+                rem.limbs[0] |= 1;
+            }
+        }
+        if (big_compare_magnitude(&rem, &divisor) >= 0) {
+            big_add(&next, &rem, &divisor, true);
+            BigInt t = rem;
+            rem = next;
+            next = t;
+            q->limbs[bit / 32] |= 1u << (bit % 32);
+        }
+    }
+    q->negative = a->negative != d->negative;
+    big_trim(q);
+    big_free(&rem);
+    big_free(&next);
+    big_free(&divisor);
+}
+
+/**
+    This function divides the magnitude of a big integer by a small divisor in place.
+    @param a Big integer to divide
+    @param d Divisor (nonzero)
+    @return The remainder
+ */
+static uint32_t big_divide_small(BigInt *a, uint32_t d)
+{
+    unsigned long long rem = 0;
+    for (int i = a->len - 1; i >= 0; i--) {
+        unsigned long long cur = rem << 32 | a->limbs[i];
+        a->limbs[i] = (uint32_t)(cur / d);
+        rem = cur % d;
+    }
+    bool negative = a->negative;
+    big_trim(a);
+    a->negative = negative && a->len > 0;
+    return (uint32_t)rem;
+}
+
+/**
+    This function loads the value of a rational into two big integers.
+    @param r Rational to load
+    @param num Numerator
+    @param den Denominator
+ */
+static void load_big(const Rational *r, BigInt *num, BigInt *den)
+{
+    if (r->big == NULL) {
+        big_set_int64(num, r->num);
+        big_set_int64(den, r->den);
+    } else {
+        big_copy(num, &r->big->num);
+        big_copy(den, &r->big->den);
+    }
+}
+
+/**
+    This function reduces a big fraction to lowest terms with a positive denominator and stores it,
+    inline if it fits and on the heap otherwise. num and den are consumed.
+    @param num Numerator
+    @param den Denominator (nonzero)
+    @param result Rational to store the value in
+ */
+static void store_big(BigInt *num, BigInt *den, Rational *result)
+{
+    // If the denominator is negative, negate both numerator and denominator
+    if (den->negative) {
+        den->negative = false;
+        num->negative = !num->negative && num->len > 0;
+    }
+
+    BigInt g = {NULL, 0, 0, false}, reduced = {NULL, 0, 0, false};
+    big_gcd(&g, num, den);
+    if (!(g.len == 1 && g.limbs[0] == 1)) {
+        big_divide_exact(&reduced, num, &g);
+        BigInt t = *num;
+        *num = reduced;
+        reduced = t;
+        big_divide_exact(&reduced, den, &g);
+        t = *den;
+        *den = reduced;
+        reduced = t;
+    }
+    big_free(&g);
+    big_free(&reduced);
+
+    // Move back inline if the reduced value fits
+    int64 n, d;
+    if (big_to_int64(num, &n) && big_to_int64(den, &d)) {
+        rational_free(result);
+        result->num = n;
+        result->den = d;
+        big_free(num);
+        big_free(den);
+        return;
+    }
+    if (result->big == NULL) {
+        result->big = calloc(1, sizeof(BigRational));
+        if (result->big == NULL) {
+            fprintf(stderr, "Error: out of memory in rational.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    big_free(&result->big->num);
+    big_free(&result->big->den);
+    result->big->num = *num;
+    result->big->den = *den;
+    result->num = 0;
+    result->den = 1;
+}
+
+/**
+    This function stores a value computed in 64 bits, reduced with gcd(). The most negative int64
+    is left to the big path, since it has no positive counterpart.
+    @param num Numerator
+    @param den Denominator (nonzero)
+    @param result Rational to store the value in
+    @return true if the value was stored, false if the big path must be used
+ */
+static bool store_small(int64 num, int64 den, Rational *result)
+{
+    if (num == INT64_MIN || den == INT64_MIN) {
+        return false;
+    }
+    if (den < 0) {
+        num = -num;
+        den = -den;
+    }
+    int64 g = gcd(num, den);
+    if (g > 1) {
+        num /= g;
+        den /= g;
+    }
+    rational_free(result);
+    result->num = num;
+    result->den = den;
+    return true;
+}
+
+/**
+    This function sets a rational from an integer numerator and denominator.
+    @param r Rational to set
+    @param num Numerator
+    @param den Denominator
+    @return false if den is zero, leaving r unchanged
+ */
+bool rational_set(Rational *r, int64 num, int64 den)
+{
+    if (den == 0) {
+        return false;
+    }
+    if (!store_small(num, den, r)) {
+        BigInt n = {NULL, 0, 0, false}, d = {NULL, 0, 0, false};
+        big_set_int64(&n, num);
+        big_set_int64(&d, den);
+        store_big(&n, &d, r);
+    }
+    return true;
+}
+
+/**
+    This function sets a rational from DecimalParts in the same way from_decimal_parts makes a fraction.
+    @param input DecimalParts to convert
+    @param r Rational to set
+    @return false if the decimal length is outside 0 - 15, leaving r unchanged
+ */
+bool rational_from_decimal(const DecimalParts input, Rational *r)
+{
+    int64 integer_part = input[0];
+    int64 decimal_part = input[1];
+    int64 decimal_length = input[2];
+    if (decimal_length < 0 || decimal_length > 15) {
+        return false;
+    }
+    if (decimal_length == 0) {
+        return rational_set(r, integer_part, 1);
+    }
+
+    int64 denominator = 1;
+    for (int i = 0; i < decimal_length; ++i) {
+        denominator *= 10;
+    }
+    // The decimal part moves the value away from zero
+    int64 numerator;
+    bool overflow = __builtin_mul_overflow(integer_part, denominator, &numerator);
+    if (integer_part >= 0) {
+        overflow |= __builtin_add_overflow(numerator, decimal_part, &numerator);
+    } else {
+        overflow |= __builtin_sub_overflow(numerator, decimal_part, &numerator);
+    }
+    if (!overflow && store_small(numerator, denominator, r)) {
+        return true;
+    }
+
+    BigInt n = {NULL, 0, 0, false}, d = {NULL, 0, 0, false}, dec = {NULL, 0, 0, false}, scaled = {NULL, 0, 0, false};
+    big_set_int64(&scaled, integer_part);
+    big_set_int64(&d, denominator);
+    big_set_int64(&dec, decimal_part);
+    big_multiply(&n, &scaled, &d);
+    big_add(&scaled, &n, &dec, integer_part < 0);
+    big_free(&n);
+    big_free(&dec);
+    store_big(&scaled, &d, r);
+    return true;
+}
+
+/**
+    This function adds or subtracts two rationals with arbitrary precision.
+    @param a First rational
+    @param b Second rational
+    @param negate_b true to subtract b
+    @param result Rational to store the result in
+ */
+static void big_sum(const Rational *a, const Rational *b, bool negate_b, Rational *result)
+{
+    BigInt an = {NULL, 0, 0, false}, ad = {NULL, 0, 0, false}, bn = {NULL, 0, 0, false}, bd = {NULL, 0, 0, false};
+    BigInt left = {NULL, 0, 0, false}, right = {NULL, 0, 0, false}, num = {NULL, 0, 0, false}, den = {NULL, 0, 0, false};
+    load_big(a, &an, &ad);
+    load_big(b, &bn, &bd);
+    big_multiply(&left, &an, &bd);
+    big_multiply(&right, &bn, &ad);
+    big_add(&num, &left, &right, negate_b);
+    big_multiply(&den, &ad, &bd);
+    big_free(&an);
+    big_free(&ad);
+    big_free(&bn);
+    big_free(&bd);
+    big_free(&left);
+    big_free(&right);
+    store_big(&num, &den, result);
+}
+
+/**
+    This function sums two rationals, over the least common multiple of their denominators while
+    everything fits in 64 bits.
+    @param a First rational
+    @param b Second rational
+    @param negate_b true to subtract b
+    @param result Rational to store the result in
+ */
+static void sum_rational(const Rational *a, const Rational *b, bool negate_b, Rational *result)
+{
+    if (a->big == NULL && b->big == NULL) {
+        int64 g = gcd(a->den, b->den);
+        int64 a_scale = b->den / g;
+        int64 b_scale = a->den / g;
+        int64 den, a_num, b_num, num;
+        bool overflow = __builtin_mul_overflow(b_scale, b->den, &den) |
+                        __builtin_mul_overflow(a->num, a_scale, &a_num) |
+                        __builtin_mul_overflow(b->num, b_scale, &b_num);
+        overflow |= negate_b ? __builtin_sub_overflow(a_num, b_num, &num) : __builtin_add_overflow(a_num, b_num, &num);
+        if (!overflow && store_small(num, den, result)) {
+            return;
+        }
+    }
+    big_sum(a, b, negate_b, result);
+}
+
+/**
+    This function adds two rationals.
+    @param a First rational
+    @param b Second rational
+    @param result Rational to store the result in
+    @return true
+ */
+bool rational_add(const Rational *a, const Rational *b, Rational *result)
+{
+    sum_rational(a, b, false, result);
+    return true;
+}
+
+/**
+    This function subtracts one rational from another.
+    @param a First rational
+    @param b Second rational
+    @param result Rational to store the result in
+    @return true
+ */
+bool rational_subtract(const Rational *a, const Rational *b, Rational *result)
+{
+    sum_rational(a, b, true, result);
+    return true;
+}
+
+/**
+    This function multiplies a by b, or by the reciprocal of b.
+    @param a First rational
+    @param b Second rational
+    @param invert_b true to divide by b
+    @param result Rational to store the result in
+ */
+static void product_rational(const Rational *a, const Rational *b, bool invert_b, Rational *result)
+{
+    if (a->big == NULL && b->big == NULL) {
+        int64 b_num = invert_b ? b->den : b->num;
+        int64 b_den = invert_b ? b->num : b->den;
+        int64 num, den;
+        if (!(__builtin_mul_overflow(a->num, b_num, &num) | __builtin_mul_overflow(a->den, b_den, &den)) &&
+            store_small(num, den, result)) {
+            return;
+        }
+    }
+    BigInt an = {NULL, 0, 0, false}, ad = {NULL, 0, 0, false}, bn = {NULL, 0, 0, false}, bd = {NULL, 0, 0, false};
+    BigInt num = {NULL, 0, 0, false}, den = {NULL, 0, 0, false};
+    load_big(a, &an, &ad);
+    load_big(b, &bn, &bd);
+    big_multiply(&num, &an, invert_b ? &bd : &bn);
+    big_multiply(&den, &ad, invert_b ? &bn : &bd);
+    big_free(&an);
+    big_free(&ad);
+    big_free(&bn);
+    big_free(&bd);
+    store_big(&num, &den, result);
+}
+
+/**
+    This function multiplies two rationals.
+    @param a First rational
+    @param b Second rational
+    @param result Rational to store the result in
+    @return true
+ */
+bool rational_multiply(const Rational *a, const Rational *b, Rational *result)
+{
+    product_rational(a, b, false, result);
+    return true;
+}
+
+/**
+    This function divides one rational by another.
+    @param a First rational
+    @param b Second rational
+    @param result Rational to store the result in
+    @return false if b is zero, leaving result unchanged
+ */
+bool rational_divide(const Rational *a, const Rational *b, Rational *result)
+{
+    if (b->big == NULL && b->num == 0) {
+        return false;
+    }
+    product_rational(a, b, true, result);
+    return true;
+}
+
+/**
+    This function checks whether a rational is held inline.
+    @param r Rational to check
+    @return true if r->num and r->den hold its value
+ */
+bool rational_is_small(const Rational *r)
+{
+    return r->big == NULL;
+}
+
+/**
+    This function writes the decimal digits of a big integer.
+    @param a Big integer
+    @param out Output, or NULL to only count
+    @param size Bytes available at out
+    @param pos Position of the next character, advanced past the number
+ */
+static void big_text(const BigInt *a, char *out, size_t size, size_t *pos)
+{
+    // Peel off nine digits at a time, least significant first
+    BigInt t = {NULL, 0, 0, false};
+    big_copy(&t, a);
+    uint32_t *groups = malloc(((size_t)a->len * 32 / 29 + 2) * sizeof(uint32_t));
+    if (groups == NULL) {
+        fprintf(stderr, "Error: out of memory in rational.\n");
+        exit(EXIT_FAILURE);
+    }
+    int count = 0;
+    do {
+        groups[count++] = big_divide_small(&t, 1000000000u);
+    } while (t.len > 0);
+
+    char digits[16];
+    int len = a->negative ? 1 : 0;
+    if (a->negative && *pos < size) {
+        out[*pos] = '-';
+    }
+    *pos += len;
+    for (int i = count - 1; i >= 0; i--) {
+        int n = snprintf(digits, sizeof(digits), i == count - 1 ? "%u" : "%09u", groups[i]);
+        for (int k = 0; k < n; k++, (*pos)++) {
+            if (*pos < size) {
+                out[*pos] = digits[k];
+            }
+        }
+    }
+    free(groups);
+    big_free(&t);
+}
+
+/**
+    This function formats a rational as "numerator/denominator", like snprintf.
+    @param r Rational to format
+    @param buf Output buffer, always NUL-terminated if size is nonzero
+    @param size Size of the buffer
+    @return Length of the full text, which may be more than size - 1
+ */
+size_t rational_format(const Rational *r, char *buf, size_t size)
+{
+    if (r->big == NULL) {
+        int n = snprintf(buf, size, "%lld/%lld", r->num, r->den);
+        return n < 0 ? 0 : (size_t)n;
+    }
+    size_t pos = 0;
+    big_text(&r->big->num, buf, size, &pos);
+    if (pos < size) {
+        buf[pos] = '/';
+    }
+    pos++;
+    big_text(&r->big->den, buf, size, &pos);
+    if (size > 0) {
+        buf[pos < size ? pos : size - 1] = '\0';
+    }
+    return pos;
+}
+
+/**
+    This function releases the heap storage of a rational and sets it to zero.
+    @param r Rational to free
+ */
+void rational_free(Rational *r)
+{
+    if (r->big != NULL) {
+        big_free(&r->big->num);
+        big_free(&r->big->den);
+        free(r->big);
+        r->big = NULL;
+    }
+    r->num = 0;
+    r->den = 1;
+}
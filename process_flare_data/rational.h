@@ -0,0 +1,52 @@
+/**
+     @file rational.h
+     This header file defines a rational number that is held inline as two int64 values, and moves
+     to heap-allocated arbitrary precision integers only when an operation would overflow. Results
+     are always in lowest terms with a positive denominator, and move back inline once they fit.
+     Operations report failure by returning false instead of exiting.
+ */
+#ifndef RATIONAL_H
+#define RATIONAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "fraction.h"
+
+typedef struct BigRational BigRational;
+
+typedef struct {
+    int64 num, den;  // Value while big is NULL
+    BigRational *big; // Heap value once the value no longer fits in int64
+} Rational;
+
+// Initializer for a Rational holding zero
+#define RATIONAL_ZERO {0, 1, NULL}
+
+// Set r to num / den in lowest terms, returning false if den is zero
+bool rational_set(Rational *r, int64 num, int64 den);
+
+// Set r to the value of decimal parts, as from_decimal_parts does, returning false on an invalid length
+bool rational_from_decimal(const DecimalParts input, Rational *r);
+
+// Add two rationals: a + b → result (result may be a or b)
+bool rational_add(const Rational *a, const Rational *b, Rational *result);
+
+// Subtract two rationals: a - b → result (result may be a or b)
+bool rational_subtract(const Rational *a, const Rational *b, Rational *result);
+
+// Multiply two rationals: a * b → result (result may be a or b)
+bool rational_multiply(const Rational *a, const Rational *b, Rational *result);
+
+// Divide two rationals: a / b → result (result may be a or b), returning false if b is zero
+bool rational_divide(const Rational *a, const Rational *b, Rational *result);
+
+// Return true if r is held inline, so that r->num and r->den are its value
+bool rational_is_small(const Rational *r);
+
+// Write r as "numerator/denominator" into buf like snprintf, returning the full length of the text
+size_t rational_format(const Rational *r, char *buf, size_t size);
+
+// Release the heap storage of r, leaving it equal to zero
+void rational_free(Rational *r);
+
+#endif
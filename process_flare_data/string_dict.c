@@ -0,0 +1,175 @@
+/**
+    @file string_dict.c
+    This program provides an interning dictionary. Each distinct string is stored once and gets the
+    next code in order of first appearance, so codes can index side tables directly.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "string_dict.h"
+
+/**
+    This function hashes a string with FNV-1a.
+    @param s String to hash
+    @param len Length of the string
+    @return 32-bit hash
+ */
+static uint32_t hash_string(const char *s, int len)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    }
+    return h;
+}
+
+/**
+    This function reallocates an array, exiting if memory runs out.
+    @param p Array to grow
+    @param size New size in bytes
+    @return The reallocated array
+ */
+static void *grow(void *p, size_t size)
+{
+    p = realloc(p, size);
+    if (p == NULL) {
+        fprintf(stderr, "Error: out of memory in string_dict.\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/**
+    This function doubles the hash table and reinserts every code.
+    @param dict Dictionary to rehash
+ */
+static void rehash(StringDict *dict)
+{
+    uint32_t slot_count = dict->slot_count ? dict->slot_count * 2 : 64;
+    uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+    if (slots == NULL) {
+        fprintf(stderr, "Error: out of memory in string_dict.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t code = 0; code < dict->count; code++) {
+        int len;
+        const char *s = dict_string(dict, code, &len);
+        uint32_t i = hash_string(s, len) & (slot_count - 1);
+        while (slots[i] != 0) {
+            i = (i + 1) & (slot_count - 1);
+        }
+        slots[i] = code + 1;
+    }
+    free(dict->slots);
+    dict->slots = slots;
+    dict->slot_count = slot_count;
+}
+
+/**
+    This function initializes an empty dictionary.
+    @param dict Dictionary to initialize
+ */
+void dict_init(StringDict *dict)
+{
+    memset(dict, 0, sizeof(*dict));
+    dict->offsets = grow(NULL, 16 * sizeof(uint32_t));
+    dict->offsets_cap = 16;
+    dict->offsets[0] = 0;
+    rehash(dict);
+}
+
+/**
+    This function finds the slot of a string, or the empty slot where it would go.
+    @param dict Dictionary to search
+    @param s String to look for
+    @param len Length of the string
+    @return Index of the slot
+ */
+static uint32_t find_slot(const StringDict *dict, const char *s, int len)
+{
+    uint32_t i = hash_string(s, len) & (dict->slot_count - 1);
+    while (dict->slots[i] != 0) {
+        int found_len;
+        const char *found = dict_string(dict, dict->slots[i] - 1, &found_len);
+        if (found_len == len && memcmp(found, s, len) == 0) {
+            break;
+        }
+        i = (i + 1) & (dict->slot_count - 1);
+    }
+    return i;
+}
+
+/**
+    This function looks a string up without adding it.
+    @param dict Dictionary to search
+    @param s String to look for (need not be NUL-terminated)
+    @param len Length of the string
+    @return Code of the string, or DICT_ABSENT
+ */
+uint32_t dict_find(const StringDict *dict, const char *s, int len)
+{
+    uint32_t i = find_slot(dict, s, len);
+    return dict->slots[i] != 0 ? dict->slots[i] - 1 : DICT_ABSENT;
+}
+
+/**
+    This function looks a string up, adding it with the next free code if it is not present.
+    @param dict Dictionary to search
+    @param s String to intern (need not be NUL-terminated)
+    @param len Length of the string
+    @return Code of the string
+ */
+uint32_t dict_intern(StringDict *dict, const char *s, int len)
+{
+    uint32_t i = find_slot(dict, s, len);
+    if (dict->slots[i] != 0) {
+        return dict->slots[i] - 1;
+    }
+
+    // Append the new string and its end offset
+    uint32_t code = dict->count;
+    if (dict->chars_len + len > dict->chars_cap) {
+        dict->chars_cap = (dict->chars_len + len) * 2 + 64;
+        dict->chars = grow(dict->chars, dict->chars_cap);
+    }
+    if (code + 2 > dict->offsets_cap) {
+        dict->offsets_cap *= 2;
+        dict->offsets = grow(dict->offsets, dict->offsets_cap * sizeof(uint32_t));
+    }
+    memcpy(dict->chars + dict->chars_len, s, len);
+    dict->chars_len += len;
+    dict->offsets[code + 1] = (uint32_t)dict->chars_len;
+    dict->count++;
+    dict->slots[i] = code + 1;
+
+    // Keep the table at most half full
+    if (dict->count * 2 > dict->slot_count) {
+        rehash(dict);
+    }
+    return code;
+}
+
+/**
+    This function returns the string behind a code.
+    @param dict Dictionary holding the string
+    @param code Code returned by dict_intern
+    @param len Length of the string
+    @return Start of the string (not NUL-terminated)
+ */
+const char *dict_string(const StringDict *dict, uint32_t code, int *len)
+{
+    *len = (int)(dict->offsets[code + 1] - dict->offsets[code]);
+    return dict->chars + dict->offsets[code];
+}
+
+/**
+    This function releases the memory held by the dictionary.
+    @param dict Dictionary to release
+ */
+void dict_free(StringDict *dict)
+{
+    free(dict->chars);
+    free(dict->offsets);
+    free(dict->slots);
+    memset(dict, 0, sizeof(*dict));
+}
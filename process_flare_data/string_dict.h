@@ -0,0 +1,39 @@
+/**
+     @file string_dict.h
+     This header file defines an interning dictionary that maps strings to small dense integer codes.
+ */
+#ifndef STRING_DICT_H
+#define STRING_DICT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DICT_ABSENT UINT32_MAX // Returned by dict_find for a string that was never interned
+
+typedef struct {
+    char *chars;        // Interned strings, back to back
+    size_t chars_len;   // Bytes in use in chars
+    size_t chars_cap;   // Allocated size of chars
+    uint32_t *offsets;  // Start of string i is offsets[i], its end is offsets[i + 1]
+    uint32_t count;     // Number of interned strings
+    uint32_t offsets_cap;
+    uint32_t *slots;    // Hash table of code + 1, 0 for an empty slot
+    uint32_t slot_count; // Size of the hash table, a power of two
+} StringDict;
+
+// Initialize an empty dictionary
+void dict_init(StringDict *dict);
+
+// Return the code of the string, or DICT_ABSENT if it has not been interned
+uint32_t dict_find(const StringDict *dict, const char *s, int len);
+
+// Return the code of the string, adding it if it is new
+uint32_t dict_intern(StringDict *dict, const char *s, int len);
+
+// Return the string for a code and store its length in len
+const char *dict_string(const StringDict *dict, uint32_t code, int *len);
+
+// Release the memory held by the dictionary
+void dict_free(StringDict *dict);
+
+#endif